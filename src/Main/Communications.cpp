@@ -78,22 +78,47 @@ void initializeMPICommunication(MPICommunicator& PhysicalSystemComm,
 
   /// 1. initialize global MPI communicator
 
-  MPI_Init(NULL, NULL);
+  // Threaded walkers (numThreadsPerRank > 1) call MPI from the main thread only
+  int threadSupport;
+  MPI_Init_thread(NULL, NULL, MPI_THREAD_FUNNELED, &threadSupport);
   GlobalComm.initialize(MPI_COMM_WORLD);
 
+  if (simInfo.numThreadsPerRank > 1) {
+    if (threadSupport < MPI_THREAD_FUNNELED) {
+      std::cout << "ERROR!! The MPI library does not support threads (MPI_THREAD_FUNNELED).\n"
+                << "        OWL aborting...\n";
+      exit(7);
+    }
+    bool threadedREWL = (simInfo.algorithm == 5 && simInfo.numWalkers % simInfo.numThreadsPerRank == 0);
+    bool sharedDOSWL  = (simInfo.algorithm == 2);
+    if (!(threadedREWL || sharedDOSWL) || simInfo.numMPIranksPerWalker != 1) {
+      std::cout << "ERROR!! numberOfThreadsPerRank > 1 requires WL, or REWL with numWalkers (" << simInfo.numWalkers << ")\n"
+                << "        divisible by numberOfThreadsPerRank (" << simInfo.numThreadsPerRank << "),\n"
+                << "        and NumberOfMPIranksPerWalker = 1.\n"
+                << "        OWL aborting...\n";
+      exit(7);
+    }
+  }
+
+  /// the walker leaders are processes; threaded REWL hosts numThreadsPerRank walkers on each,
+  /// while the threads of WL are walkers of one shared DOS
+  int walkersPerProcess = (simInfo.algorithm == 5) ? simInfo.numThreadsPerRank : 1;
+  int numWalkerLeaders  = simInfo.numWalkers / walkersPerProcess;
+
   /// 2. Define the MPI communicators for PhysicalSystem
 
   /// YingWai's note: Cannot use std::vector for walkerLeadersID because it does not match MPI_Group_incl's API
   //std::vector<int> walkerLeadersID;
   //walkerLeadersID.assign(simInfo.numWalkers, -1);
   int* walkerLeadersID;
-  walkerLeadersID = new int[unsigned(simInfo.numWalkers)] {-1};
+  walkerLeadersID = new int[unsigned(numWalkerLeaders)] {-1};
 
   /// exit if the total number of MPI ranks is not consistent with input info
-  if (simInfo.numWalkers * simInfo.numMPIranksPerWalker != GlobalComm.totalMPIranks) { 
+  if (numWalkerLeaders * simInfo.numMPIranksPerWalker != GlobalComm.totalMPIranks) { 
 
     std::cout << "ERROR!! Total number of MPI ranks is not consistent with input info.\n"
-              << "        numWalkers (" << simInfo.numWalkers << ") x numMPIranksPerWalker (" 
+              << "        numWalkers (" << simInfo.numWalkers << ") / walkers per process (" << walkersPerProcess
+              << ") x numMPIranksPerWalker (" 
               << simInfo.numMPIranksPerWalker << ") != totalMPIranks (" 
               << GlobalComm.totalMPIranks << ") \n";
     std::cout << "        Please check OWL's input file or submission script.\n"
@@ -110,10 +135,10 @@ void initializeMPICommunication(MPICommunicator& PhysicalSystemComm,
 
     /// group processors into different walkers
     int walkerID = (GlobalComm.thisMPIrank - (GlobalComm.thisMPIrank % simInfo.numMPIranksPerWalker)) / simInfo.numMPIranksPerWalker;
-    simInfo.myWalkerID = walkerID;
+    simInfo.myWalkerID = walkerID * walkersPerProcess;     // the first walker of this process
 
     /// store the global MPI rank IDs for all "group leaders" (rank 0s) in each walker
-    for (int i=0; i<simInfo.numWalkers; i++)
+    for (int i=0; i<numWalkerLeaders; i++)
       walkerLeadersID[i] = i * simInfo.numMPIranksPerWalker;
 
     /// build the physical system communicators
@@ -143,7 +168,7 @@ void initializeMPICommunication(MPICommunicator& PhysicalSystemComm,
   // YingWai: should the MPI_Groups be put somewhere else to be non-local objects?   (Dec 25, 17)
   MPI_Group MPI_GROUP_WORLD, WalkersGroup;
   MPI_Comm_group (MPI_COMM_WORLD, &MPI_GROUP_WORLD);
-  MPI_Group_incl (MPI_GROUP_WORLD, simInfo.numWalkers, walkerLeadersID, &WalkersGroup);
+  MPI_Group_incl (MPI_GROUP_WORLD, numWalkerLeaders, walkerLeadersID, &WalkersGroup);
   MPI_Comm_create (MPI_COMM_WORLD, WalkersGroup, &MCAlgorithmComm.communicator);
 
   MCAlgorithmComm.initialize();
@@ -8,6 +8,7 @@
 //enum type_name {integer = 1, single_precision = 2, double_precision = 3};
 //typedef int ObservableType;
 typedef double       ObservableType;
+typedef long int     IntegerObservableType;      // energies of discrete systems (PhysicalSystem::hasIntegerEnergy)
 typedef unsigned int indexType;
 
 struct SimulationInfo
@@ -24,6 +25,7 @@ struct SimulationInfo
   // MPI info
   int  numWalkers            {1};
   int  numMPIranksPerWalker  {1};
+  int  numThreadsPerRank     {1};                    // walkers per MPI rank, one thread each (WL and REWL)
   int  myWalkerID            {-1};
   int  numberOfWindows       {-1};                   // only valid for REWL, will remain -1 for other MC algorithms
   int  numberOfWalkersPerWindow {-1};                // ditto
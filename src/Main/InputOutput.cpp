@@ -97,6 +97,10 @@ void readMainInputFile(const char* FileName)
             //std::cout << "Simulation Info: Number of MPI ranks random walker = Number of MPI ranks per physical system = " << simInfo.numMPIranksPerWalker << "\n";
             continue;
           }
+          else if (key == "numberOfThreadsPerRank") {
+            lineStream >> simInfo.numThreadsPerRank;
+            continue;
+          }
         
         }
 
@@ -4,9 +4,12 @@
 #include <iostream>
 #include "Globals.hpp"
 #include "MonteCarloAlgorithms/MCAlgorithms.hpp"
+#include "MonteCarloAlgorithms/CheckpointWriter.hpp"
 #include "MonteCarloAlgorithms/Metropolis.hpp"
 #include "MonteCarloAlgorithms/WangLandauSampling.hpp"
+#include "MonteCarloAlgorithms/SharedDOSWangLandauSampling.hpp"
 #include "MonteCarloAlgorithms/ReplicaExchangeWangLandau.hpp"
+#include "MonteCarloAlgorithms/ThreadedReplicaExchangeWangLandau.hpp"
 #include "MonteCarloAlgorithms/MulticanonicalSampling.hpp"
 #include "MonteCarloAlgorithms/HistogramFreeMUCA.hpp"
 #include "PhysicalSystems/Heisenberg2D.hpp"
@@ -32,12 +35,11 @@ void readCommandLineArguments(int argc, char* argv[]) {
 
 }
 
-void setSimulation(PhysicalSystem*      &physical_system,
-                   MonteCarloAlgorithm* &MC,
-                   MPICommunicator      physicalSystemComm,
-                   MPICommunicator      mcAlgorithmComm)
+PhysicalSystem* createPhysicalSystem([[maybe_unused]] MPICommunicator physicalSystemComm)     // used by QE only
 {
-  
+
+  PhysicalSystem* physical_system {nullptr};
+
   // Determine Physical System 
   // 1:  QuantumExpresso
   // 2:  LSMS  
@@ -102,6 +104,19 @@ void setSimulation(PhysicalSystem*      &physical_system,
       exit(10);
   }
 
+  return physical_system;
+
+}
+
+
+void setSimulation(PhysicalSystem*      &physical_system,
+                   MonteCarloAlgorithm* &MC,
+                   MPICommunicator      physicalSystemComm,
+                   MPICommunicator      mcAlgorithmComm)
+{
+  
+  physical_system = createPhysicalSystem( physicalSystemComm );
+
   // Determine MC algorithm
   //  1. Metropolis sampling
   //  2. Wang-Landau sampling
@@ -115,7 +130,20 @@ void setSimulation(PhysicalSystem*      &physical_system,
       break;
 
     case 2 :
-      MC = new WangLandauSampling( physical_system );
+      // Walkers sharing one DOS: one physical system per thread; the MC algorithm deletes all but the first
+      if (simInfo.numThreadsPerRank > 1) {
+        std::vector<PhysicalSystem*> physical_systems {physical_system};
+        for (int thread=1; thread<simInfo.numThreadsPerRank; thread++)
+          physical_systems.push_back( createPhysicalSystem( physicalSystemComm ) );
+        if (physical_system -> hasIntegerEnergy)
+          MC = new SharedDOSWangLandauSampling<IntegerObservableType>( physical_systems );
+        else
+          MC = new SharedDOSWangLandauSampling<ObservableType>( physical_systems );
+      }
+      else if (physical_system -> hasIntegerEnergy)
+        MC = new WangLandauSampling<IntegerObservableType>( physical_system );
+      else
+        MC = new WangLandauSampling<ObservableType>( physical_system );
       break;
 
     case 3 :
@@ -128,7 +156,20 @@ void setSimulation(PhysicalSystem*      &physical_system,
       break;
 
     case 5 :
-      MC = new ReplicaExchangeWangLandau( physical_system, physicalSystemComm, mcAlgorithmComm );
+      // Threaded walkers: one physical system per thread; the MC algorithm deletes all but the first
+      if (simInfo.numThreadsPerRank > 1) {
+        std::vector<PhysicalSystem*> physical_systems {physical_system};
+        for (int thread=1; thread<simInfo.numThreadsPerRank; thread++)
+          physical_systems.push_back( createPhysicalSystem( physicalSystemComm ) );
+        if (physical_system -> hasIntegerEnergy)
+          MC = new ThreadedReplicaExchangeWangLandau<IntegerObservableType>( physical_systems, mcAlgorithmComm );
+        else
+          MC = new ThreadedReplicaExchangeWangLandau<ObservableType>( physical_systems, mcAlgorithmComm );
+      }
+      else if (physical_system -> hasIntegerEnergy)
+        MC = new ReplicaExchangeWangLandau<IntegerObservableType>( physical_system, physicalSystemComm, mcAlgorithmComm );
+      else
+        MC = new ReplicaExchangeWangLandau<ObservableType>( physical_system, physicalSystemComm, mcAlgorithmComm );
       break;
       
     case 6 :
@@ -137,7 +178,7 @@ void setSimulation(PhysicalSystem*      &physical_system,
     
     default :
       std::cout << "Monte Carlo algorithm not specified. Use default: Wang-Landau sampling.\n";
-      MC = new WangLandauSampling( physical_system );
+      MC = new WangLandauSampling<ObservableType>( physical_system );
   }
 
 }
@@ -147,6 +188,9 @@ void finalizeSimulation(PhysicalSystem*      &physical_system,
                         MonteCarloAlgorithm* &MC)
 {
   
+  // Checkpoint files still being written are completed first
+  checkpointWriter.finalize();
+
   delete physical_system;
   delete MC;
 
@@ -0,0 +1,21 @@
+#include "BoltzmannAcceptance.hpp"
+
+
+void BoltzmannAcceptance::setTemperature(double T, bool integerEnergy)
+{
+
+  temperature = T;
+  useTable    = integerEnergy;
+  boltzmannFactors.clear();
+
+}
+
+
+// The factors up to energyChange are computed in one go
+void BoltzmannAcceptance::extendTable(size_t energyChange)
+{
+
+  for (size_t dE = boltzmannFactors.size(); dE <= energyChange; dE++)
+    boltzmannFactors.push_back(exp(-double(dE) / temperature));
+
+}
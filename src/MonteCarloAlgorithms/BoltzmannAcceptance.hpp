@@ -0,0 +1,67 @@
+#ifndef BOLTZMANN_ACCEPTANCE_HPP
+#define BOLTZMANN_ACCEPTANCE_HPP
+
+#include <cmath>
+#include <vector>
+#include "Main/Globals.hpp"
+#include "Utilities/RandomNumberGenerator.hpp"
+
+/*
+  BoltzmannAcceptance class:
+
+  The Metropolis criterion exp(-dE / T) > u at one temperature, for a move from energy
+  to trialEnergy. Moves with dE <= 0 are accepted without exp() or a random number.
+
+  For systems whose energy only takes integer values (PhysicalSystem::hasIntegerEnergy),
+  dE takes few values, and exp(-dE / T) is taken from a table filled the first time each
+  dE comes up (up to maxTableSize; larger dE, and all other systems, call exp()). The
+  table holds exactly the values exp() gives, so it does not change any decision.
+
+  The uniforms u are drawn in blocks (UniformRandomBuffer) from the RNG of the thread.
+*/
+
+class BoltzmannAcceptance {
+
+public :
+
+  void setTemperature(double T, bool integerEnergy);        // clears the table
+  bool accept(ObservableType energy, ObservableType trialEnergy);
+
+private :
+
+  static constexpr size_t maxTableSize {1 << 16};
+
+  double              temperature;
+  bool                useTable {false};
+  std::vector<double> boltzmannFactors;                      // exp(-dE / T) for dE = 0, 1, 2, ...
+
+  UniformRandomBuffer uniforms;
+
+  void extendTable(size_t energyChange);
+
+};
+
+
+// Inline member functions
+
+inline bool BoltzmannAcceptance::accept(ObservableType energy, ObservableType trialEnergy)
+{
+
+  ObservableType energyChange = trialEnergy - energy;
+  if (energyChange <= 0.0) return true;
+
+  double boltzmannFactor;
+  if (useTable && energyChange < double(maxTableSize)) {
+    size_t index = size_t(energyChange);
+    if (index >= boltzmannFactors.size())
+      extendTable(index);
+    boltzmannFactor = boltzmannFactors[index];
+  }
+  else
+    boltzmannFactor = exp(-energyChange / temperature);
+
+  return boltzmannFactor > uniforms.get();
+
+}
+
+#endif
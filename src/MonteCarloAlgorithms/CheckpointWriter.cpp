@@ -0,0 +1,209 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <utility>
+#include "CheckpointWriter.hpp"
+
+CheckpointWriter checkpointWriter;
+
+
+// Constructor
+CheckpointWriter::CheckpointWriter() :
+  writing(false), stopping(false)
+{}
+
+
+// Destructor
+CheckpointWriter::~CheckpointWriter()
+{
+  finalize();
+}
+
+
+/////////////////////////////
+// Public member functions //
+/////////////////////////////
+
+void CheckpointWriter::finalize()
+{
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  jobStaged.notify_all();
+
+  // The I/O thread writes all staged jobs before it stops
+  if (ioThread.joinable())
+    ioThread.join();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  stopping = false;
+
+}
+
+
+std::vector<char> CheckpointWriter::getBuffer()
+{
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  if (freeBuffers.empty())
+    return std::vector<char>();
+
+  std::vector<char> buffer = std::move(freeBuffers.back());
+  freeBuffers.pop_back();
+  return buffer;
+
+}
+
+
+void CheckpointWriter::writeFile(const char* fileName, std::vector<char>&& image)
+{
+
+  Job job;
+  job.fileName = fileName;
+  job.data     = std::move(image);
+
+  stageJob(std::move(job));
+
+}
+
+
+// print formats the file into a memory stream, whose bytes are then staged as with writeFile()
+void CheckpointWriter::writeTextFile(const char* fileName, const std::function<void(FILE*)>& print)
+{
+
+  char*  text;
+  size_t length;
+  FILE*  textStream = open_memstream(&text, &length);
+  print(textStream);
+  fclose(textStream);
+
+  std::vector<char> image = getBuffer();
+  image.assign(text, text + length);
+  free(text);
+  writeFile(fileName, std::move(image));
+
+}
+
+
+void CheckpointWriter::writeConfiguration(PhysicalSystem* ps, int format, const char* fileName)
+{
+
+  char*  text;
+  size_t length;
+  ps -> configurationStream = open_memstream(&text, &length);
+  ps -> writeConfiguration(format, fileName);
+
+  // The system wrote fileName itself
+  if (ps -> configurationStream != NULL) {
+    fclose(ps -> configurationStream);
+    ps -> configurationStream = NULL;
+    free(text);
+    return;
+  }
+
+  std::vector<char> image = getBuffer();
+  image.assign(text, text + length);
+  free(text);
+  writeFile(fileName, std::move(image));
+
+}
+
+
+void CheckpointWriter::flush()
+{
+
+  std::unique_lock<std::mutex> lock(mutex);
+  jobsWritten.wait(lock, [&] { return jobs.empty() && !writing; });
+
+}
+
+
+//////////////////////////////
+// Private member functions //
+//////////////////////////////
+
+void CheckpointWriter::stageJob(Job&& job)
+{
+
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+
+    // A newer snapshot of a file still waiting replaces the older one
+    for (Job& staged : jobs) {
+      if (staged.fileName == job.fileName) {
+        std::swap(staged.data, job.data);
+        job.data.clear();
+        freeBuffers.push_back(std::move(job.data));
+        return;
+      }
+    }
+
+    jobTaken.wait(lock, [&] { return jobs.size() < maxStagedJobs; });
+    jobs.push_back(std::move(job));
+
+    // The I/O thread starts with the first checkpoint
+    if (!ioThread.joinable())
+      ioThread = std::thread(&CheckpointWriter::runIOThread, this);
+  }
+  jobStaged.notify_one();
+
+}
+
+
+void CheckpointWriter::runIOThread()
+{
+
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (true) {
+
+    jobStaged.wait(lock, [&] { return stopping || !jobs.empty(); });
+    if (jobs.empty()) return;
+
+    Job job = std::move(jobs.front());
+    jobs.pop_front();
+    writing = true;
+    jobTaken.notify_all();
+
+    lock.unlock();
+    writeJob(job);
+    lock.lock();
+
+    job.data.clear();
+    freeBuffers.push_back(std::move(job.data));
+    writing = false;
+
+    if (jobs.empty())
+      jobsWritten.notify_all();
+
+  }
+
+}
+
+
+// Write to fileName.tmp, then rename it to fileName
+void CheckpointWriter::writeJob(Job& job)
+{
+
+  std::string tmpFileName = job.fileName + ".tmp";
+
+  FILE* checkPointFile = fopen(tmpFileName.c_str(), "wb");
+  if (checkPointFile == NULL) {
+    std::cerr << "     ERROR! Cannot open checkpoint file " << tmpFileName << " for writing\n";
+    return;
+  }
+
+  bool success = (fwrite(job.data.data(), 1, job.data.size(), checkPointFile) == job.data.size());
+
+  if (fclose(checkPointFile) != 0 || !success) {
+    std::cerr << "     ERROR! Problem writing checkpoint file " << tmpFileName << "\n";
+    return;
+  }
+
+  if (std::rename(tmpFileName.c_str(), job.fileName.c_str()) != 0)
+    std::cerr << "     ERROR! Cannot rename " << tmpFileName << " to " << job.fileName << "\n";
+
+}
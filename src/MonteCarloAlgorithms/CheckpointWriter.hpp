@@ -0,0 +1,89 @@
+#ifndef CHECKPOINT_WRITER_HPP
+#define CHECKPOINT_WRITER_HPP
+
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "PhysicalSystems/PhysicalSystemBase.hpp"
+#include "Main/Globals.hpp"
+
+/*
+  CheckpointWriter class:
+
+  Writes checkpoint files on a background I/O thread, so that the sampling loop only
+  pays for copying its state into memory. A caller stages a snapshot (the binary image
+  of a histogram, a packed configuration, or any other bytes) and returns at once; the
+  I/O thread writes it to fileName.tmp and renames it to fileName when complete, so a
+  checkpoint file on disk is always either the old or the new one in full, even if the
+  run is killed while writing.
+
+  Staging buffers are recycled once written, so after the first checkpoint a snapshot
+  is a copy into memory that is already allocated. Files are written in the order they
+  are staged. flush() waits until everything staged so far is on disk; call it before
+  writing the same file synchronously, and before the end of the run.
+
+  At most maxStagedJobs snapshots wait for the I/O thread. A newer snapshot of a file
+  still waiting replaces the older one in place; any other snapshot blocks the caller
+  until the I/O thread has taken a job. A slow disk therefore costs sampling time
+  instead of an ever-growing backlog of memory.
+
+  Text files are printed into memory by the caller (writeTextFile) and staged as bytes.
+
+  Configurations are written in the text format of PhysicalSystem::writeConfiguration().
+  The caller formats its configuration into memory (PhysicalSystem::configurationStream),
+  so only the file output is left to the I/O thread. Systems that open their files
+  otherwise, such as QuantumEspressoSystem, write them synchronously.
+
+  All public member functions may be called from several threads.
+*/
+
+class CheckpointWriter {
+
+public :
+
+  CheckpointWriter();
+  ~CheckpointWriter();
+
+  void finalize();                                                    // flush and stop the I/O thread
+
+  std::vector<char> getBuffer();                                      // an empty buffer, recycled if possible
+  void writeFile(const char* fileName, std::vector<char>&& image);     // image is written as is
+  void writeTextFile(const char* fileName, const std::function<void(FILE*)>& print);
+  void writeConfiguration(PhysicalSystem* ps, int format, const char* fileName);
+  void flush();
+
+private :
+
+  struct Job {
+    std::string       fileName;
+    std::vector<char> data;
+  };
+
+  static constexpr size_t        maxStagedJobs {2};
+
+  std::deque<Job>                jobs;                                 // staged, not yet written
+  std::vector<std::vector<char>> freeBuffers;
+  bool                           writing;                              // the I/O thread is writing a job
+  bool                           stopping;
+
+  std::mutex                     mutex;
+  std::condition_variable        jobStaged;
+  std::condition_variable        jobTaken;
+  std::condition_variable        jobsWritten;
+  std::thread                    ioThread;
+
+  // Private member functions:
+  void stageJob(Job&& job);
+  void runIOThread();
+  void writeJob(Job& job);
+
+};
+
+extern CheckpointWriter checkpointWriter;
+
+#endif
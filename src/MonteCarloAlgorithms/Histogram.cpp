@@ -1,13 +1,21 @@
 #include <algorithm>
 #include <cmath>
+#include <cstddef>            // offsetof
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <limits>
 #include <string>             // std::string
 #include <sstream>            // std::istringstream
+#include <utility>            // std::move
+#include <fcntl.h>            // open
+#include <sys/mman.h>         // mmap, munmap
+#include <sys/stat.h>         // fstat
+#include <unistd.h>           // close
 #include "Histogram.hpp"
+#include "CheckpointWriter.hpp"
 #include "Main/Communications.hpp"
 #include "Utilities/CheckFile.hpp"
 
@@ -15,13 +23,14 @@
 //TODO: Markus: Refer to PRE 84, 065702(R) 2011 to set binSize.
 
 // Constructor
-Histogram::Histogram(int restart, const char* inputFile, const char* checkPointFile)
+template <typename EnergyType>
+Histogram<EnergyType>::Histogram(int restart, const char* inputFile, const char* checkPointFile, int walker)
 {
 
   std::cout << "\nInitializing histogram...\n";
 
-  Emax = std::numeric_limits<ObservableType>::max();
-  Emin = std::numeric_limits<ObservableType>::lowest();
+  Emax = std::numeric_limits<EnergyType>::max();
+  Emin = std::numeric_limits<EnergyType>::lowest();
 
   numberOfWindows          = 1;           // default to =1 if not specified in input file
   numberOfWalkersPerWindow = 1;
@@ -29,6 +38,21 @@ Histogram::Histogram(int restart, const char* inputFile, const char* checkPointF
   walkerID = 0;
   myWindow = 0;
 
+  histogramFileFormat = 1;                // binary checkpoints unless specified in input file
+  histogramPageSize   = 1024;             // lazily allocated pages unless specified in input file
+
+  dim       = 1;                          // 1D histogram in energy unless specified in input file
+  blockSize = 0;                          // 0: choose a block size from dim
+
+  nonUniformBinning      = false;         // uniform energy bins unless binEdges or binRefinement is given
+  binRefinement          = 0;
+  binRefinementThreshold = 1.0;
+  binSizeMin             = 0.0;           // 0: a sixteenth of the narrowest initial bin
+
+  modFactorSchedule      = 0;             // reduce log(f) by modFactorReducer unless specified in input file
+  roundTripStatistics    = 0;
+  windowsRebalanced      = 0;
+
   // Read input file
   if ( file_exists(inputFile) )
     readMCInputFile(inputFile);
@@ -37,29 +61,46 @@ Histogram::Histogram(int restart, const char* inputFile, const char* checkPointF
     exit(7);
   }
 
+  if (modFactorSchedule != 0 && modFactorSchedule != 1) {
+    std::cerr << "   Error: modFactorSchedule must be 0 or 1. Quiting... \n";
+    exit(7);
+  }
+
   // Read checkpoint file, or initialize anew
-  if (restart && file_exists(checkPointFile) )
+  if (restart && file_exists(checkPointFile) ) {
     readHistogramDOSFile(checkPointFile);
+    setupReadState(checkPointFile);
+  }
   else {
+    // Bin edges from the input file define the global energy range
+    if (!binEdges.empty()) {
+      Emin    = EnergyType(binEdges.front());
+      Emax    = EnergyType(binEdges.back());
+      binSize = EnergyType(binEdges.back() - binEdges.front());
+      for (size_t i=0; i+1<binEdges.size(); i++)
+        binSize = std::min(binSize, EnergyType(binEdges[i+1] - binEdges[i]));
+    }
+
     // Calculate quantities based on the variables read in
-    double energySubwindowWidth = (Emax - Emin) / (1.0 + double(numberOfWindows - 1)*(1.0 - overlap));
+    double energySubwindowWidth = double(Emax - Emin) / (1.0 + double(numberOfWindows - 1)*(1.0 - overlap));
 
     // Round upward to the closest binSize
-    energySubwindowWidth = ceil(energySubwindowWidth / binSize) * binSize;
+    energySubwindowWidth = ceil(energySubwindowWidth / double(binSize)) * double(binSize);
 
-    walkerID = (GlobalComm.thisMPIrank - (GlobalComm.thisMPIrank % simInfo.numMPIranksPerWalker)) / simInfo.numMPIranksPerWalker;
+    if (walker >= 0)
+      walkerID = walker;
+    else
+      walkerID = (GlobalComm.thisMPIrank - (GlobalComm.thisMPIrank % simInfo.numMPIranksPerWalker)) / simInfo.numMPIranksPerWalker;
     myWindow = ( walkerID - (walkerID % numberOfWalkersPerWindow) ) / numberOfWalkersPerWindow;
-    Emin     = Emin + double(myWindow) * (1.0 - overlap) * energySubwindowWidth;
-    Emax     = Emin + energySubwindowWidth;
-    numBins  = unsigned(ceil((Emax - Emin) / binSize)) + 1;
+    Emin     = Emin + EnergyType(double(myWindow) * (1.0 - overlap) * energySubwindowWidth);
+    Emax     = Emin + EnergyType(energySubwindowWidth);
+    setupBinEdges();
+    setupAxes();
 
     // YingWai's check
     //printf("YingWai's check: Inside Histogram constructor. world_rank = %3d, myWindow = %3d, walkerID = %3d, Emin = %6.3f, Emax = %6.3f \n", GlobalComm.thisMPIrank, myWindow, walkerID, Emin, Emax);
 
-    hist.assign(numBins, 0);
-    dos.assign(numBins, 0.0);
-    visited.assign(numBins, 0);
-    probDistribution.assign(numBins, 0.0);
+    allocateArrays();
 
     totalMCsteps            = 0;
     acceptedMoves           = 0;
@@ -74,8 +115,11 @@ Histogram::Histogram(int restart, const char* inputFile, const char* checkPointF
     // MUCA:
     KullbackLeiblerDivergence = 0.0;
 
+    resetRoundTripStatistics();
   }
 
+  setupBookkeeping();
+
   idx           = -1;
   histogramFlat = false;
 
@@ -84,11 +128,13 @@ Histogram::Histogram(int restart, const char* inputFile, const char* checkPointF
 
 
 // Destructor
-Histogram::~Histogram()
+template <typename EnergyType>
+Histogram<EnergyType>::~Histogram()
 {
-  hist.clear();
-  dos.clear();
-  visited.clear();
+  hist.assign(0, 0);
+  dos.assign(0, 0);
+  visited.assign(0, 0);
+  probDistribution.assign(0, 0);
 
   //printf("Histogram class is destroyed.\n");  
 
@@ -96,231 +142,773 @@ Histogram::~Histogram()
 
 
 // Public member functions
-ObservableType Histogram::getBinSize()
+template <typename EnergyType>
+EnergyType Histogram<EnergyType>::getBinSize()
 {
   return binSize;
 }
 
 
-unsigned int Histogram::getNumberOfBins()
+template <typename EnergyType>
+unsigned int Histogram<EnergyType>::getNumberOfBins()
 {
   return numBins;
 }
 
 
-double Histogram::getDOS(ObservableType energy)
+template <typename EnergyType>
+int Histogram<EnergyType>::getDimension()
 {
-  idx = getIndex(energy);
-  if (idx >= 0)
-    return dos[unsigned(idx)];
-  else {
-    std::cerr << "Problem in File " << __FILE__ << " Line " << __LINE__  << "\n";
-    exit(EXIT_FAILURE);
-  }
-  
+  return dim;
 }
 
 
-void Histogram::setEnergyRange(ObservableType E1, ObservableType E2)
+template <typename EnergyType>
+void Histogram<EnergyType>::setEnergyRange(EnergyType E1, EnergyType E2)
 {
   Emin = E1;
   Emax = E2;
 }
 
 
-void Histogram::setBinSize(ObservableType dE)
+template <typename EnergyType>
+void Histogram<EnergyType>::setBinSize(EnergyType dE)
 {
   binSize = dE;
 }
 
 
-void Histogram::setNumberOfBins(unsigned int n)
+template <typename EnergyType>
+void Histogram<EnergyType>::setNumberOfBins(unsigned int n)
 {
   numBins = n;
   // need to resize hist and dos accordingly
 }
 
 
-void Histogram::resetHistogram()
+template <typename EnergyType>
+void Histogram<EnergyType>::resetHistogram()
 {
-  for (unsigned int i=0; i<numBins; i++) {
-    hist[i] = 0;
-    //std::fill(hist.begin(), hist.end(), 0);      // Intel compiler has problem with it!
-    probDistribution[i] = 0.0;
-  }
+  hist.reset();
+  probDistribution.reset();
   numHistogramNotImproved = 0;
   numBinsFailingCriterion = numBins;
   numHistogramRefreshed = 0;
+  resetFlatnessBookkeeping();
 }
 
 
-void Histogram::refreshHistogram()
+template <typename EnergyType>
+void Histogram<EnergyType>::refreshHistogram()
 {
-  for (unsigned int i=0; i<numBins; i++) {
-    hist[i] = 0;
-    probDistribution[i] = 0.0;
-  }
+  hist.reset();
+  probDistribution.reset();
 
   numHistogramNotImproved = 0;
   numBinsFailingCriterion = numBins;
   numHistogramRefreshed++;
+  resetFlatnessBookkeeping();
 }
 
 
-void Histogram::resetDOS()
+template <typename EnergyType>
+void Histogram<EnergyType>::resetDOS()
 {
-  for (unsigned int i=0; i<numBins; i++)
-    dos[i] = 0.0;
-    //std::fill(dos.begin(), dos.end(), 0.0);      // Intel compiler has problem with it!
-}
-
-
-void Histogram::updateHistogramDOS(ObservableType energy)
-{
-  idx = getIndex(energy);
-
-  if ( idx >= 0 ) {
-    unsigned int index = unsigned(idx);
-    // If it is the first time a bin is visited:
-    //   1. see if it can reference the DOS from neighboring bins
-    //   2. reset Histogram and start over
-    if ( visited[index] == 0 ) {
-      unsigned int refIdx = index;
-      if ( index == 0 )
-        refIdx = 1;
-      else if ( index == (numBins-1) )
-        refIdx = index - 1;
-      else {
-        if ( (visited[index-1] > 0) && (visited[index+1] > 0) )
-          refIdx = ( dos[index-1] < dos[index+1] ? (index-1) : (index+1) );
-        else if ( visited[index-1] == 0 )
-          refIdx = index + 1;
-        else if ( visited[index+1] == 0 )
-          refIdx = index - 1;
+  dos.reset();
+}
+
+
+// If it is the first time a bin is visited:
+//   1. see if it can reference the DOS from neighboring bins
+//   2. reset Histogram and start over
+template <typename EnergyType>
+void Histogram<EnergyType>::visitNewBin(unsigned int index)
+{
+  if (dim > 1) {
+    // Take the lowest DOS among the visited nearest neighbors along all axes,
+    // or among all visited bins if there is none
+    std::vector<unsigned int> coordinates(static_cast<size_t>(dim));
+    getBinCoordinates(index, coordinates);
+
+    bool   foundReference = false;
+    double referenceDOS   = 0.0;
+    for (unsigned int d=0; d<unsigned(dim); d++) {
+      unsigned int center = coordinates[d];
+      for (int step=-1; step<=1; step+=2) {
+        if ((step < 0 && center == 0) || (step > 0 && center + 1 >= axisNumBins[d])) continue;
+        coordinates[d] = (step < 0) ? center - 1 : center + 1;
+        unsigned int neighbor = getStorageIndex(coordinates);
+        if (visited[neighbor] == 1 && (!foundReference || dos[neighbor] < referenceDOS)) {
+          referenceDOS   = dos[neighbor];
+          foundReference = true;
+        }
       }
+      coordinates[d] = center;
+    }
 
-      dos[index] = dos[refIdx];
-      visited[index] = 1;
-      refreshHistogram();
+    if (!foundReference) {
+      for (size_t p=0; p<visited.numPages(); p++) {
+        if (!visited.pageAllocated(p)) continue;
+        for (size_t i=visited.pageBegin(p); i<visited.pageEnd(p); i++) {
+          if (visited[i] == 1 && (!foundReference || dos[i] < referenceDOS)) {
+            referenceDOS   = dos[i];
+            foundReference = true;
+          }
+        }
+      }
     }
-    else {
-      dos[index] += modFactor;
-      hist[index]++;
-      //visited[index] = 1;
+
+    dos.ref(index) = referenceDOS;
+    addVisitedBin(index);
+    refreshHistogram();
+    return;
+  }
+
+  // Bins created by refineBins() carry the DOS of the bin they were split from,
+  // and bins of rebalanced windows the DOS stitched from the old windows
+  if ((nonUniformBinning || windowsRebalanced) && dos[index] != 0.0) {
+    addVisitedBin(index);
+    refreshHistogram();
+    return;
+  }
+
+  unsigned int refIdx = index;
+  if ( index == 0 )
+    refIdx = 1;
+  else if ( index == (numBins-1) )
+    refIdx = index - 1;
+  else {
+    if ( (visited[index-1] > 0) && (visited[index+1] > 0) )
+      refIdx = ( dos[index-1] < dos[index+1] ? (index-1) : (index+1) );
+    else if ( visited[index-1] == 0 )
+      refIdx = index + 1;
+    else if ( visited[index+1] == 0 )
+      refIdx = index - 1;
+  }
+
+  dos.ref(index) = dos[refIdx];
+  addVisitedBin(index);
+  refreshHistogram();
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::addVisitedBin(unsigned int index)
+{
+  visited.ref(index) = 1;
+  numVisitedBins++;
+
+  unsigned long int entries = hist[index];
+  sumEntries += entries;
+
+  // A bin with fewer entries than binsWithEntries covers needs a rescan (in WL a new bin
+  // refreshes the histogram anyway)
+  if (numVisitedBins == 1 || entries < lowestCountedEntries)
+    findMinimumEntries();
+  else {
+    if (entries - lowestCountedEntries < binsWithEntries.size())
+      binsWithEntries[entries - lowestCountedEntries]++;
+    minEntries = std::min(minEntries, entries);
+  }
+
+  if (roundTripStatistics) {
+    unsigned int energyBin = getEnergyBin(index);
+    if (numVisitedBins == 1)
+      lowestVisitedBin = highestVisitedBin = energyBin;
+    lowestVisitedBin  = std::min(lowestVisitedBin, energyBin);
+    highestVisitedBin = std::max(highestVisitedBin, energyBin);
+  }
+}
+
+
+// The next count with bins is one above the minimum after countEntry (count above it after
+// addEntries), so the search is short. It only runs off the end of binsWithEntries after the
+// bins at the minimum of the last rescan have moved past it, which takes binsWithEntries.size()
+// entries at least.
+template <typename EnergyType>
+void Histogram<EnergyType>::advanceMinimumEntries()
+{
+  size_t level = minEntries - lowestCountedEntries;
+  while (level < binsWithEntries.size() && binsWithEntries[level] == 0)
+    level++;
+
+  if (level < binsWithEntries.size())
+    minEntries = lowestCountedEntries + level;
+  else
+    findMinimumEntries();
+}
+
+
+// binsWithEntries gets one count per bin held in memory, so that the rescan, which goes over
+// all of them, costs O(1) per histogram entry until the next one.
+template <typename EnergyType>
+void Histogram<EnergyType>::findMinimumEntries()
+{
+  minEntries = std::numeric_limits<unsigned long int>::max();
+  size_t numAllocatedBins = 0;
+
+  for (size_t p=0; p<visited.numPages(); p++) {
+    if (!visited.pageAllocated(p)) continue;
+    numAllocatedBins += visited.pageEnd(p) - visited.pageBegin(p);
+    for (size_t i=visited.pageBegin(p); i<visited.pageEnd(p); i++)
+      if ((visited[i] == 1) && (hist[i] < minEntries))
+        minEntries = hist[i];
+  }
+  if (minEntries == std::numeric_limits<unsigned long int>::max()) minEntries = 0;
+
+  lowestCountedEntries = minEntries;
+  binsWithEntries.assign(std::max(numAllocatedBins, size_t(1)), 0);
+  for (size_t p=0; p<visited.numPages(); p++) {
+    if (!visited.pageAllocated(p)) continue;
+    for (size_t i=visited.pageBegin(p); i<visited.pageEnd(p); i++)
+      if ((visited[i] == 1) && (hist[i] - lowestCountedEntries < binsWithEntries.size()))
+        binsWithEntries[hist[i] - lowestCountedEntries]++;
+  }
+}
+
+
+// Same as count calls of updateHistogramDOS for this bin: the first visit of a bin
+// only takes the DOS of a reference bin, and all other entries add modFactor each.
+template <typename EnergyType>
+void Histogram<EnergyType>::addEntries(unsigned int index, unsigned long int count)
+{
+  if (count == 0) return;
+
+  if (visited[index] == 0) {
+    visitNewBin(index);
+    if (--count == 0) return;
+  }
+
+  dos.ref(index) += double(count) * modFactor;
+
+  unsigned long int& entries = hist.ref(index);
+  unsigned long int level = entries - lowestCountedEntries;
+  entries    += count;
+  sumEntries += count;
+
+  if (level >= binsWithEntries.size()) return;
+  binsWithEntries[level]--;
+  if (level + count < binsWithEntries.size())
+    binsWithEntries[level + count]++;
+  if (level == minEntries - lowestCountedEntries && binsWithEntries[level] == 0)
+    advanceMinimumEntries();
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::resetFlatnessBookkeeping()
+{
+  numVisitedBins = 0;
+  sumEntries     = 0;
+  for (size_t p=0; p<visited.numPages(); p++) {
+    if (!visited.pageAllocated(p)) continue;
+    for (size_t i=visited.pageBegin(p); i<visited.pageEnd(p); i++) {
+      if (visited[i] == 1) {
+        numVisitedBins++;
+        sumEntries += hist[i];
+      }
     }
   }
-  else { 
-    std::cerr << "Error: idx < 0 in updateHistogramDOS!!\n";
-    std::cerr << "Aborting...\n";
-    exit(10);
+  findMinimumEntries();
+  lastFlatnessRatio = 0.0;
+}
+
+
+// Everything derived from the bins, after they were set up anew or read
+template <typename EnergyType>
+void Histogram<EnergyType>::setupBookkeeping()
+{
+  setBinSizeReciprocal();
+  resetFlatnessBookkeeping();
+  findVisitedEnergyRange();
+
+  // After a restart, the bins reached by the interrupted upward pass are not counted again
+  firstPassageMark.assign(firstPassageSteps.size(), passNumber);
+
+  // A restarted 1/t run resumes in the 1/t phase if log(f) already follows 1/t
+  oneOverTPhase = (modFactorSchedule == 1 && totalMCsteps > 0 &&
+                   modFactor <= getOneOverT() * (1.0 + 1.0e-12));
+}
+
+
+template <typename EnergyType>
+unsigned int Histogram<EnergyType>::getEnergyBin(unsigned int index)
+{
+  if (dim == 1) return index;
+
+  std::vector<unsigned int> binCoordinates(static_cast<size_t>(dim));
+  getBinCoordinates(index, binCoordinates);
+  return binCoordinates[0];
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::findVisitedEnergyRange()
+{
+  lowestVisitedBin  = std::numeric_limits<unsigned int>::max();
+  highestVisitedBin = 0;
+  for (size_t p=0; p<visited.numPages(); p++) {
+    if (!visited.pageAllocated(p)) continue;
+    for (size_t i=visited.pageBegin(p); i<visited.pageEnd(p); i++) {
+      if (visited[i] == 1) {
+        unsigned int energyBin = getEnergyBin(unsigned(i));
+        lowestVisitedBin  = std::min(lowestVisitedBin, energyBin);
+        highestVisitedBin = std::max(highestVisitedBin, energyBin);
+      }
+    }
   }
-  //std::cerr << "energy = " << energy << "\n";
-  //std::cerr << "idx = " << idx << "\n";
-  //std::cerr << "visited[idx] = " << visited[idx] << "\n";
-  //std::cerr << "hist[idx] = " << hist[idx] << "\n";
+  if (lowestVisitedBin > highestVisitedBin)
+    lowestVisitedBin = highestVisitedBin = 0;
 }
 
-void Histogram::updateHistogram(ObservableType energy)
+
+template <typename EnergyType>
+void Histogram<EnergyType>::resetRoundTripStatistics()
+{
+  roundTripClock      = 0;
+  roundTripStart      = 0;
+  roundTripDirection  = 0;
+  numRoundTrips       = 0;
+  roundTripSteps      = 0;
+  numTunnelings       = 0;
+  tunnelingSteps      = 0;
+  passNumber          = 0;
+  globalDirection     = 0;
+  numGlobalRoundTrips = 0;
+
+  size_t numEnergyBins = roundTripStatistics ? axisNumBins[0] : 0;
+  firstPassageSteps.assign(numEnergyBins, 0);
+  firstPassageCount.assign(numEnergyBins, 0);
+  firstPassageMark.assign(numEnergyBins, 0);
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::printRoundTripStatistics(const char* label)
 {
-  idx = getIndex(energy);
-  hist[unsigned(idx)]++;
-  visited[unsigned(idx)] = 1;
+  if (!roundTripStatistics) return;
+
+  printf("%sRound trips: %lu (%.4e MC steps each), tunnelings: %lu (%.4e MC steps each), global round trips: %lu\n",
+         label, numRoundTrips, (numRoundTrips > 0) ? double(roundTripSteps) / double(numRoundTrips) : 0.0,
+         numTunnelings, (numTunnelings > 0) ? double(tunnelingSteps) / double(numTunnelings) : 0.0,
+         numGlobalRoundTrips);
+}
+
+
+template <typename EnergyType>
+unsigned int Histogram<EnergyType>::countBinsFailingCriterion()
+{
+  if (numVisitedBins == 0) return 0;
+
+  double flatnessReference = flatnessCriterion * double(sumEntries) / double(numVisitedBins);
+  unsigned int numFailing = 0;
+  for (size_t p=0; p<visited.numPages(); p++) {
+    if (!visited.pageAllocated(p)) continue;
+    for (size_t i=visited.pageBegin(p); i<visited.pageEnd(p); i++)
+      if ((visited[i] == 1) && (double(hist[i]) < flatnessReference))
+        numFailing++;
+  }
+
+  return numFailing;
+}
+
+template <typename EnergyType>
+void Histogram<EnergyType>::updateHistogram(ObservableType energy)
+{
+  idx = getIndex(toEnergyType(energy));
+  if (visited[unsigned(idx)] == 1)
+    countEntry(unsigned(idx));
+  else {
+    hist.ref(unsigned(idx))++;
+    addVisitedBin(unsigned(idx));
+  }
   //std::cerr << "idx = " << idx << "\n";
   //std::cerr << "visited[idx] = " << visited[idx] << "\n";
 }
 
-void Histogram::updateDOS(ObservableType energy)
+template <typename EnergyType>
+void Histogram<EnergyType>::updateHistogram(const std::vector<ObservableType>& observables)
+{
+  idx = getIndex(observables);
+  if (idx < 0) {
+    std::cerr << "Error: idx < 0 in updateHistogram!!\n";
+    std::cerr << "Aborting...\n";
+    exit(10);
+  }
+  if (visited[unsigned(idx)] == 1)
+    countEntry(unsigned(idx));
+  else {
+    hist.ref(unsigned(idx))++;
+    addVisitedBin(unsigned(idx));
+  }
+}
+
+template <typename EnergyType>
+void Histogram<EnergyType>::updateDOS(ObservableType energy)
 {
-  idx = getIndex(energy);
-  dos[unsigned(idx)] += modFactor;
-  visited[unsigned(idx)] = 1;
+  idx = getIndex(toEnergyType(energy));
+  dos.ref(unsigned(idx)) += modFactor;
+  if (visited[unsigned(idx)] == 0)
+    addVisitedBin(unsigned(idx));
   //std::cerr << "idx = " << idx << "\n";
   //std::cerr << "visited[idx] = " << visited[idx] << "\n";
 }
 
-void Histogram::updateDOSwithHistogram()
+template <typename EnergyType>
+void Histogram<EnergyType>::updateDOSwithHistogram()
 {
-  for (unsigned int i=0; i<numBins; i++)
-    if ((visited[i] == 1) && (hist[i] != 0))
-      dos[i] += log(double(hist[i]));
+  for (size_t p=0; p<visited.numPages(); p++) {
+    if (!visited.pageAllocated(p)) continue;
+    for (size_t i=visited.pageBegin(p); i<visited.pageEnd(p); i++)
+      if ((visited[i] == 1) && (hist[i] != 0))
+        dos.ref(i) += log(double(hist[i]));
+  }
 }
 
-bool Histogram::checkEnergyInRange(ObservableType energy)
+template <typename EnergyType>
+void Histogram<EnergyType>::reduceModFactor()
 {
-  bool isWithinRange {false};
-  if (energy < Emin) {
-    //std::cerr << "Energy below range. Energy = " << energy << "\n";
-    numBelowRange++; 
-    isWithinRange = false;
+  if (oneOverTPhase) {
+    modFactor = getOneOverT();
+    return;
   }
-  else if (energy > Emax) {
-    //std::cerr << "Energy above range. Energy = " << energy << "\n";
-    numAboveRange++;
-    isWithinRange = false;
+
+  modFactor /= modFactorReducer;
+
+  // 1/t schedule: once log(f) would fall below 1/t, it follows 1/t from now on
+  if (modFactorSchedule == 1 && modFactor <= getOneOverT()) {
+    oneOverTPhase = true;
+    modFactor     = getOneOverT();
   }
-  else {
-    //std::cerr << "Energy within range. Energy = " << energy << "\n";
-    isWithinRange = true;
+}
+
+
+// Average ln g over the walkers of an energy window (Phys. Rev. E 90, 023302 (2014)).
+// Each bin is averaged over the walkers that have visited it, and becomes visited for all.
+// All walkers of the window must have the same bins.
+template <typename EnergyType>
+void Histogram<EnergyType>::averageDOS(MPI_Comm windowComm)
+{
+  std::vector<double> sumDOS(numBins, 0.0);
+  std::vector<int>    numVisits(numBins, 0);
+  for (size_t p=0; p<visited.numPages(); p++) {
+    if (!visited.pageAllocated(p)) continue;
+    for (size_t i=visited.pageBegin(p); i<visited.pageEnd(p); i++) {
+      if (visited[i] == 1) {
+        sumDOS[i]    = dos[i];
+        numVisits[i] = 1;
+      }
+    }
   }
 
-  return isWithinRange;
+  MPI_Allreduce(MPI_IN_PLACE, sumDOS.data(), int(numBins), MPI_DOUBLE, MPI_SUM, windowComm);
+  MPI_Allreduce(MPI_IN_PLACE, numVisits.data(), int(numBins), MPI_INT, MPI_SUM, windowComm);
+
+  for (unsigned int i=0; i<numBins; i++) {
+    if (numVisits[i] == 0) continue;
+    dos.ref(i) = sumDOS[i] / double(numVisits[i]);
+    if (visited[i] == 0) visited.ref(i) = 1;
+  }
 
+  resetFlatnessBookkeeping();
+  if (!firstPassageSteps.empty()) findVisitedEnergyRange();
 }
 
-bool Histogram::checkHistogramFlatness()
+
+// The whole state of an energy window, in the layout of the binary checkpoint file
+template <typename EnergyType>
+void Histogram<EnergyType>::packWindowState(std::vector<char>& image)
 {
-  int numVisitedBins = 0;
-  unsigned long int sumEntries = 0;
+  writeHistogramDOSBinaryImage(image);
+}
 
-  for (unsigned int i=0; i<numBins; i++) {
-    if (visited[i] == 1) {
-      sumEntries += hist[i];
-      numVisitedBins++;
+
+// Take over the energy window of another walker; the global round-trip label and count stay with this walker
+template <typename EnergyType>
+void Histogram<EnergyType>::unpackWindowState(const std::vector<char>& image, int window)
+{
+  int               myGlobalDirection     = globalDirection;
+  unsigned long int myNumGlobalRoundTrips = numGlobalRoundTrips;
+
+  readHistogramDOSBinaryImage(image.data(), image.size(), "of the exchanged window");
+  setupReadState("of the exchanged window");
+  setupBookkeeping();
+
+  myWindow            = window;
+  globalDirection     = myGlobalDirection;
+  numGlobalRoundTrips = myNumGlobalRoundTrips;
+}
+
+
+template <typename EnergyType>
+bool Histogram<EnergyType>::hasUniformEnergyBins()
+{
+  return (dim == 1 && !nonUniformBinning && !binRefinement);
+}
+
+
+template <typename EnergyType>
+double Histogram<EnergyType>::getDistanceFromRange(ObservableType energy)
+{
+  if (energy < double(Emin)) return double(Emin) - energy;
+  if (energy > double(Emax)) return energy - double(Emax);
+  return 0.0;
+}
+
+
+// Move the windows of all walkers (see the class description). Every walker leader computes
+// the same layout from the same gathered data and takes the window given by its argument.
+// log(f) restarts everywhere from the largest one. Returns false, leaving all windows as they
+// are, if the old windows do not overlap in visited bins.
+template <typename EnergyType>
+bool Histogram<EnergyType>::rebalanceWindows(MPI_Comm walkerLeaders, int window)
+{
+  int numLeaders, thisLeader;
+  MPI_Comm_size(walkerLeaders, &numLeaders);
+  MPI_Comm_rank(walkerLeaders, &thisLeader);
+
+  // Window, range, number of bins, MC steps per WL iteration and log(f) of every walker
+  const size_t numFields = 6;
+  double myFields[numFields] = {double(window), double(Emin), double(Emax), double(numBins),
+                                (iterations > 0) ? double(totalMCsteps) / double(iterations) : 0.0, modFactor};
+  std::vector<double> fields(size_t(numLeaders) * numFields);
+  MPI_Allgather(myFields, int(numFields), MPI_DOUBLE, fields.data(), int(numFields), MPI_DOUBLE, walkerLeaders);
+  auto field = [&fields](int walker, size_t f) { return fields[size_t(walker) * numFields + f]; };
+
+  // ln g of every walker; NaN marks bins not visited
+  std::vector<double> myDOS(numBins);
+  for (unsigned int i=0; i<numBins; i++)
+    myDOS[i] = (visited[i] == 1) ? dos[i] : std::numeric_limits<double>::quiet_NaN();
+  std::vector<int> binCounts(static_cast<size_t>(numLeaders));
+  std::vector<int> binDisplacements(static_cast<size_t>(numLeaders), 0);
+  for (int walker=0; walker<numLeaders; walker++) {
+    binCounts[size_t(walker)] = int(field(walker, 3));
+    if (walker > 0)
+      binDisplacements[size_t(walker)] = binDisplacements[size_t(walker)-1] + binCounts[size_t(walker)-1];
+  }
+  std::vector<double> allDOS(size_t(binDisplacements.back() + binCounts.back()));
+  MPI_Allgatherv(myDOS.data(), int(numBins), MPI_DOUBLE, allDOS.data(), binCounts.data(), binDisplacements.data(), MPI_DOUBLE, walkerLeaders);
+
+  // All windows on one grid of global bins
+  double globalEmin = field(0, 1);
+  double globalEmax = field(0, 2);
+  for (int walker=1; walker<numLeaders; walker++) {
+    globalEmin = std::min(globalEmin, field(walker, 1));
+    globalEmax = std::max(globalEmax, field(walker, 2));
+  }
+  double width = double(binSize);
+  size_t numGlobalBins = size_t(ceil((globalEmax - globalEmin) / width)) + 1;
+  std::vector<long int> firstGlobalBin(static_cast<size_t>(numLeaders));
+  for (int walker=0; walker<numLeaders; walker++)
+    firstGlobalBin[size_t(walker)] = lround((field(walker, 1) - globalEmin) / width);
+
+  // Stitch the walkers together in the order of their windows: each is shifted by the mean
+  // difference of ln g over the bins it shares with those before, and shared bins are averaged
+  std::vector<int> order(static_cast<size_t>(numLeaders));
+  for (int walker=0; walker<numLeaders; walker++)
+    order[size_t(walker)] = walker;
+  std::stable_sort(order.begin(), order.end(), [&field](int a, int b) { return field(a, 0) < field(b, 0); });
+
+  std::vector<double> sumDOS(numGlobalBins, 0.0);
+  std::vector<int>    numDOS(numGlobalBins, 0);
+  bool stitched = false;
+  for (int walker : order) {
+    const double* walkerDOS = allDOS.data() + binDisplacements[size_t(walker)];
+    double shift = 0.0;
+    int    numShared = 0;
+    for (int i=0; i<binCounts[size_t(walker)]; i++) {
+      size_t g = size_t(firstGlobalBin[size_t(walker)] + i);
+      if (g < numGlobalBins && !std::isnan(walkerDOS[i]) && numDOS[g] > 0) {
+        shift += sumDOS[g] / double(numDOS[g]) - walkerDOS[i];
+        numShared++;
+      }
+    }
+    if (stitched && numShared == 0) {
+      if (thisLeader == 0)
+        std::cout << "   Warning: REWL windows do not overlap in visited bins; keeping them as they are\n";
+      return false;
+    }
+    if (numShared > 0) shift /= double(numShared);
+
+    for (int i=0; i<binCounts[size_t(walker)]; i++) {
+      size_t g = size_t(firstGlobalBin[size_t(walker)] + i);
+      if (g < numGlobalBins && !std::isnan(walkerDOS[i])) {
+        sumDOS[g] += walkerDOS[i] + shift;
+        numDOS[g]++;
+        stitched = true;
+      }
     }
   }
-  double flatnessReference = flatnessCriterion * double(sumEntries) / double(numVisitedBins);
 
-  unsigned int numBinsFailingCriterionLastTime = numBinsFailingCriterion;
-  numBinsFailingCriterion = 0;
-  for (unsigned int i=0; i<numBins; i++) {
-    if (visited[i] == 1) {
-      if (double(hist[i]) < flatnessReference) {
-        numBinsFailingCriterion++;
-      } 
+  // Cost of every global bin, averaged over the walkers covering it, and its running sum
+  std::vector<double> sumCost(numGlobalBins, 0.0);
+  std::vector<int>    numCost(numGlobalBins, 0);
+  for (int walker=0; walker<numLeaders; walker++) {
+    double costDensity = sqrt(field(walker, 4)) / std::max(field(walker, 2) - field(walker, 1), width);
+    for (int i=0; i<binCounts[size_t(walker)]; i++) {
+      size_t g = size_t(firstGlobalBin[size_t(walker)] + i);
+      if (g < numGlobalBins) {
+        sumCost[g] += costDensity * width;
+        numCost[g]++;
+      }
     }
   }
+  std::vector<double> cumulativeCost(numGlobalBins + 1, 0.0);
+  for (size_t g=0; g<numGlobalBins; g++)
+    cumulativeCost[g+1] = cumulativeCost[g] + ((numCost[g] > 0) ? sumCost[g] / double(numCost[g]) : 0.0);
+  if (!(cumulativeCost.back() > 0.0)) return false;
+
+  // The usual layout of overlapping windows, in cost: window w covers global bins lowestBin[w]..highestBin[w]
+  size_t numWindows = size_t(numberOfWindows);
+  double windowCost = cumulativeCost.back() / (1.0 + double(numberOfWindows - 1) * (1.0 - overlap));
+  std::vector<size_t> lowestBin(numWindows), highestBin(numWindows);
+  for (size_t w=0; w<numWindows; w++) {
+    double lowerCost = double(w) * (1.0 - overlap) * windowCost;
+    double upperCost = lowerCost + windowCost;
+    size_t lower = size_t(std::upper_bound(cumulativeCost.begin(), cumulativeCost.end(), lowerCost) - cumulativeCost.begin());
+    size_t upper = size_t(std::lower_bound(cumulativeCost.begin() + 1, cumulativeCost.end(), upperCost) - cumulativeCost.begin());
+    lowestBin[w]  = (w == 0) ? 0 : std::min(lower - 1, numGlobalBins - 1);
+    highestBin[w] = (w == numWindows - 1) ? numGlobalBins - 1 : std::min(upper - 1, numGlobalBins - 1);
+  }
 
-  if (numBinsFailingCriterion >= numBinsFailingCriterionLastTime)
-    numHistogramNotImproved++;
+  // Every window spans at least two bins and shares at least two with the next one
+  for (size_t w=numWindows; w-- > 0; ) {
+    if (w + 1 < numWindows)
+      highestBin[w] = std::max(highestBin[w], lowestBin[w+1] + 1);
+    highestBin[w] = std::min(std::max(highestBin[w], lowestBin[w] + 1), numGlobalBins - 1);
+    lowestBin[w]  = std::min(lowestBin[w], highestBin[w] - 1);
+  }
 
-  if (numBinsFailingCriterion == 0)
-    return true;
-  else
-    return false;
+  if (thisLeader == 0) {
+    printf("REWL: energy windows rebalanced\n");
+    for (size_t w=0; w<numWindows; w++) {
+      int walker = *std::find_if(order.begin(), order.end(), [&field, w](int a) { return size_t(field(a, 0)) == w; });
+      printf("   window %3zu : [%15.8e, %15.8e], was [%15.8e, %15.8e] taking %.4e MC steps per iteration\n", w,
+             globalEmin + double(lowestBin[w]) * width, globalEmin + double(highestBin[w]) * width,
+             field(walker, 1), field(walker, 2), field(walker, 4));
+    }
+  }
+
+  // Take over my new window
+  double maxModFactor = modFactor;
+  for (int walker=0; walker<numLeaders; walker++)
+    maxModFactor = std::max(maxModFactor, field(walker, 5));
+
+  int               myGlobalDirection     = globalDirection;
+  unsigned long int myNumGlobalRoundTrips = numGlobalRoundTrips;
+
+  size_t firstBin = lowestBin[size_t(window)];
+  Emin = toEnergyType(globalEmin + double(firstBin) * width);
+  Emax = toEnergyType(globalEmin + double(highestBin[size_t(window)]) * width);
+  setupAxes();
+  allocateArrays();
 
+  // The bins start unvisited, carrying the stitched ln g (see visitNewBin()): an energy on
+  // the edge between two bins may round into either, depending on the Emin of the window
+  for (unsigned int i=0; i<numBins; i++)
+    if (firstBin + i < numGlobalBins && numDOS[firstBin + i] > 0)
+      dos.ref(i) = sumDOS[firstBin + i] / double(numDOS[firstBin + i]);
+
+  modFactor               = maxModFactor;
+  histogramFlat           = false;
+  numBinsFailingCriterion = numBins;
+  numHistogramNotImproved = 0;
+  resetRoundTripStatistics();
+  setupBookkeeping();
+
+  myWindow            = window;
+  globalDirection     = myGlobalDirection;
+  numGlobalRoundTrips = myNumGlobalRoundTrips;
+  windowsRebalanced   = 1;
+  return true;
+}
+
+
+// Halve every visited bin whose ln g differs from a visited neighbor by more than
+// binRefinementThreshold. Both halves start from ln g - ln 2 of the old bin and
+// are marked unvisited, so empty halves do not block the flatness criterion.
+template <typename EnergyType>
+bool Histogram<EnergyType>::refineBins()
+{
+  if (!binRefinement || !nonUniformBinning || dim != 1) return false;
+
+  unsigned int oldNumBins = numBins;
+  std::vector<double> newEdges;
+  std::vector<double> newDOS;
+  std::vector<int>    newVisited;
+  std::vector<unsigned long int> newFirstPassageSteps;
+  std::vector<unsigned long int> newFirstPassageCount;
+  bool keepRoundTrips = !firstPassageSteps.empty();
+
+  for (unsigned int i=0; i<oldNumBins; i++) {
+    double width = binEdges[i+1] - binEdges[i];
+    bool steep = (i > 0              && visited[i-1] == 1 && fabs(dos[i] - dos[i-1]) > binRefinementThreshold) ||
+                 (i + 1 < oldNumBins && visited[i+1] == 1 && fabs(dos[i+1] - dos[i]) > binRefinementThreshold);
+
+    newEdges.push_back(binEdges[i]);
+    if (visited[i] == 1 && steep && 0.5 * width >= binSizeMin) {
+      newEdges.push_back(binEdges[i] + 0.5 * width);
+      newDOS.insert(newDOS.end(), 2, dos[i] - log(2.0));
+      newVisited.insert(newVisited.end(), 2, 0);
+      if (keepRoundTrips) {
+        newFirstPassageSteps.insert(newFirstPassageSteps.end(), 2, 0);
+        newFirstPassageCount.insert(newFirstPassageCount.end(), 2, 0);
+      }
+    }
+    else {
+      newDOS.push_back(dos[i]);
+      newVisited.push_back(visited[i]);
+      if (keepRoundTrips) {
+        newFirstPassageSteps.push_back(firstPassageSteps[i]);
+        newFirstPassageCount.push_back(firstPassageCount[i]);
+      }
+    }
+  }
+  newEdges.push_back(binEdges.back());
+
+  if (newEdges.size() == binEdges.size()) return false;
+
+  binEdges = newEdges;
+  setupAxes();
+  allocateArrays();
+  for (unsigned int i=0; i<numBins; i++) {
+    if (newVisited[i] != 0) visited.ref(i) = newVisited[i];
+    if (newDOS[i] != 0.0)   dos.ref(i)     = newDOS[i];
+  }
+  numBinsFailingCriterion = numBins;
+  resetFlatnessBookkeeping();
+
+  // Split bins start their first-passage statistics anew
+  if (keepRoundTrips) {
+    firstPassageSteps = newFirstPassageSteps;
+    firstPassageCount = newFirstPassageCount;
+    firstPassageMark.assign(numBins, passNumber);
+  }
+  findVisitedEnergyRange();
+
+  printf("   Refined energy bins: %u -> %u bins\n", oldNumBins, numBins);
+  return true;
 }
 
 
 // Ref: S. Kullback and R. A. Leibler, Ann. Math. Stat. 22, 79 (1951).
 // It measures the similarity of two probability distributions, P(x) and Q(x).
-bool Histogram::checkKullbackLeiblerDivergence()
-{
-  long int numVisitedBins = std::count(visited.begin(), visited.end(), 1);
-  //int numVisitedBins = 0;
-  //for (unsigned int i=0; i<numBins; i++) {
-  //  if (visited[i] == 1)
-  //    numVisitedBins++;
-  //}
+template <typename EnergyType>
+bool Histogram<EnergyType>::checkKullbackLeiblerDivergence()
+{
   std::cout << "Number of visited bins = " << numVisitedBins << "\n";
 
   double flatnessReference = 1.0 / static_cast<double>( numVisitedBins );
   //double flatnessReference = 1.0 / static_cast<double>( std::max(numVisitedBins, 10) );
 
   KullbackLeiblerDivergence = 0.0;
-  for (unsigned int i=0; i<numBins; i++) {
-    if (visited[i] == 1) {
-      probDistribution[i] = static_cast<double>(hist[i]) / static_cast<double>(numberOfUpdatesPerIteration);
-      KullbackLeiblerDivergence += probDistribution[i] * log(probDistribution[i]/flatnessReference);
+  for (size_t p=0; p<visited.numPages(); p++) {
+    if (!visited.pageAllocated(p)) continue;
+    for (size_t i=visited.pageBegin(p); i<visited.pageEnd(p); i++) {
+      if (visited[i] == 1) {
+        probDistribution.ref(i) = static_cast<double>(hist[i]) / static_cast<double>(numberOfUpdatesPerIteration);
+        KullbackLeiblerDivergence += probDistribution[i] * log(probDistribution[i]/flatnessReference);
+      }
     }
   }
 
@@ -334,11 +922,64 @@ bool Histogram::checkKullbackLeiblerDivergence()
 }
 
 
-void Histogram::writeHistogramDOSFile(const char* fileName)
+template <typename EnergyType>
+void Histogram<EnergyType>::writeHistogramDOSFile(const char* fileName)
+{
+  if (histogramFileFormat == 1)
+    writeHistogramDOSBinaryFile(fileName);
+  else
+    writeHistogramDOSTextFile(fileName);
+}
+
+
+// The binary image is copied into a staging buffer, and the I/O thread of checkpointWriter
+// writes it out. Text files are printed into memory here and written out the same way.
+template <typename EnergyType>
+void Histogram<EnergyType>::stageHistogramDOSFile(const char* fileName)
+{
+
+  if (histogramFileFormat == 1) {
+    std::vector<char> image = checkpointWriter.getBuffer();
+    writeHistogramDOSBinaryImage(image);
+    checkpointWriter.writeFile(fileName, std::move(image));
+  }
+  else
+    stageHistogramDOSTextFile(fileName);
+
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::stageHistogramDOSTextFile(const char* fileName)
+{
+  checkpointWriter.writeTextFile(fileName, [&](FILE* histdos_file) { printHistogramDOSText(histdos_file); });
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::stageNormDOSFile(const char* fileName)
+{
+  checkpointWriter.writeTextFile(fileName, [&](FILE* dosFile) { printNormDOS(dosFile); });
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::writeHistogramDOSTextFile(const char* fileName)
 {
 
   FILE *histdos_file;
   histdos_file = fopen(fileName, "w");
+  printHistogramDOSText(histdos_file);
+  fclose(histdos_file);
+
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::printHistogramDOSText(FILE* histdos_file)
+{
+
+  numBinsFailingCriterion = countBinsFailingCriterion();
 
   // Write out histogram info
   fprintf(histdos_file, "dim  %d \n", dim);
@@ -348,9 +989,9 @@ void Histogram::writeHistogramDOSFile(const char* fileName)
   fprintf(histdos_file, "modFactorReducer  %5.3f \n", modFactorReducer);
   fprintf(histdos_file, "histogramCheckInterval  %10u \n", histogramCheckInterval);
   fprintf(histdos_file, "histogramRefreshInterval  %10u \n", histogramRefreshInterval);
-  fprintf(histdos_file, "Emin  %15.8e \n", Emin);
-  fprintf(histdos_file, "Emax  %15.8e \n", Emax);
-  fprintf(histdos_file, "binSize  %15.8e \n", binSize);
+  fprintf(histdos_file, "Emin  %15.8e \n", double(Emin));
+  fprintf(histdos_file, "Emax  %15.8e \n", double(Emax));
+  fprintf(histdos_file, "binSize  %15.8e \n", double(binSize));
   fprintf(histdos_file, "numBins  %8u \n", numBins);
   fprintf(histdos_file, "\n");
 
@@ -367,6 +1008,22 @@ void Histogram::writeHistogramDOSFile(const char* fileName)
  
   fprintf(histdos_file, "\n");
 
+  // Axes of multi-dimensional histograms; bins below are listed by their storage index
+  if (dim > 1) {
+    fprintf(histdos_file, "histogramBlockSize  %u \n", blockSize);
+    for (unsigned int d=0; d<unsigned(dim); d++)
+      fprintf(histdos_file, "axis %u  %u  %15.8e  %15.8e  %15.8e  %8u \n", d, axisObservable[d],
+              axisMin[d], axisMax[d], axisBinSize[d], axisNumBins[d]);
+    fprintf(histdos_file, "\n");
+  }
+
+  if (nonUniformBinning) {
+    fprintf(histdos_file, "binEdges  %zu", binEdges.size());
+    for (size_t i=0; i<binEdges.size(); i++)
+      fprintf(histdos_file, " %.17g", binEdges[i]);
+    fprintf(histdos_file, "\n\n");
+  }
+
   // Write out histogram and DOS
   for (unsigned int i=0; i<numBins; i++) {
     fprintf(histdos_file, "%8d %5d %lu %20.8f\n", i, visited[i], hist[i], dos[i]);
@@ -374,29 +1031,566 @@ void Histogram::writeHistogramDOSFile(const char* fileName)
   }
 
   fprintf(histdos_file, "\n");
-  fclose(histdos_file);
+
+  // Round-trip statistics; first-passage times are listed by energy bin
+  if (!firstPassageSteps.empty()) {
+    fprintf(histdos_file, "roundTripStatistics  %zu \n", firstPassageSteps.size());
+    fprintf(histdos_file, "roundTripClock  %lu \n", roundTripClock);
+    fprintf(histdos_file, "roundTripStart  %lu \n", roundTripStart);
+    fprintf(histdos_file, "roundTripDirection  %d \n", roundTripDirection);
+    fprintf(histdos_file, "numRoundTrips  %lu \n", numRoundTrips);
+    fprintf(histdos_file, "roundTripSteps  %lu \n", roundTripSteps);
+    fprintf(histdos_file, "numTunnelings  %lu \n", numTunnelings);
+    fprintf(histdos_file, "tunnelingSteps  %lu \n", tunnelingSteps);
+    fprintf(histdos_file, "passNumber  %u \n", passNumber);
+    fprintf(histdos_file, "globalDirection  %d \n", globalDirection);
+    fprintf(histdos_file, "numGlobalRoundTrips  %lu \n", numGlobalRoundTrips);
+    fprintf(histdos_file, "\n");
+    fprintf(histdos_file, "# energy bin, number of passages, summed and mean first-passage time \n");
+    for (size_t i=0; i<firstPassageSteps.size(); i++)
+      fprintf(histdos_file, "%8zu %lu %lu %15.8e\n", i, firstPassageCount[i], firstPassageSteps[i],
+              (firstPassageCount[i] > 0) ? double(firstPassageSteps[i]) / double(firstPassageCount[i]) : 0.0);
+    fprintf(histdos_file, "\n");
+  }
+
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::writeHistogramDOSBinaryFile(const char* fileName)
+{
+
+  std::vector<char> image;
+  writeHistogramDOSBinaryImage(image);
+
+  FILE *histdos_file = fopen(fileName, "wb");
+  if (histdos_file == NULL) {
+    std::cerr << "     ERROR! Cannot open histogram checkpoint file "  << fileName << " for writing\n";
+    return;
+  }
+
+  bool success = (fwrite(image.data(), 1, image.size(), histdos_file) == image.size());
+
+  if (fclose(histdos_file) != 0 || !success)
+    std::cerr << "     ERROR! Problem writing histogram checkpoint file " << fileName << "\n";
+
 }
 
 
-bool Histogram::checkIntegrity()
+// The binary file layout, in memory
+template <typename EnergyType>
+void Histogram<EnergyType>::writeHistogramDOSBinaryImage(std::vector<char>& image)
+{
+
+  HistogramFileHeader header {};
+
+  numBinsFailingCriterion = countBinsFailingCriterion();
+
+  memcpy(header.magic, histogramFileMagic, sizeof(header.magic));
+  header.version                  = histogramFileVersion;
+  header.byteOrderMark            = histogramByteOrderMark;
+  header.headerSize               = sizeof(HistogramFileHeader);
+  header.dim                      = dim;
+
+  header.flatnessCriterion        = flatnessCriterion;
+  header.modFactor                = modFactor;
+  header.modFactorFinal           = modFactorFinal;
+  header.modFactorReducer         = modFactorReducer;
+  header.histogramCheckInterval   = histogramCheckInterval;
+  header.histogramRefreshInterval = histogramRefreshInterval;
+
+  header.Emin                     = double(Emin);
+  header.Emax                     = double(Emax);
+  header.binSize                  = double(binSize);
+  header.numBins                  = numBins;
+  header.numBinsFailingCriterion  = numBinsFailingCriterion;
+
+  header.totalMCsteps             = totalMCsteps;
+  header.acceptedMoves            = acceptedMoves;
+  header.rejectedMoves            = rejectedMoves;
+  header.numBelowRange            = numBelowRange;
+  header.numAboveRange            = numAboveRange;
+  header.iterations               = iterations;
+  header.numHistogramNotImproved  = numHistogramNotImproved;
+  header.numHistogramRefreshed    = numHistogramRefreshed;
+  header.blockSize                = blockSize;
+
+  header.numRoundTripBins         = uint32_t(firstPassageSteps.size());
+  header.roundTripDirection       = roundTripDirection;
+  header.roundTripClock           = roundTripClock;
+  header.roundTripStart           = roundTripStart;
+  header.numRoundTrips            = numRoundTrips;
+  header.roundTripSteps           = roundTripSteps;
+  header.numTunnelings            = numTunnelings;
+  header.tunnelingSteps           = tunnelingSteps;
+  header.numGlobalRoundTrips      = numGlobalRoundTrips;
+  header.globalDirection          = globalDirection;
+  header.passNumber               = passNumber;
+  header.windowsRebalanced        = uint32_t(windowsRebalanced);
+
+  std::vector<HistogramFileAxis> axes(static_cast<size_t>(dim));
+  for (unsigned int d=0; d<unsigned(dim); d++) {
+    axes[d].observableIndex = int32_t(axisObservable[d]);
+    axes[d].numBins         = axisNumBins[d];
+    axes[d].min             = axisMin[d];
+    axes[d].max             = axisMax[d];
+    axes[d].binSize         = axisBinSize[d];
+  }
+
+  // The header, the axes and the first two arrays are multiples of 8 bytes, so every array stays aligned
+  header.axesOffset               = sizeof(HistogramFileHeader);
+  header.numBinEdges              = nonUniformBinning ? uint32_t(binEdges.size()) : 0;
+  header.binEdgesOffset           = header.axesOffset + axes.size() * sizeof(HistogramFileAxis);
+  header.histOffset               = header.binEdgesOffset + header.numBinEdges * sizeof(double);
+  header.dosOffset                = header.histOffset + numBins * sizeof(uint64_t);
+  header.visitedOffset            = header.dosOffset  + numBins * sizeof(double);
+  header.roundTripOffset          = (header.visitedOffset + numBins * sizeof(int32_t) + 7) & ~uint64_t(7);
+
+  static_assert(sizeof(HistogramFileHeader) % 8 == 0, "HistogramFileHeader must be a multiple of 8 bytes");
+  static_assert(sizeof(HistogramFileAxis) % 8 == 0, "HistogramFileAxis must be a multiple of 8 bytes");
+  static_assert(sizeof(unsigned long int) == sizeof(uint64_t) && sizeof(int) == sizeof(int32_t),
+                "binary histogram file assumes 64-bit histogram entries and 32-bit visited flags");
+
+  // Padding before the round-trip arrays is zero
+  if (header.numRoundTripBins > 0)
+    image.assign(header.roundTripOffset + 2 * header.numRoundTripBins * sizeof(uint64_t), 0);
+  else
+    image.assign(header.visitedOffset + numBins * sizeof(int32_t), 0);
+
+  memcpy(image.data(), &header, sizeof(HistogramFileHeader));
+  memcpy(image.data() + header.axesOffset, axes.data(), axes.size() * sizeof(HistogramFileAxis));
+  if (nonUniformBinning)
+    memcpy(image.data() + header.binEdgesOffset, binEdges.data(), binEdges.size() * sizeof(double));
+  hist.copyTo(image.data() + header.histOffset);
+  dos.copyTo(image.data() + header.dosOffset);
+  visited.copyTo(image.data() + header.visitedOffset);
+  if (header.numRoundTripBins > 0) {
+    memcpy(image.data() + header.roundTripOffset, firstPassageSteps.data(), firstPassageSteps.size() * sizeof(uint64_t));
+    memcpy(image.data() + header.roundTripOffset + firstPassageSteps.size() * sizeof(uint64_t),
+           firstPassageCount.data(), firstPassageCount.size() * sizeof(uint64_t));
+  }
+
+}
+
+
+template <typename EnergyType>
+bool Histogram<EnergyType>::checkIntegrity()
 {
   return true;
 }
 
 
 // Private member functions
-int Histogram::getIndex(ObservableType energy)
+template <typename EnergyType>
+void Histogram<EnergyType>::setBinSizeReciprocal()
+{
+  if constexpr (std::is_integral<EnergyType>::value) {
+    if (binSize <= 0) {
+      std::cerr << "   Error: binSize must be a positive integer for systems with integer energies. Quiting... \n";
+      exit(7);
+    }
+    if (uint64_t(Emax - Emin) >= (uint64_t(1) << 32)) {
+      std::cerr << "   Error: energy range too large for an integer histogram. Quiting... \n";
+      exit(7);
+    }
+    binSizeReciprocal = (binSize > 1) ? std::numeric_limits<uint64_t>::max() / uint64_t(binSize) + 1 : 0;
+  }
+  else
+    binSizeReciprocal = 0;
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::allocateArrays()
+{
+  if ((histogramPageSize & (histogramPageSize - 1)) != 0) {
+    std::cerr << "   Error: histogramPageSize must be 0 or a power of 2. Quiting... \n";
+    exit(7);
+  }
+
+  hist.assign(numBins, histogramPageSize);
+  dos.assign(numBins, histogramPageSize);
+  visited.assign(numBins, histogramPageSize);
+  probDistribution.assign(numBins, histogramPageSize);
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::setupAxes()
+{
+  if (dim < 1) {
+    std::cerr << "   Error: dim of the histogram must be at least 1. Quiting... \n";
+    exit(7);
+  }
+  unsigned int numAxes = unsigned(dim);
+
+  if (axisObservable.empty())
+    for (unsigned int d=0; d<numAxes; d++)
+      axisObservable.push_back(d);
+  if (axisObservable.size() != numAxes || axisObservable[0] != 0) {
+    std::cerr << "   Error: histogramObservables must list dim observables, starting with the energy (0). Quiting... \n";
+    exit(7);
+  }
+
+  // Axis 0 is the energy axis; the others are read from the input or checkpoint file
+  axisMin.resize(std::max(size_t(1), axisMin.size()));
+  axisMax.resize(std::max(size_t(1), axisMax.size()));
+  axisBinSize.resize(std::max(size_t(1), axisBinSize.size()));
+  if (axisMin.size() != numAxes || axisMax.size() != numAxes || axisBinSize.size() != numAxes) {
+    std::cerr << "   Error: observableMin, observableMax and observableBinSize must list dim-1 values. Quiting... \n";
+    exit(7);
+  }
+  nonUniformBinning = !binEdges.empty();
+  if (nonUniformBinning) {
+    if (std::is_integral<EnergyType>::value) {
+      std::cerr << "   Error: binEdges and binRefinement are only supported for continuous energies. Quiting... \n";
+      exit(7);
+    }
+    if (binEdges.size() < 2) {
+      std::cerr << "   Error: binEdges must list at least two edges. Quiting... \n";
+      exit(7);
+    }
+    for (size_t i=0; i+1<binEdges.size(); i++) {
+      if (!(binEdges[i] < binEdges[i+1])) {
+        std::cerr << "   Error: binEdges must be strictly increasing. Quiting... \n";
+        exit(7);
+      }
+    }
+    Emin    = EnergyType(binEdges.front());
+    Emax    = EnergyType(binEdges.back());
+    binSize = EnergyType(binEdges.back() - binEdges.front());
+    for (size_t i=0; i+1<binEdges.size(); i++)
+      binSize = std::min(binSize, EnergyType(binEdges[i+1] - binEdges[i]));
+    if (binSizeMin <= 0.0) binSizeMin = double(binSize) / 16.0;
+    setupBinLookup();
+  }
+
+  axisMin[0]     = double(Emin);
+  axisMax[0]     = double(Emax);
+  axisBinSize[0] = double(binSize);
+
+  axisNumBins.resize(numAxes);
+  if (nonUniformBinning)
+    axisNumBins[0] = unsigned(binEdges.size() - 1);
+  else
+    axisNumBins[0] = unsigned(ceil(double(Emax - Emin) / double(binSize))) + 1;
+  for (unsigned int d=1; d<numAxes; d++) {
+    if (axisBinSize[d] <= 0.0 || axisMax[d] < axisMin[d]) {
+      std::cerr << "   Error: invalid range or bin size for histogram axis " << d << ". Quiting... \n";
+      exit(7);
+    }
+    axisNumBins[d] = unsigned(ceil((axisMax[d] - axisMin[d]) / axisBinSize[d])) + 1;
+  }
+
+  // Blocks of blockSize^dim bins; a 1D histogram is a single row of bins
+  if (numAxes == 1)
+    blockSize = 1;
+  else if (blockSize == 0)
+    blockSize = (numAxes == 2) ? 8 : 4;
+  if ((blockSize & (blockSize - 1)) != 0) {
+    std::cerr << "   Error: histogramBlockSize must be a power of 2. Quiting... \n";
+    exit(7);
+  }
+  blockShift = 0;
+  while ((1u << blockShift) < blockSize) blockShift++;
+
+  axisNumBlocks.resize(numAxes);
+  double totalBins = 1.0;
+  for (unsigned int d=0; d<numAxes; d++) {
+    axisNumBlocks[d] = (axisNumBins[d] + blockSize - 1) >> blockShift;
+    totalBins *= double(axisNumBlocks[d]) * double(blockSize);
+  }
+  if (totalBins >= double(std::numeric_limits<int>::max())) {
+    std::cerr << "   Error: too many bins in the histogram. Quiting... \n";
+    exit(7);
+  }
+  numBins = unsigned(totalBins);
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::setupBinEdges()
 {
-  return int( floor(double(energy - Emin) / double(binSize)) );
+  if (binEdges.empty()) {
+    if (!binRefinement) return;
+    // Start from the uniform bins
+    unsigned int n = unsigned(ceil(double(Emax - Emin) / double(binSize))) + 1;
+    for (unsigned int i=0; i<=n; i++)
+      binEdges.push_back(double(Emin) + double(binSize) * double(i));
+  }
+  else {
+    // Keep the edges spanning this walker's energy window
+    auto lower = std::upper_bound(binEdges.begin(), binEdges.end(), double(Emin));
+    if (lower != binEdges.begin()) --lower;
+    auto upper = std::lower_bound(binEdges.begin(), binEdges.end(), double(Emax));
+    if (upper == binEdges.end()) --upper;
+    binEdges = std::vector<double>(lower, upper + 1);
+  }
 }
 
 
-void Histogram::readHistogramDOSFile(const char* fileName)
+template <typename EnergyType>
+void Histogram<EnergyType>::setupBinLookup()
+{
+  size_t numEdgeBins = binEdges.size() - 1;
+  double range       = binEdges.back() - binEdges.front();
+  double minWidth    = range;
+  for (size_t i=0; i<numEdgeBins; i++)
+    minWidth = std::min(minWidth, binEdges[i+1] - binEdges[i]);
+
+  size_t numCells = std::min(size_t(ceil(range / minWidth)), 64 * numEdgeBins);
+  numCells = std::max(numCells, size_t(1));
+  binLookupCellsPerEnergy = double(numCells) / range;
+
+  binLookup.resize(numCells);
+  unsigned int bin = 0;
+  for (size_t c=0; c<numCells; c++) {
+    double cellBegin = binEdges.front() + double(c) / binLookupCellsPerEnergy;
+    while (bin + 1 < numEdgeBins && binEdges[bin + 1] <= cellBegin) bin++;
+    binLookup[c] = bin;
+  }
+}
+
+
+// Storage index of the bin at the given coordinates: the block index followed by the offset within the block
+template <typename EnergyType>
+unsigned int Histogram<EnergyType>::getStorageIndex(const std::vector<unsigned int>& binCoordinates)
+{
+  unsigned int blockIndex = 0;
+  unsigned int offset     = 0;
+  for (unsigned int d=0; d<unsigned(dim); d++) {
+    blockIndex = blockIndex * axisNumBlocks[d] + (binCoordinates[d] >> blockShift);
+    offset     = (offset << blockShift) | (binCoordinates[d] & (blockSize - 1));
+  }
+  return (blockIndex << (blockShift * unsigned(dim))) | offset;
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::getBinCoordinates(unsigned int index, std::vector<unsigned int>& binCoordinates)
+{
+  unsigned int blockIndex = index >> (blockShift * unsigned(dim));
+  unsigned int offset     = index & ((1u << (blockShift * unsigned(dim))) - 1);
+  for (int d=dim-1; d>=0; d--) {
+    binCoordinates[unsigned(d)] = ((blockIndex % axisNumBlocks[unsigned(d)]) << blockShift) | (offset & (blockSize - 1));
+    blockIndex /= axisNumBlocks[unsigned(d)];
+    offset    >>= blockShift;
+  }
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::checkObservableIndices(unsigned int numObservables)
+{
+  for (unsigned int d=0; d<unsigned(dim); d++) {
+    if (axisObservable[d] >= numObservables) {
+      std::cerr << "   Error: histogram axis " << d << " refers to observable " << axisObservable[d]
+                << ", but the physical system only has " << numObservables << ". Quiting... \n";
+      exit(10);
+    }
+  }
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::readHistogramDOSFile(const char* fileName)
 {
 
   if (GlobalComm.thisMPIrank == 0)
     std::cout << "   Reading histogram checkpoint file : " << fileName << "\n";
 
+  // Binary files start with the magic string; anything else is parsed as text
+  char magic[sizeof(histogramFileMagic)] {};
+  FILE *histdos_file = fopen(fileName, "rb");
+  if (histdos_file == NULL) {
+    std::cerr << "     ERROR! Cannot open histogram checkpoint file "  << fileName << "\n";
+    exit(7);
+  }
+  size_t bytesRead = fread(magic, 1, sizeof(magic), histdos_file);
+  fclose(histdos_file);
+
+  if (bytesRead == sizeof(magic) && memcmp(magic, histogramFileMagic, sizeof(magic)) == 0)
+    readHistogramDOSBinaryFile(fileName);
+  else
+    readHistogramDOSTextFile(fileName);
+
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::readHistogramDOSBinaryFile(const char* fileName)
+{
+
+  int fd = open(fileName, O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "     ERROR! Cannot open histogram checkpoint file "  << fileName << "\n";
+    exit(7);
+  }
+
+  struct stat fileStatus;
+  if (fstat(fd, &fileStatus) != 0 || size_t(fileStatus.st_size) < sizeof(HistogramFileHeader)) {
+    std::cerr << "     ERROR! Histogram checkpoint file " << fileName << " is truncated\n";
+    exit(7);
+  }
+  size_t fileSize = size_t(fileStatus.st_size);
+
+  void* mapped = mmap(NULL, fileSize, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (mapped == MAP_FAILED) {
+    std::cerr << "     ERROR! Cannot mmap histogram checkpoint file " << fileName << "\n";
+    exit(7);
+  }
+
+  readHistogramDOSBinaryImage(static_cast<const char*>(mapped), fileSize, fileName);
+
+  munmap(mapped, fileSize);
+
+}
+
+
+// Axes and round-trip statistics of a state read from a checkpoint file (or image)
+template <typename EnergyType>
+void Histogram<EnergyType>::setupReadState(const char* fileName)
+{
+
+  unsigned int numBinsRead = numBins;
+  setupAxes();
+  if (numBins != numBinsRead) {
+    std::cerr << "   Error: histogram axes in checkpoint file " << fileName << " do not match its number of bins. Quiting... \n";
+    exit(7);
+  }
+
+  // Start the round-trip statistics anew if the checkpoint file has none
+  if (firstPassageSteps.size() != (roundTripStatistics ? axisNumBins[0] : 0))
+    resetRoundTripStatistics();
+
+}
+
+
+// fileName only labels error messages
+template <typename EnergyType>
+void Histogram<EnergyType>::readHistogramDOSBinaryImage(const char* fileBegin, size_t fileSize, const char* fileName)
+{
+
+  // Version 1 headers end before axesOffset; fields a file does not have stay zero
+  const size_t headerSizeVersion1 = offsetof(HistogramFileHeader, axesOffset);
+  HistogramFileHeader header {};
+  memcpy(&header, fileBegin, headerSizeVersion1);
+  if (header.headerSize > headerSizeVersion1 && header.headerSize <= fileSize)
+    memcpy(&header, fileBegin, std::min(size_t(header.headerSize), sizeof(HistogramFileHeader)));
+
+  if (header.byteOrderMark != histogramByteOrderMark) {
+    std::cerr << "     ERROR! Histogram checkpoint file " << fileName << " was written with a different byte order\n";
+    exit(7);
+  }
+  size_t headerSizeRequired = headerSizeVersion1;
+  if (header.version == 2) headerSizeRequired = offsetof(HistogramFileHeader, binEdgesOffset);
+  if (header.version == 3) headerSizeRequired = offsetof(HistogramFileHeader, roundTripOffset);
+  if (header.version >= 4) headerSizeRequired = sizeof(HistogramFileHeader);
+  if (header.version > histogramFileVersion || header.headerSize < headerSizeRequired) {
+    std::cerr << "     ERROR! Unsupported version " << header.version << " of histogram checkpoint file " << fileName << "\n";
+    exit(7);
+  }
+
+  numBins = header.numBins;
+  if (header.histOffset    + numBins * sizeof(uint64_t) > fileSize ||
+      header.dosOffset     + numBins * sizeof(double)   > fileSize ||
+      header.visitedOffset + numBins * sizeof(int32_t)  > fileSize) {
+    std::cerr << "     ERROR! Histogram checkpoint file " << fileName << " is truncated\n";
+    exit(7);
+  }
+
+  dim                      = header.dim;
+  flatnessCriterion        = header.flatnessCriterion;
+  modFactor                = header.modFactor;
+  if (header.modFactorFinal < modFactorFinal)
+    std::cout << "     WARNING! modFactorFinal read from the checkpoint file is smaller than the input file. Simulation will continue with the new modFactorFinal. \n";
+  modFactorReducer         = header.modFactorReducer;
+  histogramCheckInterval   = header.histogramCheckInterval;
+  histogramRefreshInterval = header.histogramRefreshInterval;
+
+  Emin                     = toEnergyType(header.Emin);
+  Emax                     = toEnergyType(header.Emax);
+  binSize                  = toEnergyType(header.binSize);
+  numBinsFailingCriterion  = header.numBinsFailingCriterion;
+
+  totalMCsteps             = header.totalMCsteps;
+  acceptedMoves            = header.acceptedMoves;
+  rejectedMoves            = header.rejectedMoves;
+  numBelowRange            = header.numBelowRange;
+  numAboveRange            = header.numAboveRange;
+  iterations               = header.iterations;
+  numHistogramNotImproved  = header.numHistogramNotImproved;
+  numHistogramRefreshed    = header.numHistogramRefreshed;
+  windowsRebalanced        = int(header.windowsRebalanced);
+
+  if (header.version >= 2) {
+    if (dim < 1 || header.axesOffset + size_t(dim) * sizeof(HistogramFileAxis) > fileSize) {
+      std::cerr << "     ERROR! Histogram checkpoint file " << fileName << " is truncated\n";
+      exit(7);
+    }
+    blockSize = header.blockSize;
+    axisObservable.resize(unsigned(dim));
+    axisMin.resize(unsigned(dim));
+    axisMax.resize(unsigned(dim));
+    axisBinSize.resize(unsigned(dim));
+    for (unsigned int d=0; d<unsigned(dim); d++) {
+      HistogramFileAxis axis;
+      memcpy(&axis, fileBegin + header.axesOffset + d * sizeof(HistogramFileAxis), sizeof(HistogramFileAxis));
+      axisObservable[d] = unsigned(axis.observableIndex);
+      axisMin[d]        = axis.min;
+      axisMax[d]        = axis.max;
+      axisBinSize[d]    = axis.binSize;
+    }
+  }
+
+  binEdges.clear();
+  if (header.version >= 3 && header.numBinEdges > 0) {
+    if (header.binEdgesOffset + header.numBinEdges * sizeof(double) > fileSize) {
+      std::cerr << "     ERROR! Histogram checkpoint file " << fileName << " is truncated\n";
+      exit(7);
+    }
+    binEdges.resize(header.numBinEdges);
+    memcpy(binEdges.data(), fileBegin + header.binEdgesOffset, header.numBinEdges * sizeof(double));
+  }
+
+  // Copy the contiguous arrays straight out of the mapping; pages without any entry stay unallocated
+  allocateArrays();
+  hist.read(fileBegin + header.histOffset);
+  dos.read(fileBegin + header.dosOffset);
+  visited.read(fileBegin + header.visitedOffset);
+
+  firstPassageSteps.clear();
+  firstPassageCount.clear();
+  if (header.version >= 4 && header.numRoundTripBins > 0) {
+    size_t n = header.numRoundTripBins;
+    if (header.roundTripOffset + 2 * n * sizeof(uint64_t) > fileSize) {
+      std::cerr << "     ERROR! Histogram checkpoint file " << fileName << " is truncated\n";
+      exit(7);
+    }
+    roundTripDirection  = header.roundTripDirection;
+    roundTripClock      = header.roundTripClock;
+    roundTripStart      = header.roundTripStart;
+    numRoundTrips       = header.numRoundTrips;
+    roundTripSteps      = header.roundTripSteps;
+    numTunnelings       = header.numTunnelings;
+    tunnelingSteps      = header.tunnelingSteps;
+    numGlobalRoundTrips = header.numGlobalRoundTrips;
+    globalDirection     = header.globalDirection;
+    passNumber          = header.passNumber;
+    firstPassageSteps.resize(n);
+    firstPassageCount.resize(n);
+    memcpy(firstPassageSteps.data(), fileBegin + header.roundTripOffset, n * sizeof(uint64_t));
+    memcpy(firstPassageCount.data(), fileBegin + header.roundTripOffset + n * sizeof(uint64_t), n * sizeof(uint64_t));
+  }
+
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::readHistogramDOSTextFile(const char* fileName)
+{
+
   FILE *histdos_file = fopen(fileName, "r");
   if (histdos_file == NULL) {
     std::cerr << "     ERROR! Cannot open histogram checkpoint file "  << fileName << "\n";
@@ -428,14 +1622,18 @@ void Histogram::readHistogramDOSFile(const char* fileName)
   if (fscanf(histdos_file, "%*s %u", &histogramRefreshInterval) != 1)
     std::cerr << "     ERROR! Cannot read histogramRefreshInterval \n";
 
-  if (fscanf(histdos_file, "%*s %lf", &Emin) != 1)
+  double energy_tmp;
+  if (fscanf(histdos_file, "%*s %lf", &energy_tmp) != 1)
     std::cerr << "     ERROR! Cannot read Emin \n";
+  Emin = toEnergyType(energy_tmp);
 
-  if (fscanf(histdos_file, "%*s %lf", &Emax) != 1)
+  if (fscanf(histdos_file, "%*s %lf", &energy_tmp) != 1)
     std::cerr << "     ERROR! Cannot read Emax \n";
+  Emax = toEnergyType(energy_tmp);
 
-  if (fscanf(histdos_file, "%*s %lf", &binSize) != 1)
+  if (fscanf(histdos_file, "%*s %lf", &energy_tmp) != 1)
     std::cerr << "     ERROR! Cannot read binSize \n";
+  binSize = toEnergyType(energy_tmp);
 
   if (fscanf(histdos_file, "%*s %u", &numBins) != 1)
     std::cerr << "     ERROR! Cannot read numBins \n";
@@ -467,19 +1665,72 @@ void Histogram::readHistogramDOSFile(const char* fileName)
   if (fscanf(histdos_file, "%*s %d", &numHistogramRefreshed) != 1)
     std::cerr << "     ERROR! Cannot read numHistogramRefreshed \n";
 
+  if (dim > 1) {
+    if (fscanf(histdos_file, "%*s %u", &blockSize) != 1)
+      std::cerr << "     ERROR! Cannot read histogramBlockSize \n";
+
+    axisObservable.resize(unsigned(dim));
+    axisMin.resize(unsigned(dim));
+    axisMax.resize(unsigned(dim));
+    axisBinSize.resize(unsigned(dim));
+    for (unsigned int d=0; d<unsigned(dim); d++) {
+      if (fscanf(histdos_file, "%*s %*u %u %lf %lf %lf %*u", &axisObservable[d], &axisMin[d], &axisMax[d], &axisBinSize[d]) != 4)
+        std::cerr << "     ERROR! Cannot read histogram axis " << d << " \n";
+    }
+  }
+
+  // Optional line of non-uniform bin edges; otherwise rewind to the first bin
+  binEdges.clear();
+  long binsPosition = ftell(histdos_file);
+  char key[32];
+  if (fscanf(histdos_file, "%31s", key) == 1 && strcmp(key, "binEdges") == 0) {
+    size_t numBinEdges = 0;
+    if (fscanf(histdos_file, "%zu", &numBinEdges) != 1)
+      std::cerr << "     ERROR! Cannot read binEdges \n";
+    binEdges.resize(numBinEdges);
+    for (size_t i=0; i<numBinEdges; i++)
+      if (fscanf(histdos_file, "%lf", &binEdges[i]) != 1)
+        std::cerr << "     ERROR! Cannot read binEdges \n";
+  }
+  else
+    fseek(histdos_file, binsPosition, SEEK_SET);
+
   // Open up arrays needed to store the mask, histogram and DOS
-  hist.assign(numBins, 0);
-  dos.assign(numBins, 0.0);
-  visited.assign(numBins, 0);
-  probDistribution.assign(numBins, 0);
+  allocateArrays();
 
   // Continue reading the histogram and DOS from file
   unsigned int dummy = 0;
+  int visitedBin;
+  unsigned long int histBin;
+  double dosBin;
   for (unsigned int i = 0; i < numBins; i++) {
-    if (fscanf(histdos_file, "%u %d %lu %lf", &dummy, &visited[i], &hist[i], &dos[i]) != 4)
+    if (fscanf(histdos_file, "%u %d %lu %lf", &dummy, &visitedBin, &histBin, &dosBin) != 4)
       std::cerr << "     ERROR! Cannot read histogram and DOS.\n";
     if (dummy != i)
       std::cerr << "     ERROR! Problem reading histogram and DOS. Check!\n";
+    // Only bins with entries touch (and allocate) their pages
+    if (visitedBin != 0) visited.ref(i) = visitedBin;
+    if (histBin != 0)    hist.ref(i)    = histBin;
+    if (dosBin != 0.0)   dos.ref(i)     = dosBin;
+  }
+
+  // Optional round-trip statistics at the end of the file
+  firstPassageSteps.clear();
+  firstPassageCount.clear();
+  size_t numRoundTripBins = 0;
+  if (fscanf(histdos_file, "%31s", key) == 1 && strcmp(key, "roundTripStatistics") == 0 &&
+      fscanf(histdos_file, "%zu", &numRoundTripBins) == 1) {
+    if (fscanf(histdos_file, "%*s %lu %*s %lu %*s %d %*s %lu %*s %lu %*s %lu %*s %lu %*s %u %*s %d %*s %lu",
+               &roundTripClock, &roundTripStart, &roundTripDirection, &numRoundTrips, &roundTripSteps,
+               &numTunnelings, &tunnelingSteps, &passNumber, &globalDirection, &numGlobalRoundTrips) != 10)
+      std::cerr << "     ERROR! Cannot read round-trip statistics \n";
+    if (fscanf(histdos_file, " #%*[^\n]") == EOF)    // comment line
+      std::cerr << "     ERROR! Cannot read first-passage times \n";
+    firstPassageSteps.resize(numRoundTripBins);
+    firstPassageCount.resize(numRoundTripBins);
+    for (size_t i=0; i<numRoundTripBins; i++)
+      if (fscanf(histdos_file, "%*u %lu %lu %*f", &firstPassageCount[i], &firstPassageSteps[i]) != 2)
+        std::cerr << "     ERROR! Cannot read first-passage times \n";
   }
 
   //for (unsigned int i = 0; i < numBins; i++)
@@ -644,13 +1895,25 @@ void Histogram::readHistogramDOSFile(const char* fileName)
 }
 
 
-void Histogram::writeNormDOSFile(const char* fileName)
+template <typename EnergyType>
+void Histogram<EnergyType>::writeNormDOSFile(const char* fileName)
 {
 
   FILE* dosFile;
   if (fileName != NULL) dosFile = fopen(fileName, "w");
   else dosFile = stdout;
 
+  printNormDOS(dosFile);
+
+  if (fileName != NULL) fclose(dosFile);
+
+}
+
+
+template <typename EnergyType>
+void Histogram<EnergyType>::printNormDOS(FILE* dosFile)
+{
+
   // To Do: see if there is a max function to use for C++ vector
   double maxDOS = 0.0;
   for (unsigned int i = 0; i < numBins; i++)
@@ -660,16 +1923,44 @@ void Histogram::writeNormDOSFile(const char* fileName)
   for (unsigned int i = 0; i < numBins; i++)
     if (visited[i]) norm += exp(dos[i] - maxDOS);
 
-  for (unsigned int i = 0; i < numBins; i++)
-    fprintf(dosFile, "%18.10e  %18.10e\n", Emin + binSize * double(i),
-                                           exp(dos[i] - maxDOS) / norm); 
-
-  if (fileName != NULL) fclose(dosFile);
+  if (dim == 1 && nonUniformBinning) {
+    // Lower bin edge, probability of the bin, bin width
+    for (unsigned int i = 0; i < numBins; i++)
+      fprintf(dosFile, "%18.10e  %18.10e  %18.10e\n", binEdges[i], exp(dos[i] - maxDOS) / norm,
+                                                     binEdges[i+1] - binEdges[i]);
+  }
+  else if (dim == 1) {
+    for (unsigned int i = 0; i < numBins; i++)
+      fprintf(dosFile, "%18.10e  %18.10e\n", double(Emin) + double(binSize) * double(i),
+                                             exp(dos[i] - maxDOS) / norm); 
+  }
+  else {
+    // One line per bin, with the last axis running fastest
+    std::vector<unsigned int> coordinates(static_cast<size_t>(dim), 0);
+    bool done = false;
+    while (!done) {
+      unsigned int i = getStorageIndex(coordinates);
+      for (unsigned int d = 0; d < unsigned(dim); d++)
+        fprintf(dosFile, "%18.10e  ", (d == 0 && nonUniformBinning) ? binEdges[coordinates[0]]
+                                      : axisMin[d] + axisBinSize[d] * double(coordinates[d]));
+      fprintf(dosFile, "%18.10e\n", visited[i] ? exp(dos[i] - maxDOS) / norm : 0.0);
+
+      done = true;
+      for (int d = dim - 1; d >= 0; d--) {
+        if (++coordinates[unsigned(d)] < axisNumBins[unsigned(d)]) {
+          done = false;
+          break;
+        }
+        coordinates[unsigned(d)] = 0;
+      }
+    }
+  }
 
 }
 
 
-void Histogram::readMCInputFile(char const* fileName)
+template <typename EnergyType>
+void Histogram<EnergyType>::readMCInputFile(char const* fileName)
 {
 
   if (GlobalComm.thisMPIrank == 0) 
@@ -739,6 +2030,68 @@ void Histogram::readMCInputFile(char const* fileName)
             //std::cout << "WangLandau: binSize = " << binSize << "\n";
             continue;
           }
+          if (key == "histogramObservables") {
+            axisObservable.clear();
+            unsigned int observableIndex;
+            while (lineStream >> observableIndex) axisObservable.push_back(observableIndex);
+            continue;
+          }
+          if (key == "observableMin") {
+            axisMin.assign(1, 0.0);               // axis 0 is set from Emin
+            double value;
+            while (lineStream >> value) axisMin.push_back(value);
+            continue;
+          }
+          if (key == "observableMax") {
+            axisMax.assign(1, 0.0);               // axis 0 is set from Emax
+            double value;
+            while (lineStream >> value) axisMax.push_back(value);
+            continue;
+          }
+          if (key == "observableBinSize") {
+            axisBinSize.assign(1, 0.0);           // axis 0 is set from binSize
+            double value;
+            while (lineStream >> value) axisBinSize.push_back(value);
+            continue;
+          }
+          if (key == "histogramBlockSize") {
+            lineStream >> blockSize;
+            continue;
+          }
+          if (key == "binEdges") {
+            binEdges.clear();
+            double edge;
+            while (lineStream >> edge) binEdges.push_back(edge);
+            continue;
+          }
+          if (key == "modFactorSchedule") {
+            lineStream >> modFactorSchedule;
+            continue;
+          }
+          if (key == "roundTripStatistics") {
+            lineStream >> roundTripStatistics;
+            continue;
+          }
+          if (key == "binRefinement") {
+            lineStream >> binRefinement;
+            continue;
+          }
+          if (key == "binRefinementThreshold") {
+            lineStream >> binRefinementThreshold;
+            continue;
+          }
+          if (key == "binSizeMin") {
+            lineStream >> binSizeMin;
+            continue;
+          }
+          if (key == "histogramPageSize") {
+            lineStream >> histogramPageSize;
+            continue;
+          }
+          if (key == "histogramFileFormat") {
+            lineStream >> histogramFileFormat;
+            continue;
+          }
           if (key == "numberOfWindows") {
             lineStream >> numberOfWindows;
             //std::cout << "REWL: numberOfWindows = " << numberOfWindows << "\n";
@@ -787,3 +2140,6 @@ void Histogram::readMCInputFile(char const* fileName)
 }
 
 
+// Explicit instantiations
+template class Histogram<ObservableType>;
+template class Histogram<IntegerObservableType>;
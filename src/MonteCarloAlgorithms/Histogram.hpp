@@ -2,11 +2,155 @@
 #define HISTOGRAM_HPP
 
 
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
 #include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <type_traits>
 #include <vector>
+#include "mpi.h"
 #include "Main/Globals.hpp"
+#include "Utilities/PagedArray.hpp"
 
-// TO DO: make it a template class to allow for int / double histogram
+/*
+  Binary histogram / DOS file layout (histogramFileFormat = 1):
+
+    HistogramFileHeader    fixed-size header holding the scalar state
+    HistogramFileAxis[dim] range and binning of each axis, at byte offset axesOffset (version >= 2)
+    binEdges[numBinEdges]  double, edges of non-uniform energy bins at byte offset binEdgesOffset
+                           (version >= 3; numBinEdges = 0 for uniform bins)
+    hist[numBins]          uint64_t, starting at byte offset histOffset
+    dos[numBins]           double,   starting at byte offset dosOffset
+    visited[numBins]       int32_t,  starting at byte offset visitedOffset
+    firstPassageSteps[n]   uint64_t, followed by firstPassageCount[n], at byte offset roundTripOffset
+                           (version >= 4; n = numRoundTripBins, 0 if round trips are not tracked)
+
+  All arrays are contiguous and 8-byte aligned, so a restarted run can mmap
+  the file and copy them in one go. Data are stored in native byte order;
+  byteOrderMark is used to reject files written on a machine of different
+  endianness. Bump histogramFileVersion whenever the layout changes.
+*/
+const char     histogramFileMagic[8]  {'O', 'W', 'L', 'H', 'I', 'S', 'T', '\0'};
+const uint32_t histogramFileVersion   {4};
+const uint32_t histogramByteOrderMark {0x01020304};
+
+struct HistogramFileHeader
+{
+  char     magic[8];
+  uint32_t version;
+  uint32_t byteOrderMark;
+  uint32_t headerSize;
+  int32_t  dim;
+
+  double   flatnessCriterion;
+  double   modFactor;
+  double   modFactorFinal;
+  double   modFactorReducer;
+  uint32_t histogramCheckInterval;
+  int32_t  histogramRefreshInterval;
+
+  double   Emin;
+  double   Emax;
+  double   binSize;
+  uint32_t numBins;
+  uint32_t numBinsFailingCriterion;
+
+  uint64_t totalMCsteps;
+  uint64_t acceptedMoves;
+  uint64_t rejectedMoves;
+  uint64_t numBelowRange;
+  uint64_t numAboveRange;
+  int32_t  iterations;
+  int32_t  numHistogramNotImproved;
+  int32_t  numHistogramRefreshed;
+  uint32_t blockSize;                  // version >= 2; 0 in version 1 files
+
+  uint64_t histOffset;
+  uint64_t dosOffset;
+  uint64_t visitedOffset;
+  uint64_t axesOffset;                 // version >= 2
+  uint64_t binEdgesOffset;             // version >= 3
+  uint32_t numBinEdges;                // version >= 3
+  uint32_t windowsRebalanced;          // reserved before; 0 in older files
+
+  uint64_t roundTripOffset;            // version >= 4
+  uint32_t numRoundTripBins;           // version >= 4
+  int32_t  roundTripDirection;
+  uint64_t roundTripClock;
+  uint64_t roundTripStart;
+  uint64_t numRoundTrips;
+  uint64_t roundTripSteps;
+  uint64_t numTunnelings;
+  uint64_t tunnelingSteps;
+  uint64_t numGlobalRoundTrips;
+  int32_t  globalDirection;
+  uint32_t passNumber;
+};
+
+struct HistogramFileAxis
+{
+  int32_t  observableIndex;
+  uint32_t numBins;
+  double   min;
+  double   max;
+  double   binSize;
+};
+
+/*
+  Histogram class:
+
+  EnergyType is the type used to bin the energy. Physical systems report
+  their observables as ObservableType (double); for systems whose energies
+  are exact integers (PhysicalSystem::hasIntegerEnergy), the histogram is
+  instantiated with IntegerObservableType, so that the energy range and the
+  bin lookup are handled with exact integer arithmetic and no division.
+
+  hist, dos, visited and probDistribution allocate their memory in pages of
+  histogramPageSize bins when a page is first written, so bins that are never
+  visited cost no memory. All bins of a page that is not allocated read as zero.
+
+  Non-uniform energy bins (continuous energies only): the bin edges are
+  given by binEdges in the input file, or start from the uniform bins and
+  are refined between WL iterations (binRefinement = 1), halving bins where
+  ln g changes by more than binRefinementThreshold between neighbors. The
+  bin of an energy is found in O(1) from a uniform lookup grid whose cells
+  are no wider than the narrowest bin, so a cell overlaps at most two bins
+  (the grid is capped at 64 cells per bin on average).
+
+  With modFactorSchedule = 1, ln f is divided by modFactorReducer after each
+  flat histogram only until it drops below 1/t, where t = totalMCsteps /
+  numVisitedBins is the MC time in sweeps over the visited bins. From then on
+  ln f = 1/t is updated with the MC time and no flatness checks are needed
+  (Belardinelli and Pereyra, Phys. Rev. E 75, 046701 (2007)).
+
+  Round trips (roundTripStatistics = 1): every histogram entry advances a
+  clock. A round trip runs from the lowest visited energy bin to the highest
+  and back; the first half is a tunneling. For every energy bin, the clock
+  time from leaving the lowest bin to the first arrival in the bin is summed
+  over all upward passes (first-passage times). globalDirection is the same
+  label for the whole energy range of REWL: it is set to +1 in the lowest
+  bin of the lowest window and from +1 to -1 in the highest bin of the
+  highest window, and REWL swaps it together with the configuration, so that
+  numGlobalRoundTrips counts the walks through all windows by way of exchanges.
+
+  Window rebalancing (REWL, uniform 1D bins): a random walk needs a time
+  ~ width^2 to cover a window, so sqrt(MC steps per WL iteration) / width
+  is a cost per unit energy that adds up along the energy axis.
+  rebalanceWindows() lays the windows out with the usual overlap in this
+  cumulative cost instead of in energy, so that all windows are expected
+  to converge in the same time. Each new window takes its ln g from the
+  DOS of all old windows, stitched together across their overlaps.
+
+  Multi-dimensional histograms (dim > 1), e.g. the joint DOS g(E, M):
+  axis d is fed by observables[axisObservable[d]] of the physical system.
+  Axis 0 is the energy axis (range Emin..Emax, split into REWL windows);
+  the other axes are binned in double precision. Bins are stored in
+  blocks of blockSize^dim bins that are contiguous in memory, so that the
+  local moves of a random walk in (E, M) stay within a few cache lines.
+*/
+template <typename EnergyType = ObservableType>
 class Histogram {
 
 public:
@@ -17,8 +161,16 @@ public:
   double       modFactor;                       // natural log of modification factor, f
   double       modFactorFinal;                  // predefined log(f) to terminate simulation
   double       modFactorReducer;                // a factor to reduce log(f)
+  int          modFactorSchedule;               // 0: reduce log(f) by modFactorReducer; 1: switch to log(f) = 1/t
+  bool         oneOverTPhase;                   // true once log(f) follows 1/t
   unsigned int histogramCheckInterval;          // number of MC steps between every histogram flatness check
-  int          histogramRefreshInterval;        // refresh histogram every certain number of histogram checks
+  int          histogramRefreshInterval;        // refresh histogram after this many checks that did not improve it (numHistogramNotImproved)
+  int          histogramFileFormat;             // format of checkpoint files (0: text, 1: binary)
+  unsigned int histogramPageSize;               // bins per lazily allocated page of hist and DOS (0: dense)
+  int          binRefinement;                   // halve energy bins between WL iterations where ln g is steep (0: off)
+  double       binRefinementThreshold;          // difference of ln g between neighboring bins that triggers a split
+  double       binSizeMin;                      // bins are not split below this width
+  int          roundTripStatistics;             // track round trips and first-passage times (0: off)
 
   // MUCA:
   double       KullbackLeiblerDivergence;            // Kullback-Leibler divergence
@@ -34,22 +186,29 @@ public:
   int  iterations;
 
   bool histogramFlat;
-  int  numHistogramNotImproved;
+  int  numHistogramNotImproved;              // flatness checks at which min / mean entries did not improve
   int  numHistogramRefreshed;
 
-  // Constructor
-  Histogram(int = -1, const char* = NULL, const char* = NULL);
+  // Global round trips through all REWL windows; globalDirection travels with the configuration
+  int               globalDirection;         // +1: lowest energy of all windows visited last, -1: highest, 0: neither yet
+  unsigned long int numGlobalRoundTrips;     // arrivals at the lowest energy of all windows with globalDirection == -1
+
+  int  windowsRebalanced;                    // 1 once rebalanceWindows() has moved the REWL windows
+
+  // Constructor; the REWL walker is derived from the MPI rank unless given (threaded walkers)
+  Histogram(int = -1, const char* = NULL, const char* = NULL, int walker = -1);
   
   // Destructor
   ~Histogram();
   
   // Public member functions:
-  ObservableType getBinSize();
+  EnergyType     getBinSize();
   unsigned int   getNumberOfBins();
   double         getDOS(ObservableType energy);
+  int            getDimension();
 
-  void setEnergyRange (ObservableType E1, ObservableType E2);
-  void setBinSize (ObservableType dE);
+  void setEnergyRange (EnergyType E1, EnergyType E2);
+  void setBinSize (EnergyType dE);
   void setNumberOfBins (unsigned int n);
   void resetHistogram();
   void refreshHistogram();
@@ -58,9 +217,38 @@ public:
   void updateHistogram(ObservableType energy);
   void updateDOS(ObservableType energy);
   void updateDOSwithHistogram();
+  bool refineBins();                         // between WL iterations; returns true if bins were split
+  void reduceModFactor();                    // between WL iterations, following modFactorSchedule
+  double getOneOverT();                      // 1/t, with t the MC time in sweeps over the visited bins
+  void averageDOS(MPI_Comm windowComm);      // average ln g over the walkers of an energy window
+  void packWindowState(std::vector<char>& image);                   // for REWL window exchanges
+  void unpackWindowState(const std::vector<char>& image, int window);
+  bool rebalanceWindows(MPI_Comm walkerLeaders, int window);       // by all REWL walker leaders at once
+  bool hasUniformEnergyBins();               // 1D histogram with uniform bins, as rebalanceWindows() requires
+  double getDistanceFromRange(ObservableType energy);              // 0 inside [Emin, Emax]
+
+  // Versions taking all observables of a physical system; valid for any dim
+  double getDOS(const std::vector<ObservableType>& observables);
+  bool   checkObservablesInRange(const std::vector<ObservableType>& observables);
+  void   updateHistogramDOS(const std::vector<ObservableType>& observables);
+  void   updateHistogram(const std::vector<ObservableType>& observables);
+  void   checkObservableIndices(unsigned int numObservables);   // exit if an axis refers to a non-existing observable
+
+  // For walkers on several threads sharing this histogram (SharedDOSWangLandauSampling):
+  // the first three only read, so the threads may call them while no one updates the histogram
+  int    getSharedIndex(const std::vector<ObservableType>& observables);   // storage index; -1 if out of range
+  double getDOSAtIndex(unsigned int index);
+  bool   binVisited(unsigned int index);
+  void   addEntries(unsigned int index, unsigned long int count);        // count updates of one bin at once
 
-  void writeHistogramDOSFile(const char* fileName);
+  void writeHistogramDOSFile(const char* fileName);         // in the format set by histogramFileFormat
+  void stageHistogramDOSFile(const char* fileName);         // ditto, written out in the background (CheckpointWriter)
+  void writeHistogramDOSTextFile(const char* fileName);     // human-readable, for export
+  void stageHistogramDOSTextFile(const char* fileName);     // ditto, written out in the background
+  void writeHistogramDOSBinaryFile(const char* fileName);
   void writeNormDOSFile(const char* fileName);
+  void stageNormDOSFile(const char* fileName);              // written out in the background
+  void printRoundTripStatistics(const char* label = "");
 
   bool checkEnergyInRange(ObservableType energy);
   bool checkHistogramFlatness();             // for WL
@@ -73,25 +261,62 @@ private:
  
   int dim;                                   // dimension of the histogram
 
-  ObservableType Emin;                       // energy range for WL sampling (should they be here?)
-  //double Emin;
-  ObservableType Emax;
-  //double Emax;
-  ObservableType binSize;                    // energy bin size
-  //double binSize;
-  unsigned int numBins;                      // total number of bins
+  EnergyType Emin;                           // energy range for WL sampling (should they be here?)
+  EnergyType Emax;
+  EnergyType binSize;                        // energy bin size
+  uint64_t   binSizeReciprocal;              // ceil(2^64 / binSize), for division-free integer bin lookup
+  unsigned int numBins;                      // total number of bins (storage size, including padding of blocks)
   unsigned int numBinsFailingCriterion;
 
   unsigned long int numBelowRange;           // count the number of configurations that falls below Emin
   unsigned long int numAboveRange;           // count the number of configurations that falls above Emax
 
-  std::vector<unsigned long int> hist;       // an array to store the histogram
-  std::vector<double> dos;                   // an array to store the density of states
-  std::vector<int> visited;                  // an array to mark if a bin is visited
+  PagedArray<unsigned long int> hist;        // an array to store the histogram
+  PagedArray<double> dos;                    // an array to store the density of states
+  PagedArray<int> visited;                   // an array to mark if a bin is visited
   int idx;                                   // index of a bin in the histogram and DOS
 
+  // Flatness bookkeeping, updated incrementally with every histogram entry
+  unsigned int      numVisitedBins;          // number of bins with visited[i] == 1
+  unsigned long int sumEntries;              // sum of hist[i] over visited bins
+  unsigned long int minEntries;              // smallest hist[i] among visited bins
+  unsigned long int lowestCountedEntries;    // minEntries at the last rescan
+  std::vector<unsigned int> binsWithEntries; // number of visited bins with hist[i] == lowestCountedEntries + k (higher counts are not counted)
+  double            lastFlatnessRatio;       // minEntries / mean entries at the previous flatness check
+
+  // Round-trip statistics along the energy axis (roundTripStatistics = 1)
+  unsigned long int roundTripClock;          // number of histogram entries
+  unsigned long int roundTripStart;          // clock when the current upward pass left the lowest bin
+  int               roundTripDirection;      // +1: lowest visited energy bin visited last, -1: highest, 0: neither yet
+  unsigned long int numRoundTrips;           // lowest -> highest -> lowest
+  unsigned long int roundTripSteps;          // summed clock time of all round trips
+  unsigned long int numTunnelings;           // lowest -> highest
+  unsigned long int tunnelingSteps;          // summed clock time of all tunnelings
+  unsigned int      passNumber;              // number of upward passes started
+  unsigned int      lowestVisitedBin;        // extremes of the visited energy bins
+  unsigned int      highestVisitedBin;
+  std::vector<unsigned long int> firstPassageSteps;   // per energy bin, summed over all upward passes
+  std::vector<unsigned long int> firstPassageCount;   // number of upward passes reaching each energy bin
+  std::vector<unsigned int>      firstPassageMark;    // the last passNumber that reached each energy bin
+
+  // Axes of the histogram (index 0: energy axis, mirroring Emin, Emax and binSize)
+  std::vector<unsigned int> axisObservable;  // observable index feeding each axis
+  std::vector<double>       axisMin;
+  std::vector<double>       axisMax;
+  std::vector<double>       axisBinSize;
+  std::vector<unsigned int> axisNumBins;     // number of bins along each axis
+  std::vector<unsigned int> axisNumBlocks;   // number of storage blocks along each axis
+  unsigned int blockSize;                    // bins per axis in a storage block (a power of 2; 1 for dim = 1)
+  unsigned int blockShift;                   // log2(blockSize)
+
+  // Non-uniform energy bins
+  bool nonUniformBinning;                    // true if binEdges is used instead of Emin + i*binSize
+  std::vector<double> binEdges;              // lower edges of all energy bins, followed by Emax
+  std::vector<unsigned int> binLookup;       // the lowest bin overlapping each cell of a uniform grid over [Emin, Emax]
+  double binLookupCellsPerEnergy;            // inverse width of a lookup cell
+
   // MUCA only:
-  std::vector<double> probDistribution;      // an array to store the probablity distribution constructed from a histogram 
+  PagedArray<double> probDistribution;       // an array to store the probablity distribution constructed from a histogram 
 
   // REWL only:
   int numberOfWindows;                       // number of energy sub-windows 
@@ -101,11 +326,324 @@ private:
   int myWindow;
 
   // Private member functions:
-  int   getIndex(ObservableType energy);              // Calculate the bin index from an energy
-  void  readHistogramDOSFile(const char* fileName);
+  static EnergyType toEnergyType(ObservableType energy);   // Convert an observable to the binning type
+  int   getIndex(EnergyType energy);                  // Calculate the bin index from an energy
+  int   getIndex(const std::vector<ObservableType>& observables);   // Storage index of a point in all dim axes
+  unsigned int getStorageIndex(const std::vector<unsigned int>& binCoordinates);
+  void  getBinCoordinates(unsigned int index, std::vector<unsigned int>& binCoordinates);
+  void  setupAxes();                                  // Derive axis bins, blocks and numBins from the ranges
+  void  setupBinEdges();                              // Restrict binEdges to this window, or start them from uniform bins
+  void  setupBinLookup();
+  int   getNonUniformIndex(double energy);
+  void  updateHistogramDOSAtIndex(int storageIndex);
+  void  trackRoundTrip(unsigned int energyBin);       // after each histogram entry, if roundTripStatistics
+  unsigned int getEnergyBin(unsigned int index);      // energy coordinate of a storage index
+  void  findVisitedEnergyRange();                     // Recompute lowestVisitedBin and highestVisitedBin
+  void  resetRoundTripStatistics();
+  void  visitNewBin(unsigned int index);              // First visit of a bin during WL
+  void  countEntry(unsigned int index);               // hist[index]++ for a visited bin, keeping the flatness bookkeeping
+  void  addVisitedBin(unsigned int index);            // Mark a bin as visited, keeping the flatness bookkeeping
+  void  advanceMinimumEntries();                      // Move minEntries up once the last bin at it has moved on
+  void  findMinimumEntries();                         // Rescan for minEntries and recount binsWithEntries
+  void  resetFlatnessBookkeeping();                   // Recount everything from hist and visited
+  void  setupBookkeeping();                           // Derived state after the bins were set up or read
+  void  setupReadState(const char* fileName);         // Check the axes of a state read in
+  void  allocateArrays();                             // Size hist, dos, visited and probDistribution to numBins
+  unsigned int countBinsFailingCriterion();
+  void  setBinSizeReciprocal();
+  void  readHistogramDOSFile(const char* fileName);         // detects the file format from its first bytes
+  void  readHistogramDOSTextFile(const char* fileName);
+  void  readHistogramDOSBinaryFile(const char* fileName);
+  void  readHistogramDOSBinaryImage(const char* fileBegin, size_t fileSize, const char* fileName);
+  void  writeHistogramDOSBinaryImage(std::vector<char>& image);
+  void  printHistogramDOSText(FILE* histdos_file);        // the text format, for files or memory
+  void  printNormDOS(FILE* dosFile);
   void  readMCInputFile(const char* fileName);        // TODO: this should move to MCAlgorithm base class
 
 };
 
+
+// Inline member functions (called on every MC step)
+
+template <typename EnergyType>
+inline EnergyType Histogram<EnergyType>::toEnergyType(ObservableType energy)
+{
+  if constexpr (std::is_integral<EnergyType>::value)
+    // Energies of integer-energy systems are integral; round to guard against accumulated round-off
+    return EnergyType(energy < 0.0 ? energy - 0.5 : energy + 0.5);
+  else
+    return energy;
+}
+
+
+template <typename EnergyType>
+inline int Histogram<EnergyType>::getIndex(EnergyType energy)
+{
+  if constexpr (std::is_integral<EnergyType>::value) {
+    EnergyType offset = energy - Emin;
+    if (offset < 0) return -1;
+    if (binSize == 1) return int(offset);
+#ifdef __SIZEOF_INT128__
+    // Exact quotient for offsets below 2^32 by multiplying with the precomputed reciprocal
+    // Ref: D. Lemire, O. Kaser, and N. Kurz, Softw. Pract. Exp. 49, 525 (2019).
+    return int( (static_cast<unsigned __int128>(binSizeReciprocal) * uint64_t(offset)) >> 64 );
+#else
+    return int(offset / binSize);
+#endif
+  }
+  else {
+    if (nonUniformBinning) return getNonUniformIndex(double(energy));
+    return int( floor(double(energy - Emin) / double(binSize)) );
+  }
+}
+
+
+template <typename EnergyType>
+inline int Histogram<EnergyType>::getNonUniformIndex(double energy)
+{
+  double cell = (energy - binEdges.front()) * binLookupCellsPerEnergy;
+  if (cell < 0.0) return -1;
+  size_t c = std::min(size_t(cell), binLookup.size() - 1);
+
+  // The cell overlaps at most two bins; the loops also absorb round-off in the cell index
+  unsigned int bin = binLookup[c];
+  while (bin + 2 < binEdges.size() && energy >= binEdges[bin + 1]) bin++;
+  while (bin > 0 && energy < binEdges[bin]) bin--;
+  return int(bin);
+}
+
+
+template <typename EnergyType>
+inline int Histogram<EnergyType>::getIndex(const std::vector<ObservableType>& observables)
+{
+  int energyIndex = getIndex(toEnergyType(observables[axisObservable[0]]));
+  if (dim == 1 || energyIndex < 0) return energyIndex;
+
+  unsigned int blockIndex = unsigned(energyIndex) >> blockShift;
+  unsigned int offset     = unsigned(energyIndex) & (blockSize - 1);
+  for (int d=1; d<dim; d++) {
+    double x = (observables[axisObservable[d]] - axisMin[d]) / axisBinSize[d];
+    if (x < 0.0 || x >= double(axisNumBins[d])) return -1;
+    unsigned int i = unsigned(x);
+    blockIndex = blockIndex * axisNumBlocks[d] + (i >> blockShift);
+    offset     = (offset << blockShift) | (i & (blockSize - 1));
+  }
+  return int( (blockIndex << (blockShift * unsigned(dim))) | offset );
+}
+
+
+template <typename EnergyType>
+inline double Histogram<EnergyType>::getDOS(ObservableType energy)
+{
+  idx = getIndex(toEnergyType(energy));
+  if (idx >= 0)
+    return dos[unsigned(idx)];
+  else {
+    std::cerr << "Problem in File " << __FILE__ << " Line " << __LINE__  << "\n";
+    exit(EXIT_FAILURE);
+  }
+}
+
+
+template <typename EnergyType>
+inline double Histogram<EnergyType>::getDOS(const std::vector<ObservableType>& observables)
+{
+  idx = getIndex(observables);
+  if (idx >= 0)
+    return dos[unsigned(idx)];
+  else {
+    std::cerr << "Problem in File " << __FILE__ << " Line " << __LINE__  << "\n";
+    exit(EXIT_FAILURE);
+  }
+}
+
+
+template <typename EnergyType>
+inline int Histogram<EnergyType>::getSharedIndex(const std::vector<ObservableType>& observables)
+{
+  EnergyType energy = toEnergyType(observables[axisObservable[0]]);
+  if (energy < Emin || energy > Emax) return -1;
+
+  for (int d=1; d<dim; d++)
+    if (observables[axisObservable[d]] < axisMin[d] || observables[axisObservable[d]] > axisMax[d])
+      return -1;
+  return getIndex(observables);
+}
+
+
+template <typename EnergyType>
+inline double Histogram<EnergyType>::getDOSAtIndex(unsigned int index)
+{
+  return dos[index];
+}
+
+
+template <typename EnergyType>
+inline bool Histogram<EnergyType>::binVisited(unsigned int index)
+{
+  return visited[index] == 1;
+}
+
+
+template <typename EnergyType>
+inline bool Histogram<EnergyType>::checkEnergyInRange(ObservableType observable)
+{
+  EnergyType energy = toEnergyType(observable);
+  if (energy < Emin) {
+    numBelowRange++;
+    return false;
+  }
+  else if (energy > Emax) {
+    numAboveRange++;
+    return false;
+  }
+  else
+    return true;
+}
+
+
+template <typename EnergyType>
+inline bool Histogram<EnergyType>::checkObservablesInRange(const std::vector<ObservableType>& observables)
+{
+  if (!checkEnergyInRange(observables[axisObservable[0]])) return false;
+
+  for (int d=1; d<dim; d++) {
+    if (observables[axisObservable[d]] < axisMin[d]) {
+      numBelowRange++;
+      return false;
+    }
+    else if (observables[axisObservable[d]] > axisMax[d]) {
+      numAboveRange++;
+      return false;
+    }
+  }
+  return true;
+}
+
+
+// The minimum only changes when the last bin sitting at it is incremented; it then moves up to
+// the next count in binsWithEntries that has bins, which is the one this bin just moved to.
+template <typename EnergyType>
+inline void Histogram<EnergyType>::countEntry(unsigned int index)
+{
+  unsigned long int level = hist.ref(index)++ - lowestCountedEntries;
+  sumEntries++;
+
+  if (level >= binsWithEntries.size()) return;
+  binsWithEntries[level]--;
+  if (level + 1 < binsWithEntries.size())
+    binsWithEntries[level + 1]++;
+  if (level == minEntries - lowestCountedEntries && binsWithEntries[level] == 0)
+    advanceMinimumEntries();
+}
+
+
+template <typename EnergyType>
+inline double Histogram<EnergyType>::getOneOverT()
+{
+  if (totalMCsteps == 0) return 1.0;
+  return double(numVisitedBins) / double(totalMCsteps);
+}
+
+
+template <typename EnergyType>
+inline bool Histogram<EnergyType>::checkHistogramFlatness()
+{
+  if (numVisitedBins == 0) return false;
+
+  double meanEntries = double(sumEntries) / double(numVisitedBins);
+  double flatnessRatio = (meanEntries > 0.0) ? double(minEntries) / meanEntries : 1.0;
+
+  // Counting the bins failing the criterion would take a pass over all bins, so a check
+  // counts as not improved when min / mean did not grow since the previous check
+  if (flatnessRatio <= lastFlatnessRatio)
+    numHistogramNotImproved++;
+  lastFlatnessRatio = flatnessRatio;
+
+  // Every visited bin has at least flatnessCriterion times the mean number of entries
+  return ( double(minEntries) >= flatnessCriterion * meanEntries );
+}
+
+
+template <typename EnergyType>
+inline void Histogram<EnergyType>::updateHistogramDOS(ObservableType energy)
+{
+  updateHistogramDOSAtIndex( getIndex(toEnergyType(energy)) );
+  if (roundTripStatistics)
+    trackRoundTrip(unsigned(idx));
+}
+
+
+template <typename EnergyType>
+inline void Histogram<EnergyType>::updateHistogramDOS(const std::vector<ObservableType>& observables)
+{
+  updateHistogramDOSAtIndex( getIndex(observables) );
+  if (roundTripStatistics)
+    trackRoundTrip( (dim == 1) ? unsigned(idx) : unsigned(getIndex(toEnergyType(observables[axisObservable[0]]))) );
+}
+
+
+template <typename EnergyType>
+inline void Histogram<EnergyType>::trackRoundTrip(unsigned int energyBin)
+{
+  roundTripClock++;
+  if (lowestVisitedBin == highestVisitedBin) return;
+
+  if (energyBin == lowestVisitedBin) {
+    if (roundTripDirection == -1) {
+      numRoundTrips++;
+      roundTripSteps += roundTripClock - roundTripStart;
+    }
+    if (roundTripDirection != 1) {
+      roundTripDirection = 1;
+      roundTripStart     = roundTripClock;
+      passNumber++;
+    }
+    if (myWindow == 0) {
+      if (globalDirection == -1) numGlobalRoundTrips++;
+      globalDirection = 1;
+    }
+  }
+
+  // First arrival in this bin during the current upward pass
+  if (roundTripDirection == 1 && firstPassageMark[energyBin] != passNumber) {
+    firstPassageMark[energyBin]   = passNumber;
+    firstPassageSteps[energyBin] += roundTripClock - roundTripStart;
+    firstPassageCount[energyBin]++;
+  }
+
+  if (energyBin == highestVisitedBin) {
+    if (roundTripDirection == 1) {
+      numTunnelings++;
+      tunnelingSteps += roundTripClock - roundTripStart;
+      roundTripDirection = -1;
+    }
+    if (myWindow == numberOfWindows - 1 && globalDirection == 1)
+      globalDirection = -1;
+  }
+}
+
+
+template <typename EnergyType>
+inline void Histogram<EnergyType>::updateHistogramDOSAtIndex(int storageIndex)
+{
+  idx = storageIndex;
+
+  if ( idx >= 0 ) {
+    unsigned int index = unsigned(idx);
+    if ( visited[index] == 0 )
+      visitNewBin(index);
+    else {
+      dos.ref(index) += modFactor;
+      countEntry(index);
+    }
+  }
+  else {
+    std::cerr << "Error: idx < 0 in updateHistogramDOS!!\n";
+    std::cerr << "Aborting...\n";
+    exit(10);
+  }
+}
+
 #endif
 
@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <cstdio>
 #include <cmath>
 #include "HistogramFreeMUCA.hpp"
+#include "CheckpointWriter.hpp"
 #include "Utilities/RandomNumberGenerator.hpp"
 
 
@@ -11,6 +13,7 @@ DiscreteHistogramFreeMUCA::DiscreteHistogramFreeMUCA(PhysicalSystem* ps) : h(sim
   printf("Simulation method: Histogram-free multicanonical sampling for discrete energy models\n");
   
   physical_system = ps;
+  h.checkObservableIndices(physical_system -> numObservables);
 
   numberOfDataPoints = h.numberOfUpdatesPerIteration;
   DataSet.assign(numberOfDataPoints, 0);
@@ -30,8 +33,6 @@ DiscreteHistogramFreeMUCA::~DiscreteHistogramFreeMUCA()
 void DiscreteHistogramFreeMUCA::run()
 {
 
-  //double currentTime, lastBackUpTime;
-  currentTime = lastBackUpTime = MPI_Wtime();
   if (GlobalComm.thisMPIrank == 0)
     printf("Running DiscreteHistogramFreeMUCA...\n");
 
@@ -44,11 +45,11 @@ void DiscreteHistogramFreeMUCA::run()
     physical_system -> doMCMove();
     physical_system -> getObservables();
     physical_system -> acceptMCMove();    // always accept the move to push the state forward
-    acceptMove = h.checkEnergyInRange(physical_system -> observables[0]);
+    acceptMove = h.checkObservablesInRange(physical_system -> observables);
   }
 
   // Always count the first energy if it is within range
-  h.updateHistogram(physical_system -> observables[0]);
+  h.updateHistogram(physical_system -> observables);
 
   // Write out the initial configuration
   if (GlobalComm.thisMPIrank == 0)
@@ -56,52 +57,58 @@ void DiscreteHistogramFreeMUCA::run()
 
   //-------------- Initialization ends ---------------//
 
+  int checkPointTask = scheduler.addTimeTask(checkPointInterval);
+  scheduler.start();
+
   // MUCA procedure starts here
 
   for (int yw=0; yw<10; yw++) {
   //while (!(h.histogramFlat)) {
 
-    for (unsigned int MCSteps=0; MCSteps<h.numberOfUpdatesPerIteration; MCSteps++) {
+    for (unsigned int MCSteps=0; MCSteps<h.numberOfUpdatesPerIteration; ) {
+
+      // Run the MC steps up to the next periodic task or the end of the iteration
+      unsigned long int numSteps = std::min(scheduler.stepsToNextTask(),
+                                            (unsigned long int)(h.numberOfUpdatesPerIteration - MCSteps));
+      for (unsigned long int step=0; step<numSteps; step++) {
 
-      physical_system -> doMCMove();
-      physical_system -> getObservables();
+        physical_system -> doMCMove();
+        physical_system -> getObservables();
 
-      // check if the energy falls within the energy range
-      if ( !h.checkEnergyInRange(physical_system -> observables[0]) )
-        acceptMove = false;
-      else {
-        // determine WL acceptance
-        if ( exp(h.getDOS(physical_system -> oldObservables[0]) - 
-                 h.getDOS(physical_system -> observables[0])) > getRandomNumber2() )
-          acceptMove = true;
-        else
+        // check if the energy falls within the energy range
+        if ( !h.checkObservablesInRange(physical_system -> observables) )
           acceptMove = false;
-      }
+        else {
+          // determine WL acceptance
+          if ( exp(h.getDOS(physical_system -> oldObservables) - 
+                   h.getDOS(physical_system -> observables)) > getRandomNumber2() )
+            acceptMove = true;
+          else
+            acceptMove = false;
+        }
 
-      if (acceptMove) {
-         // Update histogram with trial state
-         h.updateHistogram(physical_system -> observables[0]);
-         h.acceptedMoves++;        
+        if (acceptMove) {
+           // Update histogram with trial state
+           h.updateHistogram(physical_system -> observables);
+           h.acceptedMoves++;        
 
-         physical_system -> acceptMCMove();
-      }
-      else {
-         physical_system -> rejectMCMove();
+           physical_system -> acceptMCMove();
+        }
+        else {
+           physical_system -> rejectMCMove();
 
-         // Update histogram with old state
-         h.updateHistogram(physical_system -> oldObservables[0]);
-         h.rejectedMoves++;
+           // Update histogram with old state
+           h.updateHistogram(physical_system -> oldObservables);
+           h.rejectedMoves++;
+        }
+        h.totalMCsteps++;
       }
-      h.totalMCsteps++;
-   
+      MCSteps += (unsigned int)(numSteps);
+
       // Write restart files at interval
-      currentTime = MPI_Wtime();
-      if (currentTime - lastBackUpTime > checkPointInterval) {
-        if (GlobalComm.thisMPIrank == 0) {
-          h.writeHistogramDOSFile("hist_dos_checkpoint.dat");
-          physical_system -> writeConfiguration(1, "OWL_restart_configuration");
-          lastBackUpTime = currentTime;
-        }
+      if (scheduler.advance(numSteps) && scheduler.isDue(checkPointTask) && GlobalComm.thisMPIrank == 0) {
+        h.stageHistogramDOSFile("hist_dos_checkpoint.dat");
+        checkpointWriter.writeConfiguration(physical_system, 1, "OWL_restart_configuration");
       }
     }
 
@@ -116,8 +123,8 @@ void DiscreteHistogramFreeMUCA::run()
     
       // Also write restart file here 
       sprintf(fileName, "hist_dos_iteration%02d.dat", h.iterations);
-      h.writeHistogramDOSFile(fileName);
-      physical_system -> writeConfiguration(1, "OWL_restart_input");
+      h.stageHistogramDOSFile(fileName);
+      checkpointWriter.writeConfiguration(physical_system, 1, "OWL_restart_input");
     }
 
     // Go to next iteration
@@ -128,7 +135,7 @@ void DiscreteHistogramFreeMUCA::run()
 
   // Write out data at the end of the simulation
   h.writeNormDOSFile("dos.dat");
-  h.writeHistogramDOSFile("hist_dos_final.dat");
+  h.writeHistogramDOSTextFile("hist_dos_final.dat");
 
 }
 
@@ -19,7 +19,7 @@ public :
 private :
 
   PhysicalSystem*  physical_system;
-  Histogram        h;                        // ironically a histogram is still needed for the discrete case
+  Histogram<>      h;                        // ironically a histogram is still needed for the discrete case
   unsigned int     numberOfDataPoints;       // number of data points in each data set
   std::vector<int> DataSet;                  // The list of energies (data set) in each iteration
 
@@ -1,4 +1,5 @@
 #include <cstdio>
+#include <algorithm>
 #include <cmath>
 #include "MCAlgorithms.hpp"
 
@@ -21,3 +22,110 @@ MonteCarloAlgorithm::~MonteCarloAlgorithm()
 }
 */
 
+
+
+int TaskScheduler::addStepTask(unsigned long int interval, unsigned long int firstDue)
+{
+
+  Task task {};
+  task.wallClock = false;
+  task.interval  = (interval == 0) ? std::numeric_limits<unsigned long int>::max() : interval;
+  task.firstDue  = (interval == 0 || firstDue == 0) ? task.interval : firstDue;
+  tasks.push_back(task);
+  return int(tasks.size()) - 1;
+
+}
+
+
+int TaskScheduler::addTimeTask(double interval)
+{
+
+  Task task {};
+  task.wallClock = true;
+  task.seconds   = interval;
+  tasks.push_back(task);
+  return int(tasks.size()) - 1;
+
+}
+
+
+// Wall-clock tasks start with a countdown of one MC step to measure the step cost
+void TaskScheduler::start()
+{
+
+  startTime  = MPI_Wtime();
+  totalSteps = 0;
+
+  for (auto& task : tasks) {
+    task.stepsLeft   = task.wallClock ? 1 : task.firstDue;
+    task.lastDueTime = startTime;
+    task.due         = false;
+  }
+
+  setNextBlock();
+
+}
+
+
+bool TaskScheduler::isDue(int task)
+{
+
+  bool due = tasks[size_t(task)].due;
+  tasks[size_t(task)].due = false;
+  return due;
+
+}
+
+
+// All blockSteps MC steps up to the first countdown have run
+bool TaskScheduler::updateTasks()
+{
+
+  bool   anyDue = false;
+  double now    = -1.0;
+
+  totalSteps += blockSteps;
+
+  for (auto& task : tasks) {
+
+    task.stepsLeft -= blockSteps;
+    if (task.stepsLeft > 0) continue;
+
+    if (!task.wallClock) {
+      task.due       = true;
+      task.stepsLeft = task.interval;
+    }
+    else {
+      if (now < 0.0) now = MPI_Wtime();
+
+      double timeLeft = task.seconds - (now - task.lastDueTime);
+      if (timeLeft <= 0.0) {
+        task.due         = true;
+        task.lastDueTime = now;
+        timeLeft         = task.seconds;
+      }
+
+      double secondsPerStep = std::max(now - startTime, 1.0e-12) / double(totalSteps);
+      double steps          = std::min(timeLeft / secondsPerStep, double(totalSteps));
+      task.stepsLeft        = (steps < 1.0) ? 1 : (unsigned long int)(steps);
+    }
+
+    anyDue = anyDue || task.due;
+
+  }
+
+  setNextBlock();
+  return anyDue;
+
+}
+
+
+void TaskScheduler::setNextBlock()
+{
+
+  stepsLeft = std::numeric_limits<unsigned long int>::max();
+  for (auto& task : tasks)
+    stepsLeft = std::min(stepsLeft, task.stepsLeft);
+  blockSteps = stepsLeft;
+
+}
@@ -2,6 +2,7 @@
 #define MC_ALGORITHMS_HPP
 
 #include <limits>
+#include <vector>
 #include <mpi.h>
 #include "PhysicalSystems/PhysicalSystemBase.hpp"
 #include "Main/Globals.hpp"
@@ -9,6 +10,60 @@
 
 enum OutputMode {checkPoint, endOfIteration, endOfSimulation};
 
+
+// Periodic tasks of an MC loop (checkpoints, replica exchanges, flatness checks, ...) as
+// countdowns of MC steps, so that the loop itself needs no timer call or modulo per step.
+// The loop runs stepsToNextTask() MC steps, or fewer, then calls advance(); when that
+// returns true, isDue() tells which tasks came due.
+//
+// A step task is due every interval MC steps. A wall-clock task is due about every
+// interval seconds: when its countdown runs out, the scheduler reads the clock, measures
+// the average time per MC step so far and counts down the remaining time in MC steps.
+// A countdown never exceeds the number of steps measured, so the clock is read about
+// log2(steps) times while the step cost is learned, and a few times per interval after.
+class TaskScheduler {
+
+public :
+
+  int  addStepTask(unsigned long int interval, unsigned long int firstDue = 0);   // interval 0: never due
+  int  addTimeTask(double interval);                  // unit: seconds
+  void start();                                       // after adding the tasks, before the first MC step
+
+  unsigned long int stepsToNextTask() const { return stepsLeft; }
+
+  // n MC steps have run, n <= stepsToNextTask(); returns true if any task came due
+  bool advance(unsigned long int n)
+  {
+    stepsLeft -= n;
+    return (stepsLeft == 0) && updateTasks();
+  }
+
+  bool isDue(int task);                               // true once each time the task comes due
+
+private :
+
+  struct Task {
+    bool              wallClock;
+    unsigned long int interval;                       // MC steps, for step tasks
+    unsigned long int firstDue;                       // MC steps to the first time due; 0: interval
+    double            seconds;                        // for wall-clock tasks
+    unsigned long int stepsLeft;
+    double            lastDueTime;
+    bool              due;
+  };
+
+  std::vector<Task> tasks;
+  unsigned long int stepsLeft  {std::numeric_limits<unsigned long int>::max()};
+  unsigned long int blockSteps {std::numeric_limits<unsigned long int>::max()};   // stepsLeft when last set
+  unsigned long int totalSteps {0};
+  double            startTime  {0.0};
+
+  bool updateTasks();
+  void setNextBlock();
+
+};
+
+
 // Base class for all Monte Carlo algorithms
 class MonteCarloAlgorithm {
 
@@ -31,6 +86,8 @@ protected :
   double lastBackUpTime;
   double checkPointInterval {600.0};                           // unit: seconds.
 
+  TaskScheduler scheduler;                                     // periodic tasks of the MC loop
+
   unsigned long int configurationWriteInterval { std::numeric_limits<unsigned long int>::max() };
 
   // it stores the decision of acceptance for each move
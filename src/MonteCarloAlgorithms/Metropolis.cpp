@@ -1,8 +1,16 @@
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <filesystem>
+#include <limits>
 #include <sstream>
+#include <type_traits>
+#include <utility>
 #include "Metropolis.hpp"
+#include "CheckpointWriter.hpp"
+#include "PhysicalSystems/SystemDispatch.hpp"
 #include "Utilities/RandomNumberGenerator.hpp"
 #include "Utilities/CheckFile.hpp"
 #include "Utilities/CompareNumbers.hpp"
@@ -22,6 +30,11 @@ Metropolis::Metropolis(PhysicalSystem* ps, const char* inputFile)
   }
 
   physical_system = ps;
+  acceptance.setTemperature(temperature, physical_system -> hasIntegerEnergy);
+
+  runMCUpdates = dispatchOnSystemType(physical_system, [](auto* system) {
+    return &Metropolis::runMCUpdatesOf<std::remove_pointer_t<decltype(system)>>;
+  });
 
   // Allocate space to store observables and other statistics
   if (physical_system->numObservables > 0) {
@@ -69,26 +82,30 @@ void Metropolis::run()
 
   char fileName[51];
 
-  currentTime = lastBackUpTime = MPI_Wtime();
   if (GlobalComm.thisMPIrank == 0)
     printf("   Running Metropolis Sampling...\n");
 
+  // Configurations are written every configurationWriteInterval MC steps of the accumulation
+  unsigned long int stepsToConfiguration = 0;
+  if (configurationWriteInterval != 0) {
+    unsigned long int thermalizationStepsLeft = (thermalizationStepsPerformed < numberOfThermalizationSteps) ?
+                                                numberOfThermalizationSteps - thermalizationStepsPerformed : 0;
+    stepsToConfiguration  = configurationWriteInterval - MCStepsPerformed % configurationWriteInterval;
+    stepsToConfiguration += std::min(thermalizationStepsLeft, std::numeric_limits<unsigned long int>::max() - stepsToConfiguration);
+  }
+
+  int checkPointTask    = scheduler.addTimeTask(checkPointInterval);
+  int configurationTask = scheduler.addStepTask(configurationWriteInterval, stepsToConfiguration);
+  scheduler.start();
+
+  double startTime = MPI_Wtime();
+  unsigned long int startSteps = thermalizationStepsPerformed + MCStepsPerformed;
+
   // Thermalization (observables are not accumulated)
   while (thermalizationStepsPerformed < numberOfThermalizationSteps) {
   //for (unsigned long int MCSteps=0; MCSteps<numberOfThermalizationSteps; MCSteps++) {
 
-    for (unsigned long int i=0; i<numberOfMCUpdatesPerStep; i++) {
-
-      physical_system -> doMCMove();
-      physical_system -> getObservables();
-  
-      // Determine acceptance
-      if ( exp((physical_system -> oldObservables[0] - physical_system -> observables[0]) / temperature ) > getRandomNumber2() )
-        physical_system -> acceptMCMove(); 
-      else
-        physical_system -> rejectMCMove();
-
-    }
+    (this ->* runMCUpdates)(false);
 
     thermalizationStepsPerformed++;
     physical_system -> getAdditionalObservables();
@@ -97,13 +114,8 @@ void Metropolis::run()
     writeMCFile(thermalizationStepsPerformed);
     
     // Write restart files at interval
-    currentTime = MPI_Wtime();
-    if (GlobalComm.thisMPIrank == 0) {
-      if (currentTime - lastBackUpTime > checkPointInterval) {
-        writeCheckPointFiles(checkPoint);
-        lastBackUpTime = currentTime;
-      }
-    }
+    if (scheduler.advance(1) && scheduler.isDue(checkPointTask) && GlobalComm.thisMPIrank == 0)
+      writeCheckPointFiles(checkPoint);
  
   }
 
@@ -116,22 +128,7 @@ void Metropolis::run()
   while (MCStepsPerformed < numberOfMCSteps) {
   //for (unsigned long int MCSteps=0; MCSteps<numberOfMCSteps; MCSteps++) {
 
-    for (unsigned long int i=0; i<numberOfMCUpdatesPerStep; i++) {
-    
-      physical_system -> doMCMove();
-      physical_system -> getObservables();
-  
-      // Determine acceptance
-      if ( exp((physical_system -> oldObservables[0] - physical_system -> observables[0]) / temperature ) > getRandomNumber2() ) {
-        physical_system -> acceptMCMove();
-        acceptedMoves++;
-      }
-      else {
-        physical_system -> rejectMCMove();
-        rejectedMoves++;
-      }
-
-    }
+    (this ->* runMCUpdates)(true);
     MCStepsPerformed++;
 
     physical_system -> getAdditionalObservables();
@@ -140,28 +137,30 @@ void Metropolis::run()
     // Write observables to file
     writeMCFile(MCStepsPerformed);
 
-    // Write restart files at interval
-    currentTime = MPI_Wtime();
-    if (GlobalComm.thisMPIrank == 0) {
+    if (!scheduler.advance(1)) continue;
 
-      if (currentTime - lastBackUpTime > checkPointInterval) {
-        writeCheckPointFiles(checkPoint);
-        lastBackUpTime = currentTime;
-      }
-
-      if ((configurationWriteInterval != 0) && (MCStepsPerformed % configurationWriteInterval == 0)) {
-        sprintf(fileName, "configurations/config%012lu.dat", MCStepsPerformed);
-        physical_system -> writeConfiguration(0, fileName);
-        //sprintf(fileName, "configurations/config%012lu.xyz", MCStepsPerformed);
-        //physical_system -> writeConfiguration(1, fileName);
-        sprintf(fileName, "configurations/all-configs.dat");
-        physical_system -> writeConfiguration(2, fileName);
-      }
+    // Write restart files at interval
+    if (scheduler.isDue(checkPointTask) && GlobalComm.thisMPIrank == 0)
+      writeCheckPointFiles(checkPoint);
 
+    if (scheduler.isDue(configurationTask) && GlobalComm.thisMPIrank == 0) {
+      sprintf(fileName, "configurations/config%012lu.dat", MCStepsPerformed);
+      physical_system -> writeConfiguration(0, fileName);
+      //sprintf(fileName, "configurations/config%012lu.xyz", MCStepsPerformed);
+      //physical_system -> writeConfiguration(1, fileName);
+      sprintf(fileName, "configurations/all-configs.dat");
+      physical_system -> writeConfiguration(2, fileName);
     }
 
   }
   fprintf(timeSeriesFile, "# End of accumulation. \n\n");
+
+  if (GlobalComm.thisMPIrank == 0) {
+    unsigned long int MCUpdates = (thermalizationStepsPerformed + MCStepsPerformed - startSteps) * numberOfMCUpdatesPerStep;
+    printf("   Performance: %lu MC updates in %.3f seconds (%.4e MC updates per second)\n",
+           MCUpdates, MPI_Wtime() - startTime, double(MCUpdates) / (MPI_Wtime() - startTime));
+  }
+
   writeCheckPointFiles(checkPoint);
 
   calculateAveragesAndVariances();
@@ -395,6 +394,16 @@ void Metropolis::writeStatistics(OutputMode output_mode, const char* filename)
     checkPointFile = fopen(filename, "w");
   else checkPointFile = stdout;
 
+  printStatistics(output_mode, checkPointFile);
+
+  if (filename != NULL) fclose(checkPointFile);
+
+}
+
+
+void Metropolis::printStatistics(OutputMode output_mode, FILE* checkPointFile)
+{
+
   switch(output_mode) {
 
     case endOfSimulation :
@@ -451,8 +460,6 @@ void Metropolis::writeStatistics(OutputMode output_mode, const char* filename)
       
   }
 
-  if (filename != NULL) fclose(checkPointFile);
-
 }
 
 
@@ -473,10 +480,13 @@ void Metropolis::writeCheckPointFiles(OutputMode output_mode)
       writeStatistics(endOfSimulation, "metropolis_final.dat");
       break;
 
-    case checkPoint :
-      physical_system -> writeConfiguration(0, "configurations/config_checkpoint.dat");
-      writeStatistics(checkPoint, "metropolis_checkpoint.dat"); 
+    case checkPoint : {
+      checkpointWriter.writeConfiguration(physical_system, 0, "configurations/config_checkpoint.dat");
+
+      // The statistics are printed into memory and written out in the background as well
+      checkpointWriter.writeTextFile("metropolis_checkpoint.dat", [&](FILE* statisticsStream) { printStatistics(checkPoint, statisticsStream); });
       break;
+    }
 
     default :
       break;
@@ -485,3 +495,30 @@ void Metropolis::writeCheckPointFiles(OutputMode output_mode)
 
 
 }
+
+
+// Accepted and rejected moves are only counted in the accumulation (countMoves)
+template <typename SystemType>
+void Metropolis::runMCUpdatesOf(bool countMoves)
+{
+
+  SystemType* system = static_cast<SystemType*>(physical_system);
+
+  for (unsigned long int i=0; i<numberOfMCUpdatesPerStep; i++) {
+
+    ObservableType energy      = system -> observables[0];
+    ObservableType trialEnergy = system -> proposeMCMove();
+
+    // Determine acceptance
+    if ( acceptance.accept(energy, trialEnergy) ) {
+      system -> commitMCMove();
+      if (countMoves) acceptedMoves++;
+    }
+    else {
+      system -> discardMCMove();
+      if (countMoves) rejectedMoves++;
+    }
+
+  }
+
+}
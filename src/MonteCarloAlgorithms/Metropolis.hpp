@@ -4,6 +4,7 @@
 #include <fstream>
 #include <vector>
 #include "MCAlgorithms.hpp"
+#include "BoltzmannAcceptance.hpp"
 
 
 class Metropolis : public MonteCarloAlgorithm {
@@ -31,6 +32,7 @@ private :
   unsigned long int numberOfMCUpdatesPerStep {1};
   double temperature;
   double restartTemperature;
+  BoltzmannAcceptance acceptance;
 
   unsigned long int thermalizationStepsPerformed {0};
   unsigned long int MCStepsPerformed             {0};
@@ -43,8 +45,14 @@ private :
   
   void writeMCFile(unsigned long int MCSteps);
   void writeStatistics(OutputMode output_mode, const char* = NULL);    // TODO: this should move to MCAlgorithms base class
+  void printStatistics(OutputMode output_mode, FILE* checkPointFile);
   void writeCheckPointFiles(OutputMode output_mode);                   // TODO: this should move to MCAlgorithms base class
 
+  // The MC updates of one MC step (propose/commit protocol), compiled for the type of the
+  // physical system (see PhysicalSystems/SystemDispatch.hpp) and selected in the constructor
+  void (Metropolis::*runMCUpdates)(bool countMoves);
+  template <typename SystemType> void runMCUpdatesOf(bool countMoves);
+
 };
 
 #endif
\ No newline at end of file
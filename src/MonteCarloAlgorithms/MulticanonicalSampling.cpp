@@ -1,9 +1,13 @@
 // MUCA implementation following the recipe suggested in this paper:
 // Ref: J. Gross, J. Zierenberg, M. Weigel, and W. Janke. Comp. Phys. Comm. 224, 387–395 (2018). 
 
+#include <algorithm>
 #include <cstdio>
 #include <cmath>
+#include <type_traits>
 #include "MulticanonicalSampling.hpp"
+#include "CheckpointWriter.hpp"
+#include "PhysicalSystems/SystemDispatch.hpp"
 #include "Utilities/RandomNumberGenerator.hpp"
 
 
@@ -13,6 +17,14 @@ MulticanonicalSampling::MulticanonicalSampling(PhysicalSystem* ps) : h(simInfo.r
 
   printf("\n Simulation method: Multicanonical (MUCA) sampling \n");
   physical_system = ps;
+  h.checkObservableIndices(physical_system -> numObservables);
+
+  runMCSteps = dispatchOnSystemType(physical_system, [&](auto* system) {
+    using SystemType = std::remove_pointer_t<decltype(system)>;
+    if (h.getDimension() > 1)
+      return &MulticanonicalSampling::runJointMCStepsOf<SystemType>;
+    return &MulticanonicalSampling::runMCStepsOf<SystemType>;
+  });
 
 }
 
@@ -29,7 +41,6 @@ MulticanonicalSampling::~MulticanonicalSampling()
 void MulticanonicalSampling::run()
 {
 
-  currentTime = lastBackUpTime = MPI_Wtime();
   if (GlobalComm.thisMPIrank == 0)
     printf("Running Multicanonical Sampling...\n");
 
@@ -42,7 +53,7 @@ void MulticanonicalSampling::run()
     physical_system -> doMCMove();
     physical_system -> getObservables();
     physical_system -> acceptMCMove();    // always accept the move to push the state forward
-    acceptMove = h.checkEnergyInRange(physical_system -> observables[0]);
+    acceptMove = h.checkObservablesInRange(physical_system -> observables);
   }
 
   // Write out the initial configuration
@@ -51,77 +62,29 @@ void MulticanonicalSampling::run()
 
 //---------------- Initialization ends ----------------//
 
+  int checkPointTask = scheduler.addTimeTask(checkPointInterval);
+  scheduler.start();
+
   // MUCA procedure starts here
   while (!(h.histogramFlat)) {
 
     // Thermalization (these steps do not update the histogram)
-    for (unsigned int MCSteps=0; MCSteps<h.numberOfThermalizationSteps; MCSteps++) {
-
-      physical_system -> doMCMove();
-      physical_system -> getObservables();
-
-      // check if the energy falls within the energy range
-      if ( !h.checkEnergyInRange(physical_system -> observables[0]) ) {
-        acceptMove = false;
-        physical_system -> rejectMCMove();
-      }
-      else {
-        // determine acceptance
-        if ( exp(h.getDOS(physical_system -> oldObservables[0]) - 
-                 h.getDOS(physical_system -> observables[0])) > getRandomNumber2() ) {
-          acceptMove = true;
-          physical_system -> acceptMCMove();
-                 }
-        else {
-          acceptMove = false;
-          physical_system -> rejectMCMove();
-        }
-      }
-
-    }
+    (this ->* runMCSteps)(h.numberOfThermalizationSteps, false);
     h.totalMCsteps += h.numberOfThermalizationSteps;
 
     // MUCA statistics starts here
-    for (unsigned int MCSteps=0; MCSteps<h.numberOfUpdatesPerIteration; MCSteps++) {
-
-      physical_system -> doMCMove();
-      physical_system -> getObservables();
-
-      // check if the energy falls within the energy range
-      if ( !h.checkEnergyInRange(physical_system -> observables[0]) )
-        acceptMove = false;
-      else {
-        // determine acceptance
-        if ( exp(h.getDOS(physical_system -> oldObservables[0]) - 
-                 h.getDOS(physical_system -> observables[0])) > getRandomNumber2() )
-          acceptMove = true;
-        else
-          acceptMove = false;
-      }
-
-      if (acceptMove) {
-         // Update histogram with trial state
-         h.updateHistogram(physical_system -> observables[0]);
-         h.acceptedMoves++;        
+    for (unsigned int MCSteps=0; MCSteps<h.numberOfUpdatesPerIteration; ) {
 
-         physical_system -> acceptMCMove();
-      }
-      else {
-         physical_system -> rejectMCMove();
+      // Run the MC steps up to the next periodic task or the end of the iteration
+      unsigned long int numSteps = std::min(scheduler.stepsToNextTask(),
+                                            (unsigned long int)(h.numberOfUpdatesPerIteration - MCSteps));
+      (this ->* runMCSteps)(numSteps, true);
+      MCSteps += (unsigned int)(numSteps);
 
-         // Update histogram with old state
-         h.updateHistogram(physical_system -> oldObservables[0]);
-         h.rejectedMoves++;
-      }
-   
       // Write restart files at interval
-      currentTime = MPI_Wtime();
-      if (currentTime - lastBackUpTime > checkPointInterval) {
-        if (GlobalComm.thisMPIrank == 0) {
-          h.writeHistogramDOSFile("hist_dos_checkpoint.dat");
-          physical_system -> writeConfiguration(1, "OWL_restart_configuration");
-          lastBackUpTime = currentTime;
-        }
+      if (scheduler.advance(numSteps) && scheduler.isDue(checkPointTask) && GlobalComm.thisMPIrank == 0) {
+        h.stageHistogramDOSFile("hist_dos_checkpoint.dat");
+        checkpointWriter.writeConfiguration(physical_system, 1, "OWL_restart_configuration");
       }
     }
     h.totalMCsteps += h.numberOfUpdatesPerIteration;
@@ -136,8 +99,8 @@ void MulticanonicalSampling::run()
     
       // Also write restart file here 
       sprintf(fileName, "hist_dos_iteration%02d.dat", h.iterations);
-      h.writeHistogramDOSFile(fileName);
-      physical_system -> writeConfiguration(1, "OWL_restart_input");
+      h.stageHistogramDOSFile(fileName);
+      checkpointWriter.writeConfiguration(physical_system, 1, "OWL_restart_input");
     }
 
     // Go to next iteration
@@ -152,9 +115,88 @@ void MulticanonicalSampling::run()
   // Write out data at the end of the simulation
   if (GlobalComm.thisMPIrank == 0) {
     h.writeNormDOSFile("dos.dat");
-    h.writeHistogramDOSFile("hist_dos_final.dat");
+    h.writeHistogramDOSTextFile("hist_dos_final.dat");
     printf("Number of total MC steps (including thermalization) = %lu\n", h.totalMCsteps);
   }
 
 }
 
+
+template <typename SystemType>
+void MulticanonicalSampling::runMCStepsOf(unsigned long int numSteps, bool updateHistogram)
+{
+
+  SystemType* system = static_cast<SystemType*>(physical_system);
+  ObservableType energy = system -> observables[0];
+
+  for (unsigned long int step=0; step<numSteps; step++) {
+
+    ObservableType trialEnergy = system -> proposeMCMove();
+
+    // check if the energy falls within the energy range, then determine acceptance
+    acceptMove = h.checkEnergyInRange(trialEnergy) &&
+                 exp(h.getDOS(energy) - h.getDOS(trialEnergy)) > getRandomNumber2();
+
+    if (acceptMove) {
+      system -> commitMCMove();
+      energy = trialEnergy;
+      if (updateHistogram) h.acceptedMoves++;
+    }
+    else {
+      system -> discardMCMove();
+      if (updateHistogram) h.rejectedMoves++;
+    }
+
+    // Update histogram with the state after the move
+    if (updateHistogram)
+      h.updateHistogram(energy);
+  }
+
+}
+
+
+// All observables of the trial state are needed to place it in a joint histogram
+template <typename SystemType>
+void MulticanonicalSampling::runJointMCStepsOf(unsigned long int numSteps, bool updateHistogram)
+{
+
+  SystemType* system = static_cast<SystemType*>(physical_system);
+
+  for (unsigned long int step=0; step<numSteps; step++) {
+
+    system -> doMCMove();
+    system -> getObservables();
+
+    // check if the energy falls within the energy range
+    if ( !h.checkObservablesInRange(system -> observables) )
+      acceptMove = false;
+    else {
+      // determine acceptance
+      if ( exp(h.getDOS(system -> oldObservables) - 
+               h.getDOS(system -> observables)) > getRandomNumber2() )
+        acceptMove = true;
+      else
+        acceptMove = false;
+    }
+
+    if (acceptMove) {
+       // Update histogram with trial state
+       if (updateHistogram) {
+         h.updateHistogram(system -> observables);
+         h.acceptedMoves++;
+       }
+
+       system -> acceptMCMove();
+    }
+    else {
+       system -> rejectMCMove();
+
+       // Update histogram with old state
+       if (updateHistogram) {
+         h.updateHistogram(system -> oldObservables);
+         h.rejectedMoves++;
+       }
+    }
+  }
+
+}
@@ -19,7 +19,14 @@ public :
 private :
 
   PhysicalSystem* physical_system;
-  Histogram h;
+  Histogram<> h;
+
+  // MC steps, compiled for the type of the physical system (see PhysicalSystems/SystemDispatch.hpp)
+  // and selected in the constructor; the histogram is not updated in the thermalization. Moves are
+  // decided on the energy alone (propose/commit protocol), except for joint histograms of several observables.
+  void (MulticanonicalSampling::*runMCSteps)(unsigned long int numSteps, bool updateHistogram);
+  template <typename SystemType> void runMCStepsOf(unsigned long int numSteps, bool updateHistogram);
+  template <typename SystemType> void runJointMCStepsOf(unsigned long int numSteps, bool updateHistogram);
 
 };
 
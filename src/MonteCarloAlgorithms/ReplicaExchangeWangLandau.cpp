@@ -1,19 +1,33 @@
+#include <algorithm>
 #include <cstdio>
 #include <cmath>
+#include <ctime>
 #include <fstream>
 #include <limits>
 #include <string>             // std::string
 #include <sstream>            // std::istringstream
+#include <type_traits>
 #include "ReplicaExchangeWangLandau.hpp"
+#include "CheckpointWriter.hpp"
+#include "PhysicalSystems/SystemDispatch.hpp"
 #include "Utilities/RandomNumberGenerator.hpp"
 
 // Constructor
-ReplicaExchangeWangLandau::ReplicaExchangeWangLandau(PhysicalSystem* ps, MPICommunicator PhySystemComm, MPICommunicator MCAlgorithmComm) : h(simInfo.restartFlag, simInfo.MCInputFile, simInfo.HistogramCheckpointFile)
+template <typename EnergyType>
+ReplicaExchangeWangLandau<EnergyType>::ReplicaExchangeWangLandau(PhysicalSystem* ps, MPICommunicator PhySystemComm, MPICommunicator MCAlgorithmComm) : h(simInfo.restartFlag, simInfo.MCInputFile, simInfo.HistogramCheckpointFile)
 {
 
   std::cout << "Simulation method: Replica-Exchange Wang-Landau sampling\n";
 
   physical_system = ps;
+  h.checkObservableIndices(physical_system -> numObservables);
+
+  runMCSteps = dispatchOnSystemType(physical_system, [&](auto* system) {
+    using SystemType = std::remove_pointer_t<decltype(system)>;
+    if (h.getDimension() > 1)
+      return &ReplicaExchangeWangLandau::runJointMCStepsOf<SystemType>;
+    return &ReplicaExchangeWangLandau::runMCStepsOf<SystemType>;
+  });
 
   /// Pass MPI communicators from arguments
   PhysicalSystemComm = PhySystemComm;
@@ -24,8 +38,29 @@ ReplicaExchangeWangLandau::ReplicaExchangeWangLandau(PhysicalSystem* ps, MPIComm
 
   /// Set initial values for private members
   numWalkers = simInfo.numWalkers;
+  observableDriftCheckInterval = 0;
+  replicaExchangeMode = exchangeConfigurations;
+  windowRebalanceIterations = 0;
+  rankReassignment = 0;
   readREWLInputFile(simInfo.MCInputFile);
 
+  if (replicaExchangeMode < 0 || replicaExchangeMode > 2) {
+    std::cerr << "Error: replicaExchangeMode must be 0 (configurations), 1 (windows) or 2 (automatic). Quiting... \n";
+    exit(7);
+  }
+  // A system that cannot serialize its configuration can only swap windows
+  if (physical_system -> getPackedConfigurationSize() == 0) {
+    if (replicaExchangeMode == exchangeConfigurations) {
+      std::cerr << "Error: this physical system cannot exchange configurations; use replicaExchangeMode 1. Quiting... \n";
+      exit(7);
+    }
+    replicaExchangeMode = exchangeWindows;
+  }
+  if (windowRebalanceIterations > 0 && !h.hasUniformEnergyBins()) {
+    std::cerr << "Error: windowRebalanceIterations requires a one-dimensional histogram with uniform energy bins. Quiting... \n";
+    exit(7);
+  }
+
   /// group processors into different walkers
   walkerID = (GlobalComm.thisMPIrank - (GlobalComm.thisMPIrank % simInfo.numMPIranksPerWalker)) / simInfo.numMPIranksPerWalker;
  
@@ -34,25 +69,106 @@ ReplicaExchangeWangLandau::ReplicaExchangeWangLandau(PhysicalSystem* ps, MPIComm
   //Debugging check
   //printf("Debugging check: Inside REWL constructor. numWalkers = %3d, world_rank = %3d, myWindow = %3d, walkerID = %3d, numWindows = %3d\n", numWalkers, GlobalComm.thisMPIrank, myWindow, walkerID, numWindows);
 
+  // Walker w starts in window slot w
+  mySlot = walkerID;
+  slotOwner.resize(static_cast<size_t>(numWalkers));
+  for (int slot=0; slot<numWalkers; slot++)
+    slotOwner[size_t(slot)] = slot;
+  slotOfWalker = slotOwner;
+  slotRequest  = MPI_REQUEST_NULL;
+
+  // Walkers of the same window average their DOS; only walker leaders take part
+  WindowComm.communicator = MPI_COMM_NULL;
+  regroupWindowComm();
+
+  // The same seed everywhere, so that every walker draws the same partner pairing
+  int partnerSeed = (simInfo.rngSeed == -1) ? int(time(NULL)) : simInfo.rngSeed;
+  GlobalComm.broadcastScalar(partnerSeed, 0);
+  partnerRNG.seed(unsigned(partnerSeed));
+  partnerPermutation.resize(static_cast<size_t>(numWalkersPerWindow));
+
   partnerID     = -1;
   partnerWindow = -1;
+  partnerSlot   = -1;
 
   swapDirection = 0;
 
+  // Exchange messages hold the observables, the ln g ratio, the direction label and the configuration
+  exchangeStage    = exchangeIdle;
+  pendingExchanges = 0;
+  exchangeDecision = 0;
+  acceptedExchanges = 0;
+  sendRequest      = MPI_REQUEST_NULL;
+  recvRequest      = MPI_REQUEST_NULL;
+  partnerGlobalDirection = 0;
+  partnerObservables.resize(physical_system -> numObservables);
+  if (PhysicalSystemComm.thisMPIrank == 0) {
+    int doublesSize, intSize, configurationSize;
+    MPI_Pack_size(int(physical_system -> numObservables) + 1, MPI_DOUBLE, REWLComm.communicator, &doublesSize);
+    MPI_Pack_size(1, MPI_INT, REWLComm.communicator, &intSize);
+    packedConfiguration.resize(physical_system -> getPackedConfigurationSize());
+    MPI_Pack_size(int(packedConfiguration.size()), MPI_BYTE, REWLComm.communicator, &configurationSize);
+
+    // Automatic mode: exchange configurations unless the largest window takes fewer bytes
+    if (replicaExchangeMode == 2) {
+      h.packWindowState(windowImage);
+      unsigned long int windowSize = windowImage.size();
+      MPI_Allreduce(MPI_IN_PLACE, &windowSize, 1, MPI_UNSIGNED_LONG, MPI_MAX, REWLComm.communicator);
+      replicaExchangeMode = (windowSize < (unsigned long int)(configurationSize)) ? exchangeWindows : exchangeConfigurations;
+    }
+
+    exchangeBufferSize = doublesSize + intSize;
+    if (replicaExchangeMode == exchangeConfigurations)
+      exchangeBufferSize += configurationSize;
+    else
+      packedConfiguration.clear();
+    sendBuffer.resize(size_t(exchangeBufferSize));
+    recvBuffer.resize(size_t(exchangeBufferSize));
+  }
+  PhysicalSystemComm.broadcastScalar(replicaExchangeMode, 0);
+
+  // Walkers joining other windows leave the window slots behind, which window exchanges move around
+  if (rankReassignment && (replicaExchangeMode != exchangeConfigurations || windowRebalanceIterations > 0)) {
+    std::cerr << "Error: rankReassignment requires replicaExchangeMode 0 and no windowRebalanceIterations. Quiting... \n";
+    exit(7);
+  }
+
+  SlotComm.communicator = MPI_COMM_NULL;
+  if (replicaExchangeMode == exchangeWindows && PhysicalSystemComm.thisMPIrank == 0)
+    MPI_Comm_dup(REWLComm.communicator, &SlotComm.communicator);
+  SlotComm.initialize();
+
+  if (GlobalComm.thisMPIrank == 0)
+    printf("REWL: replica exchanges swap %s\n", (replicaExchangeMode == exchangeWindows) ? "energy windows" : "configurations");
+
   upExchanges   = 0;
   downExchanges = 0;
 
   MaxModFactor  = std::numeric_limits<double>::max();
+  maxModFactorRequest = MPI_REQUEST_NULL;
   simulationContinues = true;
 
+  MinIterations        = 0;
+  minIterationsRequest = MPI_REQUEST_NULL;
+
+  windowFrozen.assign(static_cast<size_t>(numWindows), 0);
+  NumConverged        = 0;
+  numConvergedRequest = MPI_REQUEST_NULL;
+
   GlobalComm.barrier();
 
 }
 
 
-ReplicaExchangeWangLandau::~ReplicaExchangeWangLandau()
+template <typename EnergyType>
+ReplicaExchangeWangLandau<EnergyType>::~ReplicaExchangeWangLandau()
 {
 
+  if (WindowComm.communicator != MPI_COMM_NULL)
+    WindowComm.finalize();
+  if (SlotComm.communicator != MPI_COMM_NULL)
+    SlotComm.finalize();
+
   if (GlobalComm.thisMPIrank == 0)
     printf("Exiting ReplicaExchangeWangLandau class... \n");
 
@@ -62,7 +178,8 @@ ReplicaExchangeWangLandau::~ReplicaExchangeWangLandau()
 // Public member functions //
 /////////////////////////////
 
-void ReplicaExchangeWangLandau::run()
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::run()
 {
 
   char fileName[51];
@@ -71,18 +188,18 @@ void ReplicaExchangeWangLandau::run()
   if (GlobalComm.thisMPIrank == 0)
     printf("Running ReplicaExchangeWangLandau...\n");
 
-  acceptMove = h.checkEnergyInRange(physical_system -> observables[0]);
+  acceptMove = h.checkObservablesInRange(physical_system -> observables);
 
   // Find the first energy that falls within the WL energy range    
   while (!acceptMove) {
     physical_system -> doMCMove();
     physical_system -> getObservables();
     physical_system -> acceptMCMove();    // always accept the move to push the state forward
-    acceptMove = h.checkEnergyInRange(physical_system -> observables[0]);
+    acceptMove = h.checkObservablesInRange(physical_system -> observables);
   }
 
   // Always accept the first energy if it is within range
-  h.updateHistogramDOS(physical_system -> observables[0]);
+  h.updateHistogramDOS(physical_system -> observables);
 
   // Write out the energy
   if (PhysicalSystemComm.thisMPIrank == 0) {
@@ -99,51 +216,28 @@ void ReplicaExchangeWangLandau::run()
 
 // WL procedure starts here
 
+  int exchangeTask      = scheduler.addStepTask(replicaExchangeInterval);
+  int checkPointTask    = scheduler.addTimeTask(checkPointInterval);
+  int flatnessCheckTask = scheduler.addStepTask(h.histogramCheckInterval);
+  scheduler.start();
+
   while (simulationContinues) {
     h.histogramFlat = false;
 
-    for (unsigned int MCSteps=0; MCSteps<h.histogramCheckInterval; MCSteps++) {
-
-      //========== One MC move update ========== //
+    bool flatnessCheckDue = false;
+    while (!flatnessCheckDue) {
 
-      physical_system -> doMCMove();
-      physical_system -> getObservables();
-
-      // check if the energy falls within the energy range
-      if ( h.checkEnergyInRange(physical_system -> observables[0]) ) {
-        // determine WL acceptance
-        if ( exp(h.getDOS(physical_system -> oldObservables[0]) - 
-                 h.getDOS(physical_system -> observables[0])) > getRandomNumber2() )
-          acceptMove = true;
-        else
-          acceptMove = false;
-      }
-      else        
-        acceptMove = false;
-
-      if (acceptMove) {
-         // Update histogram and DOS with trialEnergy
-         h.updateHistogramDOS(physical_system -> observables[0]);
-         h.acceptedMoves++;
-
-         physical_system -> acceptMCMove();
-      }
-      else {
-         physical_system -> rejectMCMove();
-
-         // Update histogram and DOS with oldEnergy
-         h.updateHistogramDOS(physical_system -> oldObservables[0]);
-         h.rejectedMoves++;
-      }
+      // Run the MC steps up to the next periodic task; an exchange in progress is polled after every step
+      bool exchangeInProgress = (pendingExchanges > 0 || exchangeStage != exchangeIdle);
+      unsigned long int numSteps = exchangeInProgress ? 1 : scheduler.stepsToNextTask();
 
-      //========== One MC move update ========== //
+      (this ->* runMCSteps)(numSteps);
 
       //====== One Replica-exchange update ======//
 
-      if (MCSteps % replicaExchangeInterval == 0) {
-        if (replicaExchange()) {
-          physical_system -> getObservables();
-          h.updateHistogramDOS(physical_system -> observables[0]);
+      if (exchangeInProgress) {
+        if (progressReplicaExchange()) {
+          h.updateHistogramDOS(physical_system -> observables);
           h.acceptedMoves++;
           physical_system -> acceptMCMove();
         }
@@ -151,19 +245,36 @@ void ReplicaExchangeWangLandau::run()
 
       //====== One Replica-exchange update ======//
 
+      if (!scheduler.advance(numSteps)) continue;
+
+      if (scheduler.isDue(exchangeTask))
+        pendingExchanges++;
+
       // Write restart files at interval
-      currentTime = MPI_Wtime();
-      if (currentTime - lastBackUpTime > checkPointInterval) {
+      if (scheduler.isDue(checkPointTask))
         writeCheckPointFiles(checkPoint);
-        lastBackUpTime = currentTime;
-      }
+
+      flatnessCheckDue = scheduler.isDue(flatnessCheckTask);
 
     }
 
+    // Windows change hands in exchanges; complete them before the walkers of a window are regrouped
+    if (replicaExchangeMode == exchangeWindows && numWalkersPerWindow > 1) {
+      completeReplicaExchanges();
+      regroupWindowComm();
+    }
+
     h.totalMCsteps += h.histogramCheckInterval;
 
-    // Check histogram flatness
-    h.histogramFlat = h.checkHistogramFlatness();
+    // Check histogram flatness; in the 1/t phase log(f) follows the MC time instead
+    if (h.oneOverTPhase)
+      h.modFactor = h.getOneOverT();
+    else
+      h.histogramFlat = h.checkHistogramFlatness();
+
+    // With several walkers per window, a window is flat only when all its walkers are
+    if (walkersInMyWindow > 1)
+      mergeWindowDOS();
 
     // Refresh histogram if needed
     //if (h.numHistogramNotImproved >= h.histogramRefreshInterval)
@@ -171,25 +282,52 @@ void ReplicaExchangeWangLandau::run()
     if (h.histogramFlat) {
 
       writeCheckPointFiles(endOfIteration);
-      if (PhysicalSystemComm.thisMPIrank == 0)
-        printf("WalkerID: %05d, Number of iterations performed = %d\n", REWLComm.thisMPIrank, h.iterations);
+      if (PhysicalSystemComm.thisMPIrank == 0 && mySlot >= 0)
+        printf("WalkerID: %05d, Number of iterations performed = %d\n", mySlot, h.iterations);
 
       // Prepare for the next iteration
-      h.modFactor /= h.modFactorReducer;
+      h.reduceModFactor();
+      h.refineBins();
       h.resetHistogram();
       h.iterations++;
 
     }
 
-    // Get the maximum ModFactor among all processors
+    // Get the maximum ModFactor among all walkers, one block behind
     getMaxModFactor();
     if (MaxModFactor < h.modFactorFinal)
       simulationContinues = false;
+    else {
+      checkWindowRebalance();
+      checkRankReassignment();
+    }
+
+  }
 
+  // Every walker has the same number of exchanges due, so the last ones can be completed
+  while (pendingExchanges > 0 || exchangeStage != exchangeIdle) {
+    if (progressReplicaExchange())
+      physical_system -> acceptMCMove();
   }
+  MPI_Wait(&sendRequest, MPI_STATUS_IGNORE);
+  MPI_Wait(&slotRequest, MPI_STATUS_IGNORE);
+  MPI_Wait(&maxModFactorRequest, MPI_STATUS_IGNORE);
+  MPI_Wait(&minIterationsRequest, MPI_STATUS_IGNORE);
+  MPI_Wait(&numConvergedRequest, MPI_STATUS_IGNORE);
     
   writeCheckPointFiles(endOfSimulation);
 
+  // Round trips of every walker within its window, and through all windows by way of exchanges
+  if (h.roundTripStatistics && PhysicalSystemComm.thisMPIrank == 0) {
+    sprintf(fileName, "WalkerID: %05d, ", mySlot);
+    h.printRoundTripStatistics(fileName);
+
+    unsigned long int totalGlobalRoundTrips = 0;
+    MPI_Reduce(&(h.numGlobalRoundTrips), &totalGlobalRoundTrips, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, REWLComm.communicator);
+    if (REWLComm.thisMPIrank == 0)
+      printf("Total number of global round trips through all windows = %lu\n", totalGlobalRoundTrips);
+  }
+
 }
 
 //////////////////////////////
@@ -197,65 +335,123 @@ void ReplicaExchangeWangLandau::run()
 //////////////////////////////
 
 
-bool ReplicaExchangeWangLandau::replicaExchange()
+// Non-blocking replica exchange, polled between MC moves. Exchanges that fall due while
+// one is in flight are counted in pendingExchanges and started in order, so that all walkers
+// go through the same sequence of partner assignments.
+template <typename EnergyType>
+bool ReplicaExchangeWangLandau<EnergyType>::progressReplicaExchange()
 {
 
-  //std::cout << "Debugging check: Inside replicaExchange\n";
+  if (PhysicalSystemComm.thisMPIrank != 0) {
+    pendingExchanges = 0;
+    return false;
+  }
+
+  if (exchangeStage == exchangeIdle) {
+    while (exchangeStage == exchangeIdle && pendingExchanges > 0) {
+      if (!updateSlotOwners()) return false;
+      pendingExchanges--;
+      startReplicaExchange();
+    }
+    return false;
+  }
 
-  double localDOSRatio             {0.0};
-  bool   replicaExchangeAcceptance {false};
-  ObservableType energyForExchange = physical_system -> observables[0];
-  partnerID = -1;
+  int arrived {0};
+  MPI_Test(&recvRequest, &arrived, MPI_STATUS_IGNORE);
+  if (!arrived) return false;
+
+  int position {0};
+  switch (exchangeStage) {
+
+    case awaitingPartner :             // lower walker: send my state, then decide on the reply
+    {
+      packState(0.0);
+      MPI_Isend(sendBuffer.data(), exchangeBufferSize, MPI_PACKED, partnerID, 11, REWLComm.communicator, &sendRequest);
+      MPI_Recv(recvBuffer.data(), exchangeBufferSize, MPI_PACKED, partnerID, 12, REWLComm.communicator, MPI_STATUS_IGNORE);
+
+      double partnerLnDOSRatio;
+      MPI_Unpack(recvBuffer.data(), exchangeBufferSize, &position, partnerObservables.data(), int(partnerObservables.size()), MPI_DOUBLE, REWLComm.communicator);
+      MPI_Unpack(recvBuffer.data(), exchangeBufferSize, &position, &partnerLnDOSRatio, 1, MPI_DOUBLE, REWLComm.communicator);
+      MPI_Unpack(recvBuffer.data(), exchangeBufferSize, &position, &partnerGlobalDirection, 1, MPI_INT, REWLComm.communicator);
+      partnerConfigurationPosition = position;
+
+      exchangeDecision = 0;
+      if ( h.checkObservablesInRange(partnerObservables) && partnerLnDOSRatio > -std::numeric_limits<double>::infinity() ) {
+        double lnAcceptProb = h.getDOS(physical_system -> observables) - h.getDOS(partnerObservables) + partnerLnDOSRatio;
+        if (getRandomNumber2() < exp(lnAcceptProb)) exchangeDecision = 1;
+      }
 
-  // Everyone finds its swap-partner
-  assignSwapPartner();
-  //printf("GlobalID %05d, Walker %05d: partnerID = %05d\n", GlobalComm.thisMPIrank, REWLComm.thisMPIrank, partnerID);
-  //fflush(stdout);
-
-  if ((partnerID != -1) && (PhysicalSystemComm.thisMPIrank == 0)) {
-    // Exchange energy with partner
-    exchangeEnergy(energyForExchange);
-
-    // If the energy received is within my energy range,
-    // calculate DOS ratio from my histogram
-    if ( h.checkEnergyInRange(energyForExchange) )
-      localDOSRatio = exp( h.getDOS(physical_system -> observables[0]) - h.getDOS(energyForExchange) );
-    else localDOSRatio = 0.0;
-    
-    // Exchange DOS ratios and calculate acceptance probability
-    replicaExchangeAcceptance = determineAcceptance(localDOSRatio);
+      MPI_Wait(&sendRequest, MPI_STATUS_IGNORE);
+      MPI_Isend(&exchangeDecision, 1, MPI_INT, partnerID, 13, REWLComm.communicator, &sendRequest);
+      break;
+    }
+
+    case awaitingRequest :             // upper walker: reply with my state and my ln g ratio, then wait for the decision
+    {
+      double unused;
+      MPI_Unpack(recvBuffer.data(), exchangeBufferSize, &position, partnerObservables.data(), int(partnerObservables.size()), MPI_DOUBLE, REWLComm.communicator);
+      MPI_Unpack(recvBuffer.data(), exchangeBufferSize, &position, &unused, 1, MPI_DOUBLE, REWLComm.communicator);
+      MPI_Unpack(recvBuffer.data(), exchangeBufferSize, &position, &partnerGlobalDirection, 1, MPI_INT, REWLComm.communicator);
+      partnerConfigurationPosition = position;
+
+      MPI_Wait(&sendRequest, MPI_STATUS_IGNORE);
+      packState(getLnDOSRatio(partnerObservables));
+      MPI_Isend(sendBuffer.data(), exchangeBufferSize, MPI_PACKED, partnerID, 12, REWLComm.communicator, &sendRequest);
+      MPI_Recv(&exchangeDecision, 1, MPI_INT, partnerID, 13, REWLComm.communicator, MPI_STATUS_IGNORE);
+      break;
+    }
 
-    // Exchange configurations
-    if (replicaExchangeAcceptance) {
+    case exchangeIdle :
+      break;
 
-      physical_system -> observables[0] = energyForExchange;
-      exchangeConfiguration(physical_system -> pointerToConfiguration, 1, physical_system -> MPI_ConfigurationType );
+  }
 
-      // Up to this point, energy = physical_system -> observables[0] and the configuration are new
-      // 1. other observables still need to be calculated, if needed
-      // 2. calculate energy from scratch next time
+  exchangeStage = exchangeIdle;
+  if (exchangeDecision) {
+    if (replicaExchangeMode == exchangeWindows)
+      exchangeWindowState();
+    else
+      acceptPartnerState();
+  }
+  shareWindowSlot();
+  return (exchangeDecision != 0);
 
-    }
-    else {
-      //what to do when a replica exchange move is rejected?
-    }
+}
 
-    // Performance statistics
-  
+
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::startReplicaExchange()
+{
+
+  assignSwapPartner();
+  if (partnerID == -1) {
+    shareWindowSlot();
+    return;
   }
 
-  //REWLComm.barrier();
+  MPI_Wait(&sendRequest, MPI_STATUS_IGNORE);
+  exchangeDecision = 0;
 
-  return replicaExchangeAcceptance;
+  if (partnerWindow > myWindow) {      // lower walker: wait for the upper walker to be ready
+    MPI_Irecv(NULL, 0, MPI_INT, partnerID, 10, REWLComm.communicator, &recvRequest);
+    exchangeStage = awaitingPartner;
+  }
+  else {                               // upper walker: tell the lower walker, and wait for its request
+    MPI_Isend(NULL, 0, MPI_INT, partnerID, 10, REWLComm.communicator, &sendRequest);
+    MPI_Irecv(recvBuffer.data(), exchangeBufferSize, MPI_PACKED, partnerID, 11, REWLComm.communicator, &recvRequest);
+    exchangeStage = awaitingRequest;
+  }
 
 }
 
 
-void ReplicaExchangeWangLandau::assignSwapPartner()
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::assignSwapPartner()
 {
 
   partnerID = -1; 
   partnerWindow = -1; 
+  partnerSlot = -1;
 
   // Find the partner's window
   switch (swapDirection) {
@@ -288,72 +484,224 @@ void ReplicaExchangeWangLandau::assignSwapPartner()
   }
   }
 
-  // Find the partner's ID
+  // A walker without a slot, or a frozen partner window, means no exchange this round;
+  // the pairings below are still drawn to keep partnerRNG in step with all other walkers
+  if (mySlot < 0 || (partnerWindow != -1 && windowFrozen[size_t(partnerWindow)]))
+    partnerWindow = -1;
+
+  // Find the partner's slot
   if (numWalkersPerWindow == 1) {
-    partnerID = partnerWindow;
+    partnerSlot = partnerWindow;
   }
   else {  // multiple walkers per window case
-    // to be implemented...
+    // Every walker draws one random pairing for each pair of windows exchanging now,
+    // in the same order, so that the streams of partnerRNG stay identical everywhere.
+    // Walker k of the lower window is paired with walker partnerPermutation[k] of the upper one.
+    int firstLowerWindow = (swapDirection == 1) ? 0 : 1;    // swapDirection was flipped above
+    int myIndex          = mySlot % numWalkersPerWindow;
+    for (int lowerWindow=firstLowerWindow; lowerWindow<numWindows-1; lowerWindow+=2) {
+      for (int k=0; k<numWalkersPerWindow; k++)
+        partnerPermutation[size_t(k)] = k;
+      std::shuffle(partnerPermutation.begin(), partnerPermutation.end(), partnerRNG);
+
+      if (partnerWindow == -1) continue;
+      if (lowerWindow == myWindow)
+        partnerSlot = partnerWindow * numWalkersPerWindow + partnerPermutation[size_t(myIndex)];
+      else if (lowerWindow == partnerWindow) {
+        int k = int(std::find(partnerPermutation.begin(), partnerPermutation.end(), myIndex) - partnerPermutation.begin());
+        partnerSlot = partnerWindow * numWalkersPerWindow + k;
+      }
+    }
   }
 
+  // ... and the walker holding it
+  if (partnerSlot != -1)
+    partnerID = slotOwner[size_t(partnerSlot)];
+
 }
 
 
-void ReplicaExchangeWangLandau::exchangeEnergy(ObservableType &energyForSwap)
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::mergeWindowDOS()
 {
 
-  if (partnerID != -1)       // Swap energy with partner  
-    REWLComm.swapScalar(energyForSwap, partnerID);
+  // Published REWL scheme: the walkers of a window move on to the next iteration together,
+  // starting from their average ln g. In the 1/t phase there is no flatness criterion,
+  // so ln g is averaged at every check instead.
+  int windowFlat = h.histogramFlat ? 1 : 0;
+
+  if (PhysicalSystemComm.thisMPIrank == 0) {
+    MPI_Allreduce(MPI_IN_PLACE, &windowFlat, 1, MPI_INT, MPI_MIN, WindowComm.communicator);
+    if (windowFlat || h.oneOverTPhase)
+      h.averageDOS(WindowComm.communicator);
+  }
+
+  PhysicalSystemComm.broadcastScalar(windowFlat, 0);
+  h.histogramFlat = (windowFlat == 1);
 
 }
 
 
-bool ReplicaExchangeWangLandau::determineAcceptance(double myDOSRatio)
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::packState(double lnDOSRatio)
 {
 
-  double partnerDOSRatio {0.0};
-  int change {0};
+  int position {0};
+  MPI_Pack(physical_system -> observables.data(), int(physical_system -> observables.size()), MPI_DOUBLE, sendBuffer.data(), exchangeBufferSize, &position, REWLComm.communicator);
+  MPI_Pack(&lnDOSRatio, 1, MPI_DOUBLE, sendBuffer.data(), exchangeBufferSize, &position, REWLComm.communicator);
+  MPI_Pack(&(h.globalDirection), 1, MPI_INT, sendBuffer.data(), exchangeBufferSize, &position, REWLComm.communicator);
+  if (replicaExchangeMode == exchangeWindows)
+    return;
+  physical_system -> packConfiguration(packedConfiguration.data());
+  MPI_Pack(packedConfiguration.data(), int(packedConfiguration.size()), MPI_BYTE, sendBuffer.data(), exchangeBufferSize, &position, REWLComm.communicator);
 
-  if (myWindow % 2 == 1) {          // Receiver and calculator 
-    REWLComm.recvScalar(partnerDOSRatio, partnerID);
+}
 
-    double acceptProb = myDOSRatio * partnerDOSRatio;
 
-    if (getRandomNumber2() < acceptProb) change = 1;
+// ln [g(E_mine) / g(E_new)] from my DOS, or -infinity if E_new is outside my window
+template <typename EnergyType>
+double ReplicaExchangeWangLandau<EnergyType>::getLnDOSRatio(const std::vector<ObservableType>& newObservables)
+{
 
-    REWLComm.sendScalar(change, partnerID);
-  }
-  else {                            // Sender and non-calculator
-    REWLComm.sendScalar(myDOSRatio, partnerID);
-    REWLComm.recvScalar(change, partnerID);
-  }
+  if ( h.checkObservablesInRange(newObservables) )
+    return h.getDOS(physical_system -> observables) - h.getDOS(newObservables);
+  else
+    return -std::numeric_limits<double>::infinity();
+
+}
+
+
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::acceptPartnerState()
+{
+
+  int position = partnerConfigurationPosition;
+  MPI_Unpack(recvBuffer.data(), exchangeBufferSize, &position, packedConfiguration.data(), int(packedConfiguration.size()), MPI_BYTE, REWLComm.communicator);
+  physical_system -> unpackConfiguration(packedConfiguration.data());
+
+  // The observables travel with the configuration; recomputing them is only a periodic check
+  physical_system -> observables = partnerObservables;
+  acceptedExchanges++;
+  if (observableDriftCheckInterval > 0 && acceptedExchanges % observableDriftCheckInterval == 0)
+    checkObservableDrift();
 
-  if (change) return true;
-  else return false;
+  // The direction label of global round trips travels with the configuration
+  if (h.roundTripStatistics)
+    h.globalDirection = partnerGlobalDirection;
 
 }
 
 
-void ReplicaExchangeWangLandau::exchangeConfiguration(void* ptrToConfig, int numElements, MPI_Datatype MPI_config_type)
+// Compare the observables with a calculation from scratch, and continue with the latter
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::checkObservableDrift()
 {
-  if (partnerID != -1) {
-    REWLComm.swapVector(ptrToConfig, numElements, MPI_config_type, partnerID);
-    physical_system -> getObservablesFromScratch = true;
+
+  std::vector<ObservableType> fromScratch;
+  if (!physical_system -> calculateObservablesFromScratch(fromScratch)) return;
+
+  for (size_t i=0; i<fromScratch.size(); i++) {
+    double tolerance = 1.0e-8 * std::max(1.0, fabs(fromScratch[i]));
+    if (fabs(physical_system -> observables[i] - fromScratch[i]) > tolerance) {
+      printf("WalkerID: %05d, Warning: observable %zu drifted to %15.8e, recomputed %15.8e\n",
+             REWLComm.thisMPIrank, i, physical_system -> observables[i], fromScratch[i]);
+      physical_system -> observables[i] = fromScratch[i];
+    }
   }
 
 }
 
 
-void ReplicaExchangeWangLandau::getMaxModFactor()
+// Both walkers have held still since the request, so each continues with its current
+// configuration and observables, which lie in the partner's window
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::exchangeWindowState()
+{
+
+  h.packWindowState(windowImage);
+
+  // Windows may differ in their number of bins
+  unsigned long int windowSize = windowImage.size();
+  unsigned long int partnerWindowSize;
+  MPI_Sendrecv(&windowSize, 1, MPI_UNSIGNED_LONG, partnerID, 14, &partnerWindowSize, 1, MPI_UNSIGNED_LONG, partnerID, 14, REWLComm.communicator, MPI_STATUS_IGNORE);
+  partnerWindowImage.resize(partnerWindowSize);
+  MPI_Sendrecv(windowImage.data(), int(windowSize), MPI_BYTE, partnerID, 15, partnerWindowImage.data(), int(partnerWindowSize), MPI_BYTE, partnerID, 15, REWLComm.communicator, MPI_STATUS_IGNORE);
+
+  h.unpackWindowState(partnerWindowImage, partnerWindow);
+  myWindow = partnerWindow;
+  mySlot   = partnerSlot;
+
+}
+
+
+// Every walker leader takes part in every round of exchanges, with or without a partner,
+// so the rounds line up in one MPI_Iallgather each
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::shareWindowSlot()
+{
+
+  if (replicaExchangeMode != exchangeWindows) return;
+
+  sharedSlot = mySlot;
+  MPI_Iallgather(&sharedSlot, 1, MPI_INT, slotOfWalker.data(), 1, MPI_INT, SlotComm.communicator, &slotRequest);
+
+}
+
+
+template <typename EnergyType>
+bool ReplicaExchangeWangLandau<EnergyType>::updateSlotOwners()
+{
+
+  if (slotRequest == MPI_REQUEST_NULL) return true;
+
+  int completed {0};
+  MPI_Test(&slotRequest, &completed, MPI_STATUS_IGNORE);
+  if (!completed) return false;
+
+  for (int walker=0; walker<numWalkers; walker++)
+    slotOwner[size_t(slotOfWalker[size_t(walker)])] = walker;
+  return true;
+
+}
+
+
+// Split the walker leaders by their current window
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::regroupWindowComm()
+{
+
+  if (WindowComm.communicator != MPI_COMM_NULL)
+    WindowComm.finalize();
+
+  WindowComm.communicator = MPI_COMM_NULL;
+  if (PhysicalSystemComm.thisMPIrank == 0)
+    MPI_Comm_split(REWLComm.communicator, myWindow, mySlot, &WindowComm.communicator);
+  WindowComm.initialize();
+
+  walkersInMyWindow = WindowComm.totalMPIranks;
+  PhysicalSystemComm.broadcastScalar(walkersInMyWindow, 0);
+
+}
+
+
+// The walker leaders reduce log(f) with MPI_Iallreduce while the next block of MC steps runs;
+// the result is then broadcast within each walker. The stopping decision thus lags one block,
+// but no global synchronization is left on the critical path.
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::getMaxModFactor()
 {
 
-  //YingWai's note: will it be more performant if it is split into two steps?  (Dec 25, 17)
-  // 1. Asynchronized AllReduce within REWLComm
-  // 2. Broadcast to group members within PhySystemComm
-  //if (PhysicalSystemComm.thisMPIrank == 0)
-  //  MPI_Allreduce(&(h.modFactor), &MaxModFactor, 1, MPI_DOUBLE, MPI_MAX, REWLComm.communicator);
+  if (PhysicalSystemComm.thisMPIrank == 0) {
+    if (maxModFactorRequest != MPI_REQUEST_NULL) {
+      MPI_Wait(&maxModFactorRequest, MPI_STATUS_IGNORE);
+      MaxModFactor = nextMaxModFactor;
+    }
+
+    reducedModFactor = h.modFactor;
+    MPI_Iallreduce(&reducedModFactor, &nextMaxModFactor, 1, MPI_DOUBLE, MPI_MAX, REWLComm.communicator, &maxModFactorRequest);
+  }
 
-  MPI_Allreduce(&(h.modFactor), &MaxModFactor, 1, MPI_DOUBLE, MPI_MAX, GlobalComm.communicator);
+  PhysicalSystemComm.broadcastScalar(MaxModFactor, 0);
 
   // Debugging Check
   //printf("GlobalID %05d, MaxModFactor = %15.10e, LocalModFactor = %15.10e\n", GlobalComm.thisMPIrank, MaxModFactor, h.modFactor);
@@ -361,43 +709,296 @@ void ReplicaExchangeWangLandau::getMaxModFactor()
 }
 
 
-void ReplicaExchangeWangLandau::writeCheckPointFiles(OutputMode output_mode)
+// Like log(f), the smallest number of iterations is reduced one block behind, so that all
+// walkers decide in the same block
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::checkWindowRebalance()
+{
+
+  if (windowRebalanceIterations <= 0 || h.windowsRebalanced) return;
+
+  if (PhysicalSystemComm.thisMPIrank == 0 && minIterationsRequest != MPI_REQUEST_NULL) {
+    MPI_Wait(&minIterationsRequest, MPI_STATUS_IGNORE);
+    MinIterations = nextMinIterations;
+  }
+  PhysicalSystemComm.broadcastScalar(MinIterations, 0);
+
+  if (MinIterations >= windowRebalanceIterations) {
+    rebalanceWindows();
+    return;
+  }
+
+  if (PhysicalSystemComm.thisMPIrank == 0) {
+    reducedIterations = h.iterations;
+    MPI_Iallreduce(&reducedIterations, &nextMinIterations, 1, MPI_INT, MPI_MIN, REWLComm.communicator, &minIterationsRequest);
+  }
+
+}
+
+
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::rebalanceWindows()
+{
+
+  completeReplicaExchanges();
+
+  int rebalanced {0};
+  if (PhysicalSystemComm.thisMPIrank == 0) {
+    rebalanced = h.rebalanceWindows(REWLComm.communicator, myWindow) ? 1 : 0;
+    if (rebalanced) h.packWindowState(windowImage);
+  }
+  PhysicalSystemComm.broadcastScalar(rebalanced, 0);
+  if (!rebalanced) {
+    windowRebalanceIterations = 0;
+    return;
+  }
+
+  // The other ranks of a walker follow their leader
+  if (PhysicalSystemComm.totalMPIranks > 1) {
+    unsigned long int windowSize = windowImage.size();
+    MPI_Bcast(&windowSize, 1, MPI_UNSIGNED_LONG, 0, PhysicalSystemComm.communicator);
+    windowImage.resize(windowSize);
+    MPI_Bcast(windowImage.data(), int(windowSize), MPI_BYTE, 0, PhysicalSystemComm.communicator);
+    if (PhysicalSystemComm.thisMPIrank != 0)
+      h.unpackWindowState(windowImage, myWindow);
+  }
+
+  walkIntoWindow();
+
+}
+
+
+// The walker leaders are about to meet in a blocking collective, where a partner still waiting
+// for a reply or decision would never get one. Every walker has the same exchanges due.
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::completeReplicaExchanges()
+{
+
+  while (pendingExchanges > 0 || exchangeStage != exchangeIdle) {
+    if (progressReplicaExchange()) {
+      h.updateHistogramDOS(physical_system -> observables);
+      h.acceptedMoves++;
+      physical_system -> acceptMCMove();
+    }
+  }
+
+}
+
+
+// Accept only moves that do not take the energy further from the window, then count the first
+// energy inside it. The windows overlap, so the walk is short unless a window moved far.
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::walkIntoWindow()
+{
+
+  double distance = h.getDistanceFromRange(physical_system -> observables[0]);
+  while (distance > 0.0) {
+    physical_system -> doMCMove();
+    physical_system -> getObservables();
+    double newDistance = h.getDistanceFromRange(physical_system -> observables[0]);
+    if (newDistance <= distance) {
+      physical_system -> acceptMCMove();
+      distance = newDistance;
+    }
+    else
+      physical_system -> rejectMCMove();
+  }
+
+  h.updateHistogramDOS(physical_system -> observables);
+
+}
+
+
+// Like log(f), the number of converged walkers is reduced one block behind, so that all
+// walkers decide in the same block; the reduction for this block starts after any reassignment
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::checkRankReassignment()
+{
+
+  if (!rankReassignment) return;
+
+  if (PhysicalSystemComm.thisMPIrank == 0 && numConvergedRequest != MPI_REQUEST_NULL) {
+    MPI_Wait(&numConvergedRequest, MPI_STATUS_IGNORE);
+    NumConverged = nextNumConverged;
+  }
+  PhysicalSystemComm.broadcastScalar(NumConverged, 0);
+
+  if (NumConverged > 0)
+    reassignConvergedWalkers();
+
+  if (PhysicalSystemComm.thisMPIrank == 0) {
+    reducedConverged = (h.modFactor < h.modFactorFinal) ? 1 : 0;
+    MPI_Iallreduce(&reducedConverged, &nextNumConverged, 1, MPI_INT, MPI_SUM, REWLComm.communicator, &numConvergedRequest);
+  }
+
+}
+
+
+// Every walker leader gathers the windows and log(f) of all walkers and computes the same
+// assignment: the walkers of converged windows go, in the order of their IDs, to the window
+// with the most work left per walker, taken as log(f / modFactorFinal) over its walkers.
+// The first walker of that window sends them its window state and configuration.
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::reassignConvergedWalkers()
+{
+
+  completeReplicaExchanges();
+
+  int targetWindow {-1};
+  int released     {0};
+
+  if (PhysicalSystemComm.thisMPIrank == 0) {
+    std::vector<int>    walkerWindow(static_cast<size_t>(numWalkers));
+    std::vector<double> walkerModFactor(static_cast<size_t>(numWalkers));
+    MPI_Allgather(&myWindow, 1, MPI_INT, walkerWindow.data(), 1, MPI_INT, REWLComm.communicator);
+    MPI_Allgather(&(h.modFactor), 1, MPI_DOUBLE, walkerModFactor.data(), 1, MPI_DOUBLE, REWLComm.communicator);
+
+    // The walkers of a window share log(f), as they merge their DOS at every flatness check
+    for (int walker=0; walker<numWalkers; walker++)
+      if (walkerModFactor[size_t(walker)] < h.modFactorFinal)
+        windowFrozen[size_t(walkerWindow[size_t(walker)])] = 1;
+
+    std::vector<double> workLeft(static_cast<size_t>(numWindows), 0.0);
+    std::vector<int>    walkersInWindow(static_cast<size_t>(numWindows), 0);
+    std::vector<int>    donor(static_cast<size_t>(numWindows), -1);
+    for (int walker=0; walker<numWalkers; walker++) {
+      size_t window = size_t(walkerWindow[size_t(walker)]);
+      if (windowFrozen[window]) continue;
+      workLeft[window] = log(walkerModFactor[size_t(walker)] / h.modFactorFinal);
+      walkersInWindow[window]++;
+      if (donor[window] == -1) donor[window] = walker;
+    }
+
+    std::vector<int> newWindow(static_cast<size_t>(numWalkers), -1);
+    for (int walker=0; walker<numWalkers; walker++) {
+      if (!windowFrozen[size_t(walkerWindow[size_t(walker)])]) continue;
+      int best {-1};
+      for (int window=0; window<numWindows; window++) {
+        if (windowFrozen[size_t(window)] || walkersInWindow[size_t(window)] == 0) continue;
+        if (best == -1 || workLeft[size_t(window)] / walkersInWindow[size_t(window)] >
+                          workLeft[size_t(best)]   / walkersInWindow[size_t(best)])
+          best = window;
+      }
+      newWindow[size_t(walker)] = best;
+      if (best != -1) walkersInWindow[size_t(best)]++;
+    }
+
+    released     = windowFrozen[size_t(myWindow)];
+    targetWindow = newWindow[size_t(REWLComm.thisMPIrank)];
+
+    // The final files of a window are written as soon as it is frozen
+    if (released && mySlot >= 0) {
+      writeCheckPointFiles(checkPoint);
+      writeCheckPointFiles(endOfSimulation);
+      if (targetWindow != -1)
+        printf("WalkerID: %05d, window %d converged, joining window %d\n", mySlot, myWindow, targetWindow);
+      mySlot = -1;
+    }
+
+    // Window state and configuration; a donor is never released, so no walker sends and receives
+    if (!released && donor[size_t(myWindow)] == REWLComm.thisMPIrank) {
+      h.packWindowState(windowImage);
+      unsigned long int windowSize = windowImage.size();
+      MPI_Wait(&sendRequest, MPI_STATUS_IGNORE);
+      packState(0.0);
+      for (int walker=0; walker<numWalkers; walker++) {
+        if (newWindow[size_t(walker)] != myWindow) continue;
+        MPI_Send(&windowSize, 1, MPI_UNSIGNED_LONG, walker, 16, REWLComm.communicator);
+        MPI_Send(windowImage.data(), int(windowSize), MPI_BYTE, walker, 17, REWLComm.communicator);
+        MPI_Send(sendBuffer.data(), exchangeBufferSize, MPI_PACKED, walker, 18, REWLComm.communicator);
+      }
+    }
+
+    if (targetWindow != -1) {
+      int donorID = donor[size_t(targetWindow)];
+      unsigned long int windowSize;
+      MPI_Recv(&windowSize, 1, MPI_UNSIGNED_LONG, donorID, 16, REWLComm.communicator, MPI_STATUS_IGNORE);
+      windowImage.resize(windowSize);
+      MPI_Recv(windowImage.data(), int(windowSize), MPI_BYTE, donorID, 17, REWLComm.communicator, MPI_STATUS_IGNORE);
+      MPI_Recv(recvBuffer.data(), exchangeBufferSize, MPI_PACKED, donorID, 18, REWLComm.communicator, MPI_STATUS_IGNORE);
+
+      h.unpackWindowState(windowImage, targetWindow);
+      myWindow = targetWindow;
+
+      double unused;
+      int    position {0};
+      MPI_Unpack(recvBuffer.data(), exchangeBufferSize, &position, physical_system -> observables.data(), int(physical_system -> observables.size()), MPI_DOUBLE, REWLComm.communicator);
+      MPI_Unpack(recvBuffer.data(), exchangeBufferSize, &position, &unused, 1, MPI_DOUBLE, REWLComm.communicator);
+      MPI_Unpack(recvBuffer.data(), exchangeBufferSize, &position, &(h.globalDirection), 1, MPI_INT, REWLComm.communicator);
+      MPI_Unpack(recvBuffer.data(), exchangeBufferSize, &position, packedConfiguration.data(), int(packedConfiguration.size()), MPI_BYTE, REWLComm.communicator);
+      physical_system -> unpackConfiguration(packedConfiguration.data());
+
+      h.updateHistogramDOS(physical_system -> observables);
+      h.acceptedMoves++;
+      physical_system -> acceptMCMove();
+    }
+  }
+
+  // The other ranks of a walker follow their leader, as in rebalanceWindows()
+  PhysicalSystemComm.broadcastScalar(targetWindow, 0);
+  PhysicalSystemComm.broadcastScalar(mySlot, 0);
+  if (targetWindow != -1 && PhysicalSystemComm.totalMPIranks > 1) {
+    unsigned long int windowSize = windowImage.size();
+    MPI_Bcast(&windowSize, 1, MPI_UNSIGNED_LONG, 0, PhysicalSystemComm.communicator);
+    windowImage.resize(windowSize);
+    MPI_Bcast(windowImage.data(), int(windowSize), MPI_BYTE, 0, PhysicalSystemComm.communicator);
+    if (PhysicalSystemComm.thisMPIrank != 0) {
+      h.unpackWindowState(windowImage, targetWindow);
+      myWindow = targetWindow;
+    }
+  }
+
+  regroupWindowComm();
+
+}
+
+
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::writeCheckPointFiles(OutputMode output_mode)
 {
 
   char fileName[51];
 
+  // A walker that joined another window leaves its files to the walkers holding its slots
+  if (mySlot < 0) return;
+
   if (PhysicalSystemComm.thisMPIrank == 0) {
 
     switch (output_mode) {
  
       case endOfIteration :
         sprintf(fileName, "config_checkpoint_walker%05d.dat", REWLComm.thisMPIrank);
-        physical_system -> writeConfiguration(1, fileName);
-        sprintf(fileName, "hist_dos_iteration%02d_walker%05d.dat", h.iterations, REWLComm.thisMPIrank);
+        checkpointWriter.writeConfiguration(physical_system, 1, fileName);
+        sprintf(fileName, "hist_dos_iteration%02d_walker%05d.dat", h.iterations, mySlot);
         break;
 
       case endOfSimulation :
-        sprintf(fileName, "dos_walker%05d.dat", REWLComm.thisMPIrank);
-        h.writeNormDOSFile(fileName);
-        sprintf(fileName, "hist_dos_final_walker%05d.dat", REWLComm.thisMPIrank);
+        sprintf(fileName, "dos_walker%05d.dat", mySlot);
+        h.stageNormDOSFile(fileName);
+        sprintf(fileName, "hist_dos_final_walker%05d.dat", mySlot);
         break;
 
       case checkPoint :   // checkpoint every other time  
         sprintf(fileName, "config_checkpoint_walker%05d.dat", REWLComm.thisMPIrank);
-        physical_system -> writeConfiguration(1, fileName);
-        sprintf(fileName, "hist_dos_checkpoint_walker%05d.dat", REWLComm.thisMPIrank);
+        checkpointWriter.writeConfiguration(physical_system, 1, fileName);
+        sprintf(fileName, "hist_dos_checkpoint_walker%05d.dat", mySlot);
         break;
     
     }
 
-    h.writeHistogramDOSFile(fileName);
+    // Final results are kept human-readable for export
+    if (output_mode == endOfSimulation)
+      h.stageHistogramDOSTextFile(fileName);
+    else
+      h.stageHistogramDOSFile(fileName);
 
   }
 
 }
 
 
-void ReplicaExchangeWangLandau::readREWLInputFile(const char* fileName)
+template <typename EnergyType>
+void ReplicaExchangeWangLandau<EnergyType>::readREWLInputFile(const char* fileName)
 {
   
   std::cout << "Reading REWL input file: " << fileName << "\n";
@@ -436,6 +1037,22 @@ void ReplicaExchangeWangLandau::readREWLInputFile(const char* fileName)
             //std::cout << "REWL: replicaExchangeInterval = " << replicaExchangeInterval << "\n";
             continue;
           }
+          if (key == "replicaExchangeMode") {
+            lineStream >> replicaExchangeMode;
+            continue;
+          }
+          if (key == "observableDriftCheckInterval") {
+            lineStream >> observableDriftCheckInterval;
+            continue;
+          }
+          if (key == "windowRebalanceIterations") {
+            lineStream >> windowRebalanceIterations;
+            continue;
+          }
+          if (key == "rankReassignment") {
+            lineStream >> rankReassignment;
+            continue;
+          }
   
         }
 
@@ -448,3 +1065,92 @@ void ReplicaExchangeWangLandau::readREWLInputFile(const char* fileName)
 
 }
 
+
+template <typename EnergyType>
+template <typename SystemType>
+void ReplicaExchangeWangLandau<EnergyType>::runMCStepsOf(unsigned long int numSteps)
+{
+
+  SystemType* system = static_cast<SystemType*>(physical_system);
+  ObservableType energy = system -> observables[0];
+
+  for (unsigned long int MCSteps=0; MCSteps<numSteps; MCSteps++) {
+
+    //========== One MC move update ========== //
+
+    ObservableType trialEnergy = system -> proposeMCMove();
+
+    // check if the energy falls within the energy range, then determine WL acceptance
+    acceptMove = h.checkEnergyInRange(trialEnergy) &&
+                 exp(h.getDOS(energy) - h.getDOS(trialEnergy)) > getRandomNumber2();
+
+    if (acceptMove) {
+      system -> commitMCMove();
+      energy = trialEnergy;
+      h.acceptedMoves++;
+    }
+    else {
+      system -> discardMCMove();
+      h.rejectedMoves++;
+    }
+
+    // Update histogram and DOS with the energy after the move
+    h.updateHistogramDOS(energy);
+
+    //========== One MC move update ========== //
+  }
+
+}
+
+
+// All observables of the trial state are needed to place it in a joint histogram
+template <typename EnergyType>
+template <typename SystemType>
+void ReplicaExchangeWangLandau<EnergyType>::runJointMCStepsOf(unsigned long int numSteps)
+{
+
+  SystemType* system = static_cast<SystemType*>(physical_system);
+
+  for (unsigned long int MCSteps=0; MCSteps<numSteps; MCSteps++) {
+
+    //========== One MC move update ========== //
+
+    system -> doMCMove();
+    system -> getObservables();
+
+    // check if the energy falls within the energy range
+    if ( h.checkObservablesInRange(system -> observables) ) {
+      // determine WL acceptance
+      if ( exp(h.getDOS(system -> oldObservables) - 
+               h.getDOS(system -> observables)) > getRandomNumber2() )
+        acceptMove = true;
+      else
+        acceptMove = false;
+    }
+    else        
+      acceptMove = false;
+
+    if (acceptMove) {
+       // Update histogram and DOS with trialEnergy
+       h.updateHistogramDOS(system -> observables);
+       h.acceptedMoves++;
+
+       system -> acceptMCMove();
+    }
+    else {
+       system -> rejectMCMove();
+
+       // Update histogram and DOS with oldEnergy
+       h.updateHistogramDOS(system -> oldObservables);
+       h.rejectedMoves++;
+    }
+
+    //========== One MC move update ========== //
+  }
+
+}
+
+
+// Explicit instantiations
+template class ReplicaExchangeWangLandau<ObservableType>;
+template class ReplicaExchangeWangLandau<IntegerObservableType>;
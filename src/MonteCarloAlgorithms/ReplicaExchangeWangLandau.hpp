@@ -1,6 +1,7 @@
 #ifndef REPLICA_EXCHANGE_WANG_LANDAU_HPP
 #define REPLICA_EXCHANGE_WANG_LANDAU_HPP
 
+#include <random>
 #include "MCAlgorithms.hpp"
 #include "Histogram.hpp"
 #include "Main/Communications.hpp"
@@ -10,12 +11,45 @@
 
   This class implements replica-exchange Wang-Landau sampling (REWL). 
   Reference: Phys. Rev. Lett. 110, 210603 (2013)
+
+  Rank reassignment (rankReassignment = 1, configuration exchanges only): once the walkers of a
+  window reach modFactorFinal, the window is frozen and its final files are written. Its walkers
+  then join the windows with the most WL iterations left per walker, each starting from a copy
+  of the window and the configuration of a walker already there, and merge their DOS with the
+  other walkers of the window as with numberOfWalkersPerWindow > 1. A walker that has left its
+  window holds no window slot (mySlot = -1): it takes no part in replica exchanges and leaves
+  the output files of its new window to the walkers holding its slots.
 */
 
 // TO DO: distinguish WalkerType and WindowType
 typedef int WalkerIDType;
 typedef int WindowIDype;
 
+// Stages of a non-blocking replica exchange. A walker whose exchange is due keeps sampling,
+// and polls between MC moves, until its partner is due as well:
+//   awaitingPartner (lower walker): for the ready message of the upper walker
+//   awaitingRequest (upper walker): for the request of the lower walker
+// The exchange itself then takes one round trip:
+//   1. request  (lower -> upper): observables and configuration
+//   2. reply    (upper -> lower): observables, ln g ratio and configuration of the upper walker
+//   3. decision (lower -> upper)
+// The lower walker waits for the reply and the upper walker for the decision, so that the
+// acceptance ratio and the swap apply to the current configurations of both (detailed balance).
+// As the upper walker polls after every move, this costs about one move and two messages.
+enum ExchangeStage {exchangeIdle, awaitingPartner, awaitingRequest};
+
+// What an accepted exchange swaps (input key replicaExchangeMode; 2 picks the smaller of the two):
+//   configurations : the walkers swap configurations and keep their energy windows
+//   windows        : the walkers keep their configurations (and any state the physical system
+//                    derived from them) and swap their windows, i.e. histogram, DOS and all
+//                    WL bookkeeping.
+// A window slot s = window * numWalkersPerWindow + k is the k-th place of a window. With
+// configuration exchanges walker s always holds slot s; with window exchanges the slots move
+// between walkers, and the walker leaders share who holds which after every exchange round.
+enum ReplicaExchangeMode {exchangeConfigurations, exchangeWindows};
+
+// EnergyType: binning type of the histogram (see Histogram.hpp)
+template <typename EnergyType>
 class ReplicaExchangeWangLandau : public MonteCarloAlgorithm {
 
 public :
@@ -28,13 +62,15 @@ public :
 private :
 
   PhysicalSystem* physical_system;
-  Histogram h;
+  Histogram<EnergyType> h;
 
   /// YingWai's note: (Sep 17, 2017)
   /// Is it better to have the random number generator here?
  
   MPICommunicator PhysicalSystemComm;
   MPICommunicator REWLComm;
+  MPICommunicator WindowComm;                 // walkers of my energy window (rank 0 of each walker only)
+  MPICommunicator SlotComm;                   // duplicate of REWLComm for sharing the window slots
   int numWalkers;
   int numWindows;
   int numWalkersPerWindow;
@@ -42,11 +78,42 @@ private :
 
   int walkerID;
   int myWindow;
+  int mySlot;
   int partnerID;
   int partnerWindow;
+  int partnerSlot;
 
   unsigned int replicaExchangeInterval;
   int          swapDirection;
+  int          replicaExchangeMode;          // ReplicaExchangeMode, or 2 while it is to be chosen
+
+  std::vector<int>  slotOwner;               // walker holding each window slot
+  std::vector<int>  slotOfWalker;            // receive buffer of the slot sharing
+  int               sharedSlot;
+  MPI_Request       slotRequest;
+  std::vector<char> windowImage;             // packed window states (Histogram::packWindowState)
+  std::vector<char> partnerWindowImage;
+
+  ExchangeStage     exchangeStage;
+  unsigned long int pendingExchanges;        // exchanges due but not started, while another one is in flight
+  int               exchangeDecision;
+  int               exchangeBufferSize;
+  int               partnerConfigurationPosition;  // of the partner's configuration in recvBuffer
+  std::vector<char> sendBuffer;
+  std::vector<char> recvBuffer;
+  std::vector<uint8_t> packedConfiguration;  // serialized configuration (PhysicalSystem::packConfiguration)
+  MPI_Request       sendRequest;
+  MPI_Request       recvRequest;
+  std::vector<ObservableType> partnerObservables;
+  int               partnerGlobalDirection;
+
+  unsigned long int acceptedExchanges;
+  unsigned long int observableDriftCheckInterval;   // accepted exchanges between checks of the shipped observables; 0: never
+
+  // Pairs walkers of neighboring windows at random; seeded identically on all
+  // ranks so that both sides of an exchange draw the same pairing
+  std::mt19937 partnerRNG;
+  std::vector<int> partnerPermutation;
 
   int upExchanges;
   int downExchanges;
@@ -54,35 +121,62 @@ private :
   double MaxModFactor;
   bool simulationContinues;
 
+  // Reduction of log(f) among walker leaders, overlapped with the next block of MC steps
+  double      reducedModFactor;                // my log(f) at the start of the reduction
+  double      nextMaxModFactor;
+  MPI_Request maxModFactorRequest;
+
+  // Window rebalancing once every window has completed windowRebalanceIterations WL iterations (0: never)
+  int         windowRebalanceIterations;
+  int         MinIterations;                   // smallest number of iterations of all windows, one block behind
+  int         reducedIterations;
+  int         nextMinIterations;
+  MPI_Request minIterationsRequest;
+
+  // Rank reassignment once windows converge (rankReassignment = 1)
+  int              rankReassignment;
+  std::vector<int> windowFrozen;               // 1 for windows that reached modFactorFinal and were released
+  int              walkersInMyWindow;          // size of WindowComm, known to all ranks of the walker
+  int              NumConverged;               // walkers with log(f) below modFactorFinal, one block behind
+  int              reducedConverged;
+  int              nextNumConverged;
+  MPI_Request      numConvergedRequest;
+
 
   // Private member functions:
-  bool replicaExchange();                                    // Behave like a doMCMove; only propose a new energy and a new configuration
+  bool progressReplicaExchange();                            // Advance the exchange in flight; true if a new configuration was accepted
+  void startReplicaExchange();
   void assignSwapPartner();
-  void exchangeEnergy(ObservableType &energyForSwap);        // Swap energy with partner; energyForSwap will be overwritten
-  bool determineAcceptance(double localDOSRatio);
-  
-  //template <typename T>
-  //void exchangeConfiguration(T configForSwap[], int numElements);  
-  void exchangeConfiguration(void* ptrToConfig, int numElements, MPI_Datatype MPI_config_type);
-
-  void getMaxModFactor();
+  void mergeWindowDOS();                                     // collective flatness check and ln g average within a window
+  void packState(double lnDOSRatio);                         // Observables, (ln g ratio,) direction label and configuration into sendBuffer
+  double getLnDOSRatio(const std::vector<ObservableType>& newObservables);
+  void acceptPartnerState();                                 // Continue from the partner's observables and configuration
+  void exchangeWindowState();                                // Continue in the partner's window
+  void shareWindowSlot();                                    // at the end of every exchange round, for window exchanges
+  bool updateSlotOwners();                                   // false while the last round's slots are still being shared
+  void regroupWindowComm();
+  void checkObservableDrift();
+
+  void getMaxModFactor();                                    // of the previous block, and start the reduction for this one
+  void checkWindowRebalance();                               // rebalance the windows once all have done enough iterations
+  void rebalanceWindows();
+  void completeReplicaExchanges();                           // before the walker leaders meet in a blocking collective
+  void walkIntoWindow();                                     // after the window moved away from the walker's energy
+  void checkRankReassignment();                              // release the walkers of converged windows, one block behind
+  void reassignConvergedWalkers();
 
   void writeCheckPointFiles(OutputMode output_mode);
   void readREWLInputFile(const char* fileName); 
 
-};
-
-
-/*
-template <typename T>
-void ReplicaExchangeWangLandau::exchangeConfiguration(T configForSwap[], int numElements)
-{
+  // The MC steps between two periodic tasks, compiled for the type of the physical system
+  // (see PhysicalSystems/SystemDispatch.hpp) and selected in the constructor. Moves are decided
+  // on the energy alone (propose/commit protocol), except for joint histograms of several observables.
+  void (ReplicaExchangeWangLandau::*runMCSteps)(unsigned long int numSteps);
+  template <typename SystemType> void runMCStepsOf(unsigned long int numSteps);
+  template <typename SystemType> void runJointMCStepsOf(unsigned long int numSteps);
 
-  if (partnerID != -1)
-    REWLComm.swapVector(configForSwap, numElements, partnerID);
+};
 
-}
-*/
 
 
 #endif
@@ -0,0 +1,327 @@
+#include <cstdio>
+#include <cmath>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <string>             // std::string
+#include <sstream>            // std::istringstream
+#include <thread>
+#include "SharedDOSWangLandauSampling.hpp"
+#include "CheckpointWriter.hpp"
+#include "Utilities/RandomNumberGenerator.hpp"
+
+// Constructor
+template <typename EnergyType>
+SharedDOSWangLandauSampling<EnergyType>::SharedDOSWangLandauSampling(std::vector<PhysicalSystem*> ps) :
+  h(simInfo.restartFlag, simInfo.MCInputFile, simInfo.HistogramCheckpointFile), barrier(int(ps.size()))
+{
+
+  if (GlobalComm.thisMPIrank == 0)
+    printf("\nStarting Wang-Landau sampling, %d walkers sharing the DOS...\n", int(ps.size()));
+
+  numThreads = int(ps.size());
+  sharedDOSUpdateInterval = 1000;
+  readSharedDOSInputFile(simInfo.MCInputFile);
+
+  h.checkObservableIndices(ps[0] -> numObservables);
+
+  if (sharedDOSUpdateInterval == 0 || h.roundTripStatistics) {
+    std::cerr << "Error: with numberOfThreadsPerRank > 1, WL needs sharedDOSUpdateInterval > 0,\n"
+              << "       and roundTripStatistics is not supported. Quiting... \n";
+    exit(7);
+  }
+  if (simInfo.system == 1) {
+    std::cerr << "Error: this physical system cannot host several walkers per MPI rank. Quiting... \n";
+    exit(7);
+  }
+
+  rngSeed = (simInfo.rngSeed == -1) ? int(time(NULL)) : simInfo.rngSeed;
+
+  walkers.resize(size_t(numThreads));
+  for (int t=0; t<numThreads; t++) {
+    Walker& walker = walkers[size_t(t)];
+    walker.physical_system = ps[size_t(t)];
+    walker.pendingDOS.assign(h.getNumberOfBins(), h.histogramPageSize);
+    walker.pendingEntries.assign(h.getNumberOfBins(), h.histogramPageSize);
+    walker.acceptedMoves = 0;
+    walker.rejectedMoves = 0;
+  }
+
+  stepsSinceFlatnessCheck = 0;
+  binsRefined             = false;
+  simulationContinues     = (h.modFactor > h.modFactorFinal);
+
+}
+
+
+//Destructor
+template <typename EnergyType>
+SharedDOSWangLandauSampling<EnergyType>::~SharedDOSWangLandauSampling()
+{
+
+  for (size_t t=1; t<walkers.size(); t++)
+    delete walkers[t].physical_system;
+
+  if (GlobalComm.thisMPIrank == 0)
+    printf("Exiting SharedDOSWangLandauSampling class... \n");
+
+}
+
+/////////////////////////////
+// Public member functions //
+/////////////////////////////
+
+template <typename EnergyType>
+void SharedDOSWangLandauSampling<EnergyType>::run()
+{
+
+  currentTime = lastBackUpTime = MPI_Wtime();
+  double startTime = currentTime;
+  unsigned long int startMCsteps = h.totalMCsteps;
+
+  if (GlobalComm.thisMPIrank == 0) {
+    printf("   Finding initial configurations within energy range... ");
+    fflush(stdout);
+  }
+
+  std::vector<std::thread> threads;
+  for (int t=1; t<numThreads; t++)
+    threads.emplace_back(&SharedDOSWangLandauSampling<EnergyType>::runWalker, this, t);
+  runWalker(0);
+  for (auto& thread : threads)
+    thread.join();
+
+  if (GlobalComm.thisMPIrank == 0)
+    printf("   Performance: %lu MC steps in %.3f seconds (%.4e MC steps per second)\n",
+           h.totalMCsteps - startMCsteps, MPI_Wtime() - startTime,
+           double(h.totalMCsteps - startMCsteps) / (MPI_Wtime() - startTime));
+
+  // Write out data at the end of the simulation
+  checkpointWriter.flush();
+  h.writeNormDOSFile("dos.dat");
+  h.writeHistogramDOSFile("hist_dos_checkpoint.dat");
+  h.writeHistogramDOSTextFile("hist_dos_final.dat");
+
+}
+
+//////////////////////////////
+// Private member functions //
+//////////////////////////////
+
+
+// The WL procedure of WangLandauSampling::run() for one walker, with the updates of the
+// histogram and the flatness checks left to mergeWalkers()
+template <typename EnergyType>
+void SharedDOSWangLandauSampling<EnergyType>::runWalker(int thread)
+{
+
+  Walker& walker = walkers[size_t(thread)];
+  PhysicalSystem* physical_system = walker.physical_system;
+
+  seedThreadRandomNumberGenerator(rngSeed + thread);
+
+  // Find the first energy that falls within the WL energy range
+  int index = h.getSharedIndex(physical_system -> observables);
+  while (index < 0) {
+    physical_system -> doMCMove();
+    physical_system -> getObservables();
+    physical_system -> acceptMCMove();    // always accept the move to push the state forward
+    index = h.getSharedIndex(physical_system -> observables);
+  }
+
+  // Always accept the first energy if it is within range
+  addLocalEntry(walker, unsigned(index), h.getDOSAtIndex(unsigned(index)));
+
+  barrier.wait();
+  if (thread == 0) {
+    if (GlobalComm.thisMPIrank == 0) {
+      if (std::filesystem::exists("configurations"))
+        physical_system -> writeConfiguration(0, "configurations/config_initial.dat");
+      printf("done.\n");
+    }
+    if (simulationContinues)
+      startIteration();
+  }
+  barrier.wait();
+
+//-------------- End initialization --------------//
+
+  while (simulationContinues) {
+
+    for (unsigned int MCSteps=0; MCSteps<sharedDOSUpdateInterval; MCSteps++) {
+
+      physical_system -> doMCMove();
+      physical_system -> getObservables();
+
+      // WL acceptance from the shared DOS and this walker's own entries since the last merge
+      int    newIndex = h.getSharedIndex(physical_system -> observables);
+      double lnDOS    = getLocalDOS(walker, unsigned(index));
+
+      if (newIndex >= 0 && exp(lnDOS - getLocalDOS(walker, unsigned(newIndex))) > getRandomNumber2()) {
+        addLocalEntry(walker, unsigned(newIndex), lnDOS);
+        walker.acceptedMoves++;
+        physical_system -> acceptMCMove();
+        index = newIndex;
+      }
+      else {
+        physical_system -> rejectMCMove();
+        addLocalEntry(walker, unsigned(index), lnDOS);
+        walker.rejectedMoves++;
+      }
+
+    }
+
+    barrier.wait();
+    if (thread == 0) mergeWalkers();
+    barrier.wait();
+
+    clearPendingEntries(walker);
+    if (binsRefined)
+      index = h.getSharedIndex(physical_system -> observables);
+
+  }
+
+}
+
+
+// Thread 0 adds the entries of all walkers to the shared histogram, then does what
+// WangLandauSampling::run() does after every histogramCheckInterval MC steps
+template <typename EnergyType>
+void SharedDOSWangLandauSampling<EnergyType>::mergeWalkers()
+{
+
+  char fileName[51];
+
+  for (auto& walker : walkers) {
+    for (unsigned int index : walker.pendingBins)
+      h.addEntries(index, walker.pendingEntries[index]);
+    h.acceptedMoves += walker.acceptedMoves;
+    h.rejectedMoves += walker.rejectedMoves;
+    walker.acceptedMoves = 0;
+    walker.rejectedMoves = 0;
+  }
+
+  h.totalMCsteps          += (unsigned long int)(numThreads) * sharedDOSUpdateInterval;
+  stepsSinceFlatnessCheck += (unsigned long int)(numThreads) * sharedDOSUpdateInterval;
+  binsRefined = false;
+
+  // In the 1/t phase log(f) follows the MC time
+  if (h.oneOverTPhase)
+    h.modFactor = h.getOneOverT();
+
+  // Check histogram flatness; in the 1/t phase only log(f) decides when to stop
+  if (stepsSinceFlatnessCheck >= h.histogramCheckInterval) {
+    h.numberOfUpdatesPerIteration += (unsigned int)(stepsSinceFlatnessCheck);
+    stepsSinceFlatnessCheck = 0;
+
+    if (h.oneOverTPhase)
+      h.histogramFlat = (h.modFactor <= h.modFactorFinal);
+    else
+      h.histogramFlat = h.checkHistogramFlatness();
+  }
+
+  if (h.histogramFlat) {
+    if (GlobalComm.thisMPIrank == 0) {
+      printf("done.\n");
+
+      // Also write restart files here
+      sprintf(fileName, "hist_dos_iteration%02d.dat", h.iterations);
+      h.stageHistogramDOSFile(fileName);
+      checkpointWriter.writeConfiguration(walkers[0].physical_system, 1, "configurations/config_checkpoint.dat");
+    }
+
+    // Go to next iteration
+    h.reduceModFactor();
+    binsRefined = h.refineBins();
+    h.resetHistogram();
+    h.iterations++;
+
+    simulationContinues = (h.modFactor > h.modFactorFinal);
+    if (simulationContinues)
+      startIteration();
+  }
+
+  // Write restart files at interval
+  currentTime = MPI_Wtime();
+  if (GlobalComm.thisMPIrank == 0) {
+    if (currentTime - lastBackUpTime > checkPointInterval) {
+      h.stageHistogramDOSFile("hist_dos_checkpoint.dat");
+      checkpointWriter.writeConfiguration(walkers[0].physical_system, 1, "configurations/config_checkpoint.dat");
+      lastBackUpTime = currentTime;
+    }
+  }
+
+}
+
+
+template <typename EnergyType>
+void SharedDOSWangLandauSampling<EnergyType>::startIteration()
+{
+
+  h.histogramFlat = false;
+  h.numberOfUpdatesPerIteration = 0;
+
+  if (GlobalComm.thisMPIrank == 0) {
+    printf("   Running iteration %2d   (f = %12.8e) ... ", h.iterations, h.modFactor);
+    fflush(stdout);
+  }
+
+}
+
+
+// Refined bins have new indices, so the arrays start over in the new size
+template <typename EnergyType>
+void SharedDOSWangLandauSampling<EnergyType>::clearPendingEntries(Walker& walker)
+{
+
+  if (binsRefined) {
+    walker.pendingDOS.assign(h.getNumberOfBins(), h.histogramPageSize);
+    walker.pendingEntries.assign(h.getNumberOfBins(), h.histogramPageSize);
+  }
+  else {
+    for (unsigned int index : walker.pendingBins) {
+      walker.pendingDOS.ref(index)     = 0.0;
+      walker.pendingEntries.ref(index) = 0;
+    }
+  }
+  walker.pendingBins.clear();
+
+}
+
+
+template <typename EnergyType>
+void SharedDOSWangLandauSampling<EnergyType>::readSharedDOSInputFile(const char* fileName)
+{
+
+  std::ifstream inputFile(fileName);
+  std::string line, key;
+
+  if (inputFile.is_open()) {
+    while (std::getline(inputFile, line)) {
+
+      if (!line.empty()) {
+
+        std::istringstream lineStream(line);
+        lineStream >> key;
+
+        if (key.compare(0, 1, "#") != 0) {
+
+          if (key == "sharedDOSUpdateInterval") {
+            lineStream >> sharedDOSUpdateInterval;
+            continue;
+          }
+
+        }
+
+      }
+
+    }
+    inputFile.close();
+  }
+
+}
+
+
+// Explicit instantiations
+template class SharedDOSWangLandauSampling<ObservableType>;
+template class SharedDOSWangLandauSampling<IntegerObservableType>;
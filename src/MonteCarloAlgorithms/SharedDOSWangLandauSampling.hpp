@@ -0,0 +1,108 @@
+#ifndef SHARED_DOS_WANG_LANDAU_SAMPLING_HPP
+#define SHARED_DOS_WANG_LANDAU_SAMPLING_HPP
+
+#include <vector>
+#include "MCAlgorithms.hpp"
+#include "Histogram.hpp"
+#include "Utilities/PagedArray.hpp"
+#include "Utilities/ThreadBarrier.hpp"
+
+/*
+  SharedDOSWangLandauSampling class:
+
+  Wang-Landau sampling with several walkers on one energy range, one thread each
+  (input key numberOfThreadsPerRank = T > 1). All walkers update one histogram and DOS.
+  Every walker has its own physical system and random number generator.
+
+  The walkers do not write to the shared histogram while they move. Each keeps the
+  entries it made since the last merge in its own arrays, and judges its moves by the
+  shared ln g plus its own pending entries, so that a walker is pushed out of the bins
+  it has just visited as in serial WL. Every sharedDOSUpdateInterval MC steps the
+  threads meet at a barrier, and thread 0 merges the entries of all walkers into the
+  histogram, one bin at a time (Histogram::addEntries). Only thread 0 checks the
+  flatness of the histogram, reduces ln f and writes the output files, while the
+  other walkers wait.
+
+  The cost of a merge grows with the number of bins a walker visits in an interval,
+  not with the number of MC steps, so the walkers run in parallel nearly all the time.
+  Round-trip statistics are not supported, as they follow a single walk.
+*/
+
+// EnergyType: binning type of the histogram (see Histogram.hpp)
+template <typename EnergyType>
+class SharedDOSWangLandauSampling : public MonteCarloAlgorithm {
+
+public :
+
+  SharedDOSWangLandauSampling(std::vector<PhysicalSystem*> ps);
+  ~SharedDOSWangLandauSampling();
+
+  void run()  override;
+
+private :
+
+  // A walker and the entries it made since the last merge; only its own thread touches them
+  // while the walkers move, and only thread 0 between the two barriers of a merge
+  struct Walker {
+    PhysicalSystem*               physical_system;
+    PagedArray<double>            pendingDOS;          // ln g added to each bin of the shared DOS
+    PagedArray<unsigned long int> pendingEntries;      // histogram entries of each bin
+    std::vector<unsigned int>     pendingBins;         // bins with pendingEntries > 0
+    unsigned long int             acceptedMoves;
+    unsigned long int             rejectedMoves;
+  };
+
+  std::vector<Walker> walkers;                         // walker t runs on thread t; the caller owns walkers[0].physical_system
+  Histogram<EnergyType> h;                             // shared by all walkers
+
+  int          numThreads;
+  int          rngSeed;                                // walker t seeds its RNG with rngSeed + t
+  unsigned int sharedDOSUpdateInterval;                // MC steps of every walker between two merges
+
+  ThreadBarrier barrier;
+
+  // Written by thread 0 between the two barriers of a merge
+  unsigned long int stepsSinceFlatnessCheck;
+  bool              binsRefined;
+  bool              simulationContinues;
+
+
+  // Private member functions:
+  void runWalker(int thread);
+  double getLocalDOS(Walker& walker, unsigned int index);
+  void addLocalEntry(Walker& walker, unsigned int index, double lnDOSFrom);
+  void mergeWalkers();                                 // thread 0, while all walkers wait
+  void startIteration();
+  void clearPendingEntries(Walker& walker);
+
+  void readSharedDOSInputFile(const char* fileName);
+
+};
+
+
+// Inline member functions (called on every MC step)
+
+template <typename EnergyType>
+inline double SharedDOSWangLandauSampling<EnergyType>::getLocalDOS(Walker& walker, unsigned int index)
+{
+  return h.getDOSAtIndex(index) + walker.pendingDOS[index];
+}
+
+
+// The first entry of a bin that nobody has visited yet starts from the ln g of the bin the
+// walker came from, like Histogram::visitNewBin; the merge then does the real first visit.
+template <typename EnergyType>
+inline void SharedDOSWangLandauSampling<EnergyType>::addLocalEntry(Walker& walker, unsigned int index, double lnDOSFrom)
+{
+  if (walker.pendingEntries.ref(index)++ == 0) {
+    walker.pendingBins.push_back(index);
+    if (!h.binVisited(index)) {
+      if (h.getDOSAtIndex(index) == 0.0)
+        walker.pendingDOS.ref(index) = lnDOSFrom;
+      return;
+    }
+  }
+  walker.pendingDOS.ref(index) += h.modFactor;
+}
+
+#endif
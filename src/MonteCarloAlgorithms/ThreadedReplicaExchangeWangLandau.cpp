@@ -0,0 +1,630 @@
+#include <algorithm>
+#include <cstdio>
+#include <cmath>
+#include <ctime>
+#include <fstream>
+#include <limits>
+#include <string>             // std::string
+#include <sstream>            // std::istringstream
+#include <thread>
+#include <type_traits>
+#include "ThreadedReplicaExchangeWangLandau.hpp"
+#include "CheckpointWriter.hpp"
+#include "PhysicalSystems/SystemDispatch.hpp"
+#include "Utilities/RandomNumberGenerator.hpp"
+
+// Constructor
+template <typename EnergyType>
+ThreadedReplicaExchangeWangLandau<EnergyType>::ThreadedReplicaExchangeWangLandau(std::vector<PhysicalSystem*> ps, MPICommunicator MCAlgorithmComm) : barrier(int(ps.size()))
+{
+
+  std::cout << "Simulation method: Replica-Exchange Wang-Landau sampling, " << ps.size() << " walkers per MPI rank\n";
+
+  /// Pass MPI communicator from arguments; a walker never spans several ranks here
+  REWLComm = MCAlgorithmComm;
+
+  /// Set initial values for private members
+  numThreads = int(ps.size());
+  numWalkers = simInfo.numWalkers;
+  numWindows = simInfo.numberOfWindows;
+  numWalkersPerWindow = 1;
+  replicaExchangeInterval = 1;
+  observableDriftCheckInterval = 0;
+  replicaExchangeMode = 0;
+  windowRebalanceIterations = 0;
+  rankReassignment = 0;
+  readREWLInputFile(simInfo.MCInputFile);
+
+  if (numWalkersPerWindow != 1 || replicaExchangeMode != 0 || windowRebalanceIterations > 0 || rankReassignment) {
+    std::cerr << "Error: with numberOfThreadsPerRank > 1, REWL needs numberOfWalkersPerWindow 1 and replicaExchangeMode 0,\n"
+              << "       and windowRebalanceIterations and rankReassignment are not supported. Quiting... \n";
+    exit(7);
+  }
+  if (simInfo.system == 1 || ps[0] -> getPackedConfigurationSize() == 0) {
+    std::cerr << "Error: this physical system cannot host several walkers per MPI rank. Quiting... \n";
+    exit(7);
+  }
+
+  // Every walker draws its own random numbers, from a seed common to all ranks
+  rngSeed = (simInfo.rngSeed == -1) ? int(time(NULL)) : simInfo.rngSeed;
+  GlobalComm.broadcastScalar(rngSeed, 0);
+
+  // Walker w has window w and reads hist_dos_checkpoint_walker<w>.dat on restart
+  char fileName[51];
+  walkers.resize(size_t(numThreads));
+  for (int t=0; t<numThreads; t++) {
+    Walker& walker = walkers[size_t(t)];
+    walker.physical_system = ps[size_t(t)];
+    walker.walkerID        = REWLComm.thisMPIrank * numThreads + t;
+    sprintf(fileName, "hist_dos_checkpoint_walker%05d.dat", walker.walkerID);
+    walker.h = new Histogram<EnergyType>(simInfo.restartFlag, simInfo.MCInputFile, fileName, walker.walkerID);
+    walker.h -> checkObservableIndices(walker.physical_system -> numObservables);
+    walker.exchanged         = false;
+    walker.acceptedExchanges = 0;
+    walker.packedConfiguration.resize(walker.physical_system -> getPackedConfigurationSize());
+  }
+
+  // All walkers sample the same kind of system
+  runMCSteps = dispatchOnSystemType(ps[0], [&](auto* system) {
+    using SystemType = std::remove_pointer_t<decltype(system)>;
+    if (walkers[0].h -> getDimension() > 1)
+      return &ThreadedReplicaExchangeWangLandau::runJointMCStepsOf<SystemType>;
+    return &ThreadedReplicaExchangeWangLandau::runMCStepsOf<SystemType>;
+  });
+
+  // Messages to the neighboring ranks hold the observables, a random number, the direction label and the configuration
+  int doublesSize, intSize, configurationSize;
+  MPI_Pack_size(int(ps[0] -> numObservables) + 1, MPI_DOUBLE, REWLComm.communicator, &doublesSize);
+  MPI_Pack_size(1, MPI_INT, REWLComm.communicator, &intSize);
+  MPI_Pack_size(int(ps[0] -> getPackedConfigurationSize()), MPI_BYTE, REWLComm.communicator, &configurationSize);
+  exchangeBufferSize = doublesSize + intSize + configurationSize;
+  for (int side=0; side<2; side++) {
+    sendBuffer[side].resize(size_t(exchangeBufferSize));
+    recvBuffer[side].resize(size_t(exchangeBufferSize));
+  }
+
+  MaxModFactor  = std::numeric_limits<double>::max();
+  checkPointDue = false;
+
+  GlobalComm.barrier();
+
+}
+
+
+template <typename EnergyType>
+ThreadedReplicaExchangeWangLandau<EnergyType>::~ThreadedReplicaExchangeWangLandau()
+{
+
+  for (size_t t=0; t<walkers.size(); t++) {
+    delete walkers[t].h;
+    if (t > 0) delete walkers[t].physical_system;
+  }
+
+  if (GlobalComm.thisMPIrank == 0)
+    printf("Exiting ThreadedReplicaExchangeWangLandau class... \n");
+
+}
+
+/////////////////////////////
+// Public member functions //
+/////////////////////////////
+
+template <typename EnergyType>
+void ThreadedReplicaExchangeWangLandau<EnergyType>::run()
+{
+
+  currentTime = lastBackUpTime = MPI_Wtime();
+  if (GlobalComm.thisMPIrank == 0)
+    printf("Running ThreadedReplicaExchangeWangLandau...\n");
+
+  std::vector<std::thread> threads;
+  for (int t=1; t<numThreads; t++)
+    threads.emplace_back(&ThreadedReplicaExchangeWangLandau<EnergyType>::runWalker, this, t);
+  runWalker(0);
+  for (auto& thread : threads)
+    thread.join();
+
+  // Round trips through all windows by way of exchanges
+  if (walkers[0].h -> roundTripStatistics) {
+    unsigned long int myGlobalRoundTrips = 0;
+    unsigned long int totalGlobalRoundTrips = 0;
+    for (auto& walker : walkers)
+      myGlobalRoundTrips += walker.h -> numGlobalRoundTrips;
+    MPI_Reduce(&myGlobalRoundTrips, &totalGlobalRoundTrips, 1, MPI_UNSIGNED_LONG, MPI_SUM, 0, REWLComm.communicator);
+    if (REWLComm.thisMPIrank == 0)
+      printf("Total number of global round trips through all windows = %lu\n", totalGlobalRoundTrips);
+  }
+
+}
+
+//////////////////////////////
+// Private member functions //
+//////////////////////////////
+
+
+// The WL procedure of ReplicaExchangeWangLandau::run() for one walker
+template <typename EnergyType>
+void ThreadedReplicaExchangeWangLandau<EnergyType>::runWalker(int thread)
+{
+
+  char fileName[51];
+  Walker& walker = walkers[size_t(thread)];
+  PhysicalSystem* physical_system = walker.physical_system;
+  Histogram<EnergyType>& h = *(walker.h);
+  bool accept;
+
+  seedThreadRandomNumberGenerator(rngSeed + walker.walkerID);
+
+  // Find the first energy that falls within the WL energy range
+  accept = h.checkObservablesInRange(physical_system -> observables);
+  while (!accept) {
+    physical_system -> doMCMove();
+    physical_system -> getObservables();
+    physical_system -> acceptMCMove();    // always accept the move to push the state forward
+    accept = h.checkObservablesInRange(physical_system -> observables);
+  }
+
+  // Always accept the first energy if it is within range
+  h.updateHistogramDOS(physical_system -> observables);
+
+  // Write out the energy
+  sprintf(fileName, "config_initial_walker%05d.dat", walker.walkerID);
+  physical_system -> writeConfiguration(0, fileName);
+  printf("Walker %05d: Start energy = %6.3f\n", walker.walkerID, physical_system -> observables[0]);
+  fflush(stdout);
+
+//-------------- End initialization --------------//
+
+  int  exchangeRound       = 0;
+  bool simulationContinues = true;
+
+  // The walkers of all threads count the same steps, so they meet in every exchange;
+  // checkpoints are timed by thread 0 between flatness checks (reduceModFactor)
+  TaskScheduler walkerTasks;
+  int exchangeTask      = walkerTasks.addStepTask(replicaExchangeInterval);
+  int flatnessCheckTask = walkerTasks.addStepTask(h.histogramCheckInterval);
+  walkerTasks.start();
+
+  while (simulationContinues) {
+    h.histogramFlat = false;
+
+    bool flatnessCheckDue = false;
+    while (!flatnessCheckDue) {
+
+      // Run the MC steps up to the next periodic task
+      unsigned long int numSteps = walkerTasks.stepsToNextTask();
+      (this->*runMCSteps)(walker, numSteps);
+      walkerTasks.advance(numSteps);
+
+      //====== One Replica-exchange update ======//
+
+      if (walkerTasks.isDue(exchangeTask)) {
+        replicaExchange(thread, exchangeRound % 2);
+        exchangeRound++;
+      }
+
+      flatnessCheckDue = walkerTasks.isDue(flatnessCheckTask);
+
+    }
+
+    h.totalMCsteps += h.histogramCheckInterval;
+
+    // Check histogram flatness; in the 1/t phase log(f) follows the MC time instead
+    if (h.oneOverTPhase)
+      h.modFactor = h.getOneOverT();
+    else
+      h.histogramFlat = h.checkHistogramFlatness();
+
+    if (h.histogramFlat) {
+
+      writeCheckPointFiles(walker, endOfIteration);
+      printf("WalkerID: %05d, Number of iterations performed = %d\n", walker.walkerID, h.iterations);
+
+      // Prepare for the next iteration
+      h.reduceModFactor();
+      h.refineBins();
+      h.resetHistogram();
+      h.iterations++;
+
+    }
+
+    // Get the maximum ModFactor among all walkers
+    barrier.wait();
+    if (thread == 0) reduceModFactor();
+    barrier.wait();
+
+    if (MaxModFactor < h.modFactorFinal)
+      simulationContinues = false;
+    else if (checkPointDue)
+      writeCheckPointFiles(walker, checkPoint);
+
+  }
+
+  writeCheckPointFiles(walker, endOfSimulation);
+
+  if (h.roundTripStatistics) {
+    sprintf(fileName, "WalkerID: %05d, ", walker.walkerID);
+    h.printRoundTripStatistics(fileName);
+  }
+
+}
+
+
+template <typename EnergyType>
+template <typename SystemType>
+void ThreadedReplicaExchangeWangLandau<EnergyType>::runMCStepsOf(Walker& walker, unsigned long int numSteps)
+{
+
+  SystemType* system = static_cast<SystemType*>(walker.physical_system);
+  Histogram<EnergyType>& h = *(walker.h);
+  ObservableType energy = system -> observables[0];
+
+  for (unsigned long int MCSteps=0; MCSteps<numSteps; MCSteps++) {
+
+    //========== One MC move update ========== //
+
+    ObservableType trialEnergy = system -> proposeMCMove();
+
+    // check if the energy falls within the energy range, then determine WL acceptance
+    bool accept = h.checkEnergyInRange(trialEnergy) &&
+                  exp(h.getDOS(energy) - h.getDOS(trialEnergy)) > getRandomNumber2();
+
+    if (accept) {
+      system -> commitMCMove();
+      energy = trialEnergy;
+      h.acceptedMoves++;
+    }
+    else {
+      system -> discardMCMove();
+      h.rejectedMoves++;
+    }
+
+    // Update histogram and DOS with the energy after the move
+    h.updateHistogramDOS(energy);
+
+    //========== One MC move update ========== //
+  }
+
+}
+
+
+// All observables of the trial state are needed to place it in a joint histogram
+template <typename EnergyType>
+template <typename SystemType>
+void ThreadedReplicaExchangeWangLandau<EnergyType>::runJointMCStepsOf(Walker& walker, unsigned long int numSteps)
+{
+
+  SystemType* system = static_cast<SystemType*>(walker.physical_system);
+  Histogram<EnergyType>& h = *(walker.h);
+  bool accept;
+
+  for (unsigned long int MCSteps=0; MCSteps<numSteps; MCSteps++) {
+
+    //========== One MC move update ========== //
+
+    system -> doMCMove();
+    system -> getObservables();
+
+    // check if the energy falls within the energy range
+    if ( h.checkObservablesInRange(system -> observables) )
+      accept = exp(h.getDOS(system -> oldObservables) - h.getDOS(system -> observables)) > getRandomNumber2();
+    else
+      accept = false;
+
+    if (accept) {
+      h.updateHistogramDOS(system -> observables);
+      h.acceptedMoves++;
+      system -> acceptMCMove();
+    }
+    else {
+      system -> rejectMCMove();
+      h.updateHistogramDOS(system -> oldObservables);
+      h.rejectedMoves++;
+    }
+
+    //========== One MC move update ========== //
+  }
+
+}
+
+
+// A round of exchanges between windows w and w+1 with w % 2 == direction. Between the two
+// barriers a thread may touch the walkers of its exchange, as all of them are held still.
+template <typename EnergyType>
+void ThreadedReplicaExchangeWangLandau<EnergyType>::replicaExchange(int thread, int direction)
+{
+
+  Walker& walker = walkers[size_t(thread)];
+
+  barrier.wait();
+
+  if (walker.walkerID % 2 == direction && thread + 1 < numThreads)
+    exchangeWithinRank(walker, walkers[size_t(thread + 1)]);
+  if (thread == 0)
+    exchangeAcrossRanks(direction);
+
+  barrier.wait();
+
+  if (walker.exchanged) {
+    walker.h -> updateHistogramDOS(walker.physical_system -> observables);
+    walker.h -> acceptedMoves++;
+    walker.physical_system -> acceptMCMove();
+    walker.exchanged = false;
+  }
+
+}
+
+
+template <typename EnergyType>
+void ThreadedReplicaExchangeWangLandau<EnergyType>::exchangeWithinRank(Walker& lower, Walker& upper)
+{
+
+  double lnAcceptProb = getLnDOSRatio(lower, upper.physical_system -> observables) +
+                        getLnDOSRatio(upper, lower.physical_system -> observables);
+
+  if ( !(lnAcceptProb > -std::numeric_limits<double>::infinity()) || getRandomNumber2() >= exp(lnAcceptProb) )
+    return;
+
+  lower.physical_system -> packConfiguration(lower.packedConfiguration.data());
+  upper.physical_system -> packConfiguration(upper.packedConfiguration.data());
+  lower.physical_system -> unpackConfiguration(upper.packedConfiguration.data());
+  upper.physical_system -> unpackConfiguration(lower.packedConfiguration.data());
+
+  // The observables and the direction label of global round trips travel with the configuration
+  std::swap(lower.physical_system -> observables, upper.physical_system -> observables);
+  if (lower.h -> roundTripStatistics)
+    std::swap(lower.h -> globalDirection, upper.h -> globalDirection);
+
+  for (Walker* walker : {&lower, &upper}) {
+    walker -> exchanged = true;
+    walker -> acceptedExchanges++;
+    if (observableDriftCheckInterval > 0 && walker -> acceptedExchanges % observableDriftCheckInterval == 0)
+      checkObservableDrift(*walker);
+  }
+
+}
+
+
+// Thread 0 exchanges the first walker of this rank with the last one of the rank below
+// (side 0) and the last walker with the first one of the rank above (side 1). Each side sends
+// its state, then its ln g ratio; the decision needs the ratios of both windows.
+template <typename EnergyType>
+void ThreadedReplicaExchangeWangLandau<EnergyType>::exchangeAcrossRanks(int direction)
+{
+
+  int         numRequests {0};
+  MPI_Request requests[4];
+  bool        active[2];
+  Walker*     walker[2]      = {&walkers.front(), &walkers.back()};
+  int         partner[2]     = {REWLComm.thisMPIrank - 1, REWLComm.thisMPIrank + 1};
+  int         lowerWindow[2] = {walker[0] -> walkerID - 1, walker[1] -> walkerID};
+
+  std::vector<ObservableType> partnerObservables[2];
+  double myRandomNumber[2]         {};
+  double partnerRandomNumber[2]    {};
+  int    partnerGlobalDirection[2] {};
+  int    position[2]               {};
+  double myLnDOSRatio[2]           {};
+  double partnerLnDOSRatio[2]      {};
+
+  for (int side=0; side<2; side++) {
+    active[side] = (lowerWindow[side] >= 0 && lowerWindow[side] + 1 < numWindows && lowerWindow[side] % 2 == direction);
+    if (!active[side]) continue;
+
+    // The lower walker draws the random number of the decision
+    PhysicalSystem* physical_system = walker[side] -> physical_system;
+    if (side == 1) myRandomNumber[side] = getRandomNumber2();
+    physical_system -> packConfiguration(walker[side] -> packedConfiguration.data());
+    MPI_Pack(physical_system -> observables.data(), int(physical_system -> observables.size()), MPI_DOUBLE, sendBuffer[side].data(), exchangeBufferSize, &position[side], REWLComm.communicator);
+    MPI_Pack(&myRandomNumber[side], 1, MPI_DOUBLE, sendBuffer[side].data(), exchangeBufferSize, &position[side], REWLComm.communicator);
+    MPI_Pack(&(walker[side] -> h -> globalDirection), 1, MPI_INT, sendBuffer[side].data(), exchangeBufferSize, &position[side], REWLComm.communicator);
+    MPI_Pack(walker[side] -> packedConfiguration.data(), int(walker[side] -> packedConfiguration.size()), MPI_BYTE, sendBuffer[side].data(), exchangeBufferSize, &position[side], REWLComm.communicator);
+
+    MPI_Irecv(recvBuffer[side].data(), exchangeBufferSize, MPI_PACKED, partner[side], 21, REWLComm.communicator, &requests[numRequests++]);
+    MPI_Isend(sendBuffer[side].data(), exchangeBufferSize, MPI_PACKED, partner[side], 21, REWLComm.communicator, &requests[numRequests++]);
+  }
+  if (numRequests == 0) return;
+  MPI_Waitall(numRequests, requests, MPI_STATUSES_IGNORE);
+
+  numRequests = 0;
+  for (int side=0; side<2; side++) {
+    if (!active[side]) continue;
+
+    partnerObservables[side].resize(walker[side] -> physical_system -> observables.size());
+    position[side] = 0;
+    MPI_Unpack(recvBuffer[side].data(), exchangeBufferSize, &position[side], partnerObservables[side].data(), int(partnerObservables[side].size()), MPI_DOUBLE, REWLComm.communicator);
+    MPI_Unpack(recvBuffer[side].data(), exchangeBufferSize, &position[side], &partnerRandomNumber[side], 1, MPI_DOUBLE, REWLComm.communicator);
+    MPI_Unpack(recvBuffer[side].data(), exchangeBufferSize, &position[side], &partnerGlobalDirection[side], 1, MPI_INT, REWLComm.communicator);
+
+    myLnDOSRatio[side] = getLnDOSRatio(*walker[side], partnerObservables[side]);
+    MPI_Irecv(&partnerLnDOSRatio[side], 1, MPI_DOUBLE, partner[side], 22, REWLComm.communicator, &requests[numRequests++]);
+    MPI_Isend(&myLnDOSRatio[side], 1, MPI_DOUBLE, partner[side], 22, REWLComm.communicator, &requests[numRequests++]);
+  }
+  MPI_Waitall(numRequests, requests, MPI_STATUSES_IGNORE);
+
+  for (int side=0; side<2; side++) {
+    if (!active[side]) continue;
+
+    // Both sides add the ratios in the same order (lower window first) and compare with the
+    // lower walker's random number, so that they reach the same decision bit for bit
+    double lnAcceptProb, randomNumber;
+    if (side == 1) {
+      lnAcceptProb = myLnDOSRatio[side] + partnerLnDOSRatio[side];
+      randomNumber = myRandomNumber[side];
+    }
+    else {
+      lnAcceptProb = partnerLnDOSRatio[side] + myLnDOSRatio[side];
+      randomNumber = partnerRandomNumber[side];
+    }
+    if ( !(lnAcceptProb > -std::numeric_limits<double>::infinity()) || randomNumber >= exp(lnAcceptProb) )
+      continue;
+
+    Walker& w = *walker[side];
+    MPI_Unpack(recvBuffer[side].data(), exchangeBufferSize, &position[side], w.packedConfiguration.data(), int(w.packedConfiguration.size()), MPI_BYTE, REWLComm.communicator);
+    w.physical_system -> unpackConfiguration(w.packedConfiguration.data());
+    w.physical_system -> observables = partnerObservables[side];
+    if (w.h -> roundTripStatistics)
+      w.h -> globalDirection = partnerGlobalDirection[side];
+
+    w.exchanged = true;
+    w.acceptedExchanges++;
+    if (observableDriftCheckInterval > 0 && w.acceptedExchanges % observableDriftCheckInterval == 0)
+      checkObservableDrift(w);
+  }
+
+}
+
+
+// ln [g(E_walker) / g(E_new)] from the walker's DOS, or -infinity if E_new is outside its window
+template <typename EnergyType>
+double ThreadedReplicaExchangeWangLandau<EnergyType>::getLnDOSRatio(Walker& walker, const std::vector<ObservableType>& newObservables)
+{
+
+  if ( walker.h -> checkObservablesInRange(newObservables) )
+    return walker.h -> getDOS(walker.physical_system -> observables) - walker.h -> getDOS(newObservables);
+  else
+    return -std::numeric_limits<double>::infinity();
+
+}
+
+
+// Compare the observables with a calculation from scratch, and continue with the latter
+template <typename EnergyType>
+void ThreadedReplicaExchangeWangLandau<EnergyType>::checkObservableDrift(Walker& walker)
+{
+
+  PhysicalSystem* physical_system = walker.physical_system;
+  std::vector<ObservableType> fromScratch;
+  if (!physical_system -> calculateObservablesFromScratch(fromScratch)) return;
+
+  for (size_t i=0; i<fromScratch.size(); i++) {
+    double tolerance = 1.0e-8 * std::max(1.0, fabs(fromScratch[i]));
+    if (fabs(physical_system -> observables[i] - fromScratch[i]) > tolerance) {
+      printf("WalkerID: %05d, Warning: observable %zu drifted to %15.8e, recomputed %15.8e\n",
+             walker.walkerID, i, physical_system -> observables[i], fromScratch[i]);
+      physical_system -> observables[i] = fromScratch[i];
+    }
+  }
+
+}
+
+
+// Called by thread 0 while the other threads wait at the barrier. All walkers finish a block
+// at the same time, so the reduction needs no overlap with the MC steps as in REWL.
+template <typename EnergyType>
+void ThreadedReplicaExchangeWangLandau<EnergyType>::reduceModFactor()
+{
+
+  double myMaxModFactor = 0.0;
+  for (auto& walker : walkers)
+    myMaxModFactor = std::max(myMaxModFactor, walker.h -> modFactor);
+  MPI_Allreduce(&myMaxModFactor, &MaxModFactor, 1, MPI_DOUBLE, MPI_MAX, REWLComm.communicator);
+
+  // Write restart files at interval
+  currentTime   = MPI_Wtime();
+  checkPointDue = (currentTime - lastBackUpTime > checkPointInterval);
+  if (checkPointDue)
+    lastBackUpTime = currentTime;
+
+}
+
+
+template <typename EnergyType>
+void ThreadedReplicaExchangeWangLandau<EnergyType>::writeCheckPointFiles(Walker& walker, OutputMode output_mode)
+{
+
+  char fileName[51];
+
+  switch (output_mode) {
+
+    case endOfIteration :
+      sprintf(fileName, "config_checkpoint_walker%05d.dat", walker.walkerID);
+      checkpointWriter.writeConfiguration(walker.physical_system, 1, fileName);
+      sprintf(fileName, "hist_dos_iteration%02d_walker%05d.dat", walker.h -> iterations, walker.walkerID);
+      break;
+
+    case endOfSimulation :
+      sprintf(fileName, "dos_walker%05d.dat", walker.walkerID);
+      walker.h -> stageNormDOSFile(fileName);
+      sprintf(fileName, "hist_dos_final_walker%05d.dat", walker.walkerID);
+      break;
+
+    case checkPoint :
+      sprintf(fileName, "config_checkpoint_walker%05d.dat", walker.walkerID);
+      checkpointWriter.writeConfiguration(walker.physical_system, 1, fileName);
+      sprintf(fileName, "hist_dos_checkpoint_walker%05d.dat", walker.walkerID);
+      break;
+
+  }
+
+  // Final results are kept human-readable for export
+  if (output_mode == endOfSimulation)
+    walker.h -> stageHistogramDOSTextFile(fileName);
+  else
+    walker.h -> stageHistogramDOSFile(fileName);
+
+}
+
+
+template <typename EnergyType>
+void ThreadedReplicaExchangeWangLandau<EnergyType>::readREWLInputFile(const char* fileName)
+{
+
+  std::cout << "Reading REWL input file: " << fileName << "\n";
+
+  std::ifstream inputFile(fileName);
+  std::string line, key;
+
+  if (inputFile.is_open()) {
+    while (std::getline(inputFile, line)) {
+
+      if (!line.empty()) {
+
+        std::istringstream lineStream(line);
+        lineStream >> key;
+
+        if (key.compare(0, 1, "#") != 0) {
+
+          if (key == "numberOfWindows") {
+            lineStream >> numWindows;
+            continue;
+          }
+          if (key == "numberOfWalkersPerWindow") {
+            lineStream >> numWalkersPerWindow;
+            continue;
+          }
+          if (key == "replicaExchangeInterval") {
+            lineStream >> replicaExchangeInterval;
+            continue;
+          }
+          if (key == "replicaExchangeMode") {
+            lineStream >> replicaExchangeMode;
+            continue;
+          }
+          if (key == "observableDriftCheckInterval") {
+            lineStream >> observableDriftCheckInterval;
+            continue;
+          }
+          if (key == "windowRebalanceIterations") {
+            lineStream >> windowRebalanceIterations;
+            continue;
+          }
+          if (key == "rankReassignment") {
+            lineStream >> rankReassignment;
+            continue;
+          }
+
+        }
+
+      }
+
+    }
+    inputFile.close();
+  }
+
+}
+
+
+// Explicit instantiations
+template class ThreadedReplicaExchangeWangLandau<ObservableType>;
+template class ThreadedReplicaExchangeWangLandau<IntegerObservableType>;
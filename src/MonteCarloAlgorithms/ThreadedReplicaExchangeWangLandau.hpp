@@ -0,0 +1,106 @@
+#ifndef THREADED_REPLICA_EXCHANGE_WANG_LANDAU_HPP
+#define THREADED_REPLICA_EXCHANGE_WANG_LANDAU_HPP
+
+#include <vector>
+#include "MCAlgorithms.hpp"
+#include "Histogram.hpp"
+#include "Main/Communications.hpp"
+#include "Utilities/ThreadBarrier.hpp"
+
+/*
+  ThreadedReplicaExchangeWangLandau class:
+
+  REWL with several walkers per MPI rank (input key numberOfThreadsPerRank = T > 1).
+  Rank r hosts the walkers r*T ... r*T+T-1 on T threads; thread 0 is the main thread.
+  Every walker has its own physical system, histogram and random number generator.
+  There is one walker per energy window, so walker w samples window w.
+
+  The walkers move in lockstep: every replicaExchangeInterval MC steps all threads
+  of a rank meet at a barrier for a round of exchanges between neighboring windows
+  (0-1, 2-3, ... and 1-2, 3-4, ... in turn, as in ReplicaExchangeWangLandau).
+    - Both walkers on this rank: the thread of the lower walker decides the exchange
+      and swaps the two configurations in memory.
+    - Walkers on neighboring ranks: thread 0 exchanges observables and configurations
+      with the neighbor by MPI (MPI_THREAD_FUNNELED). Each side sends the ln g ratio
+      from its own window and the lower side a random number, so both sides arrive
+      at the same decision without a third message.
+  Only configuration exchanges are supported, and windows are neither rebalanced
+  nor given the walkers of converged windows.
+
+  Output files are named by walker as in ReplicaExchangeWangLandau, so that
+  PostProcessDOS and restarts work the same.
+*/
+
+// EnergyType: binning type of the histogram (see Histogram.hpp)
+template <typename EnergyType>
+class ThreadedReplicaExchangeWangLandau : public MonteCarloAlgorithm {
+
+public :
+
+  ThreadedReplicaExchangeWangLandau(std::vector<PhysicalSystem*> ps, MPICommunicator MCAlgorithmComm);
+  ~ThreadedReplicaExchangeWangLandau();
+
+  void run()  override;
+
+private :
+
+  // A walker and what only its thread touches between exchange rounds
+  struct Walker {
+    PhysicalSystem*        physical_system;
+    Histogram<EnergyType>* h;
+    int                    walkerID;                   // = its energy window
+    bool                   exchanged;                  // took over a configuration in this exchange round
+    unsigned long int      acceptedExchanges;
+    std::vector<uint8_t>   packedConfiguration;        // serialized configuration (PhysicalSystem::packConfiguration)
+  };
+
+  std::vector<Walker> walkers;                         // walker t runs on thread t; the caller owns walkers[0].physical_system
+
+  MPICommunicator REWLComm;                            // one rank per process
+  int numThreads;
+  int numWalkers;
+  int numWindows;
+  int numWalkersPerWindow;
+  int rngSeed;                                         // walker w seeds its RNG with rngSeed + w
+
+  unsigned int      replicaExchangeInterval;
+  int               replicaExchangeMode;               // only configurations (0) are supported
+  unsigned long int observableDriftCheckInterval;      // accepted exchanges between checks of the shipped observables; 0: never
+  int               windowRebalanceIterations;         // not supported
+  int               rankReassignment;                  // not supported
+
+  ThreadBarrier barrier;
+
+  // Exchanges with the walkers of the neighboring ranks: [0] below, [1] above
+  int               exchangeBufferSize;
+  std::vector<char> sendBuffer[2];
+  std::vector<char> recvBuffer[2];
+
+  // Written by thread 0 between two barriers at the end of every block of MC steps
+  double MaxModFactor;
+  bool   checkPointDue;
+
+
+  // Private member functions:
+  void runWalker(int thread);
+  void replicaExchange(int thread, int direction);
+  void exchangeWithinRank(Walker& lower, Walker& upper);
+  void exchangeAcrossRanks(int direction);
+  double getLnDOSRatio(Walker& walker, const std::vector<ObservableType>& newObservables);
+  void checkObservableDrift(Walker& walker);
+  void reduceModFactor();                              // thread 0: MaxModFactor over all walkers
+
+  void writeCheckPointFiles(Walker& walker, OutputMode output_mode);
+  void readREWLInputFile(const char* fileName);
+
+  // The MC steps of one walker between two exchange rounds, compiled for the type of the physical
+  // system as in ReplicaExchangeWangLandau (see PhysicalSystems/SystemDispatch.hpp)
+  void (ThreadedReplicaExchangeWangLandau::*runMCSteps)(Walker& walker, unsigned long int numSteps);
+  template <typename SystemType> void runMCStepsOf(Walker& walker, unsigned long int numSteps);
+  template <typename SystemType> void runJointMCStepsOf(Walker& walker, unsigned long int numSteps);
+
+};
+
+
+
+#endif
@@ -1,25 +1,38 @@
 #include <cstdio>
 #include <cmath>
 #include <filesystem>
+#include <type_traits>
 #include "WangLandauSampling.hpp"
+#include "CheckpointWriter.hpp"
+#include "PhysicalSystems/SystemDispatch.hpp"
 #include "Utilities/RandomNumberGenerator.hpp"
 //#include "Communications.hpp"
 
 
 // Constructor
-WangLandauSampling::WangLandauSampling(PhysicalSystem* ps) : h(simInfo.restartFlag, simInfo.MCInputFile, simInfo.HistogramCheckpointFile)
+template <typename EnergyType>
+WangLandauSampling<EnergyType>::WangLandauSampling(PhysicalSystem* ps) : h(simInfo.restartFlag, simInfo.MCInputFile, simInfo.HistogramCheckpointFile)
 {
 
   if (GlobalComm.thisMPIrank == 0)
     printf("\nStarting Wang-Landau sampling...\n");
 
   physical_system = ps;
+  h.checkObservableIndices(physical_system -> numObservables);
+
+  runMCSteps = dispatchOnSystemType(physical_system, [&](auto* system) {
+    using SystemType = std::remove_pointer_t<decltype(system)>;
+    if (h.getDimension() > 1)
+      return &WangLandauSampling::runJointMCStepsOf<SystemType>;
+    return &WangLandauSampling::runMCStepsOf<SystemType>;
+  });
 
 }
 
 
 //Destructor
-WangLandauSampling::~WangLandauSampling()
+template <typename EnergyType>
+WangLandauSampling<EnergyType>::~WangLandauSampling()
 {
 
   if (GlobalComm.thisMPIrank == 0)
@@ -28,12 +41,16 @@ WangLandauSampling::~WangLandauSampling()
 }
 
 
-void WangLandauSampling::run()
+template <typename EnergyType>
+void WangLandauSampling<EnergyType>::run()
 {
 
   char fileName[51];
 
   currentTime = lastBackUpTime = MPI_Wtime();
+  double startTime = currentTime;
+  unsigned long int startMCsteps = h.totalMCsteps;
+
   if (GlobalComm.thisMPIrank == 0)
     printf("   Finding initial configuration within energy range... ");
 
@@ -42,11 +59,11 @@ void WangLandauSampling::run()
     physical_system -> doMCMove();
     physical_system -> getObservables();
     physical_system -> acceptMCMove();    // always accept the move to push the state forward
-    acceptMove = h.checkEnergyInRange(physical_system -> observables[0]);
+    acceptMove = h.checkObservablesInRange(physical_system -> observables);
   }
 
   // Always accept the first energy if it is within range
-  h.updateHistogramDOS(physical_system -> observables[0]);
+  h.updateHistogramDOS(physical_system -> observables);
 
   // Write out the energy
   if (GlobalComm.thisMPIrank == 0 && std::filesystem::exists("configurations")) {
@@ -56,6 +73,10 @@ void WangLandauSampling::run()
 
 //-------------- End initialization --------------//
 
+  int checkPointTask    = scheduler.addTimeTask(checkPointInterval);
+  int flatnessCheckTask = scheduler.addStepTask(h.histogramCheckInterval);
+  scheduler.start();
+
 // WL procedure starts here
   while (h.modFactor > h.modFactorFinal) {
     h.histogramFlat = false;
@@ -67,66 +88,29 @@ void WangLandauSampling::run()
 
     h.numberOfUpdatesPerIteration = 0;
     while (!(h.histogramFlat)) {
-      for (unsigned int MCSteps=0; MCSteps<h.histogramCheckInterval; MCSteps++) {
-
-        physical_system -> doMCMove();
-        physical_system -> getObservables();
-
-        // check if the energy falls within the energy range
-        if ( !h.checkEnergyInRange(physical_system -> observables[0]) )
-          acceptMove = false;
-        else {
-          // determine WL acceptance
-          if ( exp(h.getDOS(physical_system -> oldObservables[0]) - 
-                   h.getDOS(physical_system -> observables[0])) > getRandomNumber2() )
-            acceptMove = true;
-          else
-            acceptMove = false;
-        }
-
-        if (acceptMove) {
-           // Update histogram and DOS with trialEnergy
-           h.updateHistogramDOS(physical_system -> observables[0]);
-           h.acceptedMoves++;        
- 
-           physical_system -> acceptMCMove();
-/*
-           if (GlobalComm.thisMPIrank == 0) {
-             physical_system -> writeConfiguration(0, "energyLatticePos.dat");
-             std::cerr << "trial move accepted: Energy = " << physical_system -> observables[0] << "\n";
-           }
-*/
-        }
-        else {
-/*
-           if (GlobalComm.thisMPIrank == 0) {
-             std::cerr << "trial move rejected: Energy = " << physical_system -> observables[0] << "\n";
-             std::cerr << "Update with energy = " << physical_system -> oldObservables[0] << "\n";
-           }
-*/
-           physical_system -> rejectMCMove();
-
-           // Update histogram and DOS with oldEnergy
-           h.updateHistogramDOS(physical_system -> oldObservables[0]);
-           h.rejectedMoves++;
-        }
-        h.totalMCsteps++;
-     
-        // Write restart files at interval
-        currentTime = MPI_Wtime();
-        if (GlobalComm.thisMPIrank == 0) {
-          if (currentTime - lastBackUpTime > checkPointInterval) {
-            h.writeHistogramDOSFile("hist_dos_checkpoint.dat");
-            physical_system -> writeConfiguration(1, "configurations/config_checkpoint.dat");
-            lastBackUpTime = currentTime;
-          }
-        }
+
+      // Run the MC steps up to the next periodic task
+      unsigned long int numSteps = scheduler.stepsToNextTask();
+      (this ->* runMCSteps)(numSteps);
+
+      if (!scheduler.advance(numSteps)) continue;
+
+      // Write restart files at interval
+      if (scheduler.isDue(checkPointTask) && GlobalComm.thisMPIrank == 0) {
+        h.stageHistogramDOSFile("hist_dos_checkpoint.dat");
+        checkpointWriter.writeConfiguration(physical_system, 1, "configurations/config_checkpoint.dat");
       }
+
+      if (!scheduler.isDue(flatnessCheckTask)) continue;
+
       //h.writeHistogramDOSFile("hist_dos_checkpoint.dat");
       h.numberOfUpdatesPerIteration += h.histogramCheckInterval;
 
-      // Check histogram flatness
-      h.histogramFlat = h.checkHistogramFlatness();
+      // Check histogram flatness; in the 1/t phase only log(f) decides when to stop
+      if (h.oneOverTPhase)
+        h.histogramFlat = (h.modFactor <= h.modFactorFinal);
+      else
+        h.histogramFlat = h.checkHistogramFlatness();
       
       //if (h.numHistogramNotImproved >= h.histogramRefreshInterval)
       //  h.refreshHistogram();
@@ -139,20 +123,132 @@ void WangLandauSampling::run()
 
       // Also write restart files here 
       sprintf(fileName, "hist_dos_iteration%02d.dat", h.iterations);
-      h.writeHistogramDOSFile(fileName);
-      physical_system -> writeConfiguration(1, "configurations/config_checkpoint.dat");
+      h.stageHistogramDOSFile(fileName);
+      checkpointWriter.writeConfiguration(physical_system, 1, "configurations/config_checkpoint.dat");
     }
 
     // Go to next iteration
-    h.modFactor /= h.modFactorReducer;
+    h.reduceModFactor();
+    h.refineBins();
     h.resetHistogram();
     h.iterations++;
   }
 
+  if (GlobalComm.thisMPIrank == 0)
+    printf("   Performance: %lu MC steps in %.3f seconds (%.4e MC steps per second)\n",
+           h.totalMCsteps - startMCsteps, MPI_Wtime() - startTime,
+           double(h.totalMCsteps - startMCsteps) / (MPI_Wtime() - startTime));
+  if (GlobalComm.thisMPIrank == 0)
+    h.printRoundTripStatistics("   ");
+
   // Write out data at the end of the simulation
+  checkpointWriter.flush();
   h.writeNormDOSFile("dos.dat");
   h.writeHistogramDOSFile("hist_dos_checkpoint.dat");
-  h.writeHistogramDOSFile("hist_dos_final.dat");
+  h.writeHistogramDOSTextFile("hist_dos_final.dat");
 
 }
 
+
+template <typename EnergyType>
+template <typename SystemType>
+void WangLandauSampling<EnergyType>::runMCStepsOf(unsigned long int numSteps)
+{
+
+  SystemType* system = static_cast<SystemType*>(physical_system);
+  ObservableType energy = system -> observables[0];
+
+  for (unsigned long int MCSteps=0; MCSteps<numSteps; MCSteps++) {
+
+    ObservableType trialEnergy = system -> proposeMCMove();
+
+    // check if the energy falls within the energy range, then determine WL acceptance
+    acceptMove = h.checkEnergyInRange(trialEnergy) &&
+                 exp(h.getDOS(energy) - h.getDOS(trialEnergy)) > getRandomNumber2();
+
+    if (acceptMove) {
+      system -> commitMCMove();
+      energy = trialEnergy;
+      h.acceptedMoves++;
+    }
+    else {
+      system -> discardMCMove();
+      h.rejectedMoves++;
+    }
+
+    // Update histogram and DOS with the energy after the move
+    h.updateHistogramDOS(energy);
+    h.totalMCsteps++;
+
+    // In the 1/t phase log(f) follows the MC time
+    if (h.oneOverTPhase)
+      h.modFactor = h.getOneOverT();
+  }
+
+}
+
+
+// All observables of the trial state are needed to place it in a joint histogram
+template <typename EnergyType>
+template <typename SystemType>
+void WangLandauSampling<EnergyType>::runJointMCStepsOf(unsigned long int numSteps)
+{
+
+  SystemType* system = static_cast<SystemType*>(physical_system);
+
+  for (unsigned long int MCSteps=0; MCSteps<numSteps; MCSteps++) {
+
+    system -> doMCMove();
+    system -> getObservables();
+
+    // check if the energy falls within the energy range
+    if ( !h.checkObservablesInRange(system -> observables) )
+      acceptMove = false;
+    else {
+      // determine WL acceptance
+      if ( exp(h.getDOS(system -> oldObservables) - 
+               h.getDOS(system -> observables)) > getRandomNumber2() )
+        acceptMove = true;
+      else
+        acceptMove = false;
+    }
+
+    if (acceptMove) {
+       // Update histogram and DOS with trialEnergy
+       h.updateHistogramDOS(system -> observables);
+       h.acceptedMoves++;        
+ 
+       system -> acceptMCMove();
+/*
+       if (GlobalComm.thisMPIrank == 0) {
+         system -> writeConfiguration(0, "energyLatticePos.dat");
+         std::cerr << "trial move accepted: Energy = " << system -> observables[0] << "\n";
+       }
+*/
+    }
+    else {
+/*
+       if (GlobalComm.thisMPIrank == 0) {
+         std::cerr << "trial move rejected: Energy = " << system -> observables[0] << "\n";
+         std::cerr << "Update with energy = " << system -> oldObservables[0] << "\n";
+       }
+*/
+       system -> rejectMCMove();
+
+       // Update histogram and DOS with oldEnergy
+       h.updateHistogramDOS(system -> oldObservables);
+       h.rejectedMoves++;
+    }
+    h.totalMCsteps++;
+
+    // In the 1/t phase log(f) follows the MC time
+    if (h.oneOverTPhase)
+      h.modFactor = h.getOneOverT();
+  }
+
+}
+
+
+// Explicit instantiations
+template class WangLandauSampling<ObservableType>;
+template class WangLandauSampling<IntegerObservableType>;
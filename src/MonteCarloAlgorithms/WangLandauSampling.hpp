@@ -4,6 +4,8 @@
 #include "MCAlgorithms.hpp"
 #include "Histogram.hpp"
 
+// EnergyType: binning type of the histogram (see Histogram.hpp)
+template <typename EnergyType>
 class WangLandauSampling : public MonteCarloAlgorithm {
 
 public :
@@ -16,7 +18,14 @@ public :
 private :
 
   PhysicalSystem* physical_system;
-  Histogram h;
+  Histogram<EnergyType> h;
+
+  // The MC steps between two periodic tasks, compiled for the type of the physical system
+  // (see PhysicalSystems/SystemDispatch.hpp) and selected in the constructor. Moves are decided
+  // on the energy alone (propose/commit protocol), except for joint histograms of several observables.
+  void (WangLandauSampling::*runMCSteps)(unsigned long int numSteps);
+  template <typename SystemType> void runMCStepsOf(unsigned long int numSteps);
+  template <typename SystemType> void runJointMCStepsOf(unsigned long int numSteps);
   
 };
 
@@ -6,6 +6,7 @@
 #include <filesystem>
 #include <fstream>
 #include "Alloy3D.hpp"
+#include "Utilities/BitPacking.hpp"
 #include "Utilities/CheckFile.hpp"
 #include "Utilities/CompareNumbers.hpp"
 #include "Utilities/RandomNumberGenerator.hpp"
@@ -42,6 +43,12 @@ Alloy3D::Alloy3D(const char* inputFile, int initial) : lattice(inputFile)
 
   initializeObservables(observableName.size());
 
+  // Energies are integers as long as the pair interactions are
+  hasIntegerEnergy = true;
+  for (unsigned int i=0; i<numberOfElements; i++)
+    for (unsigned int j=0; j<numberOfElements; j++)
+      if (interactions(i,j) != std::round(interactions(i,j))) hasIntegerEnergy = false;
+
   // Initialize configuration from file if applicable
   if (std::filesystem::exists("config_initial.dat"))
     readAtomConfigFile("config_initial.dat");
@@ -52,6 +59,7 @@ Alloy3D::Alloy3D(const char* inputFile, int initial) : lattice(inputFile)
 
   firstTimeGetMeasures = true;
   getObservablesFromScratch();
+  oldObservables = observables;     // restored if the first move is rejected
 
   writeConfiguration(0, "configurations/config_initial.dat");
 
@@ -172,7 +180,7 @@ void Alloy3D::writeConfiguration(int format, const char* filename)
 {
 
   FILE* configFile;
-  if (filename != NULL) configFile = fopen(filename, "w");
+  if (filename != NULL) configFile = openConfigurationFile(filename, "w");
   else configFile = stdout;
 
   switch (format) {
@@ -238,6 +246,18 @@ void Alloy3D::getObservables()
 }
 
 
+bool Alloy3D::calculateObservablesFromScratch(std::vector<ObservableType>& result)
+{
+
+  // Only the energy is updated move by move; the pair observables are measured
+  // on demand through getAdditionalObservables() and are passed through as they are
+  result = observables;
+  result[0] = getExchangeInteractions();
+  return true;
+
+}
+
+
 void Alloy3D::getAdditionalObservables()
 {
   
@@ -293,11 +313,29 @@ void Alloy3D::rejectMCMove()
 }
 
 
-/*
-void Alloy3D::buildMPIConfigurationType()
+size_t Alloy3D::getPackedConfigurationSize()
+{
+
+  static_assert(Og < 256, "atomic numbers must fit in 8 bits");
+  return size_t(systemSize);
+
+}
+
+
+void Alloy3D::packConfiguration(void* buffer)
 {
+
+  packBytes(atom.data(), systemSize, static_cast<uint8_t*>(buffer));
+
+}
+
+
+void Alloy3D::unpackConfiguration(const void* buffer)
+{
+
+  unpackBytes(static_cast<const uint8_t*>(buffer), systemSize, atom.data());
+
 }
-*/
 
 
 // OK
@@ -16,7 +16,7 @@
 //};
 
 
-class Alloy3D : public PhysicalSystem {
+class Alloy3D final : public PhysicalSystem {
 
 public :
 
@@ -30,10 +30,15 @@ public :
   void rejectMCMove()                                   override;
 
   void getAdditionalObservables()                       override;
+  bool calculateObservablesFromScratch(std::vector<ObservableType>& result) override;
 
-  //void buildMPIConfigurationType()                      override;
   //void readHamiltonianTerms(const char* inputFile);
 
+  // 8 bits per atom (the atomic number) for replica exchanges
+  size_t getPackedConfigurationSize()                   override;
+  void   packConfiguration(void* buffer)                override;
+  void   unpackConfiguration(const void* buffer)        override;
+
   Lattice lattice;
 
 private :
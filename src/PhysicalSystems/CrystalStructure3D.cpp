@@ -2,6 +2,7 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cmath>
 #include <filesystem>
 #include <fstream>
@@ -50,6 +51,7 @@ CrystalStructure3D::CrystalStructure3D(const char* inputFile, int initial) : lat
 
   firstTimeGetMeasures = true;
   getObservablesFromScratch();
+  oldObservables = observables;     // restored if the first move is rejected
 
   writeConfiguration(0, "configurations/config_initial.dat");
 
@@ -72,7 +74,7 @@ void CrystalStructure3D::writeConfiguration(int format, const char* filename)
 {
 
   FILE* configFile;
-  if (filename != NULL) configFile = fopen(filename, "w");
+  if (filename != NULL) configFile = openConfigurationFile(filename, "w");
   else configFile = stdout;
 
   switch (format) {
@@ -187,11 +189,29 @@ void CrystalStructure3D::rejectMCMove()
     observables[i] = oldObservables[i];
 }
 
-/*
-void CrystalStructure3D::buildMPIConfigurationType()
+// localWindingNumber is recomputed in getAdditionalObservables() and need not travel
+size_t CrystalStructure3D::getPackedConfigurationSize()
 {
+
+  return size_t(systemSize) * sizeof(SpinDirection);
+
+}
+
+
+void CrystalStructure3D::packConfiguration(void* buffer)
+{
+
+  memcpy(buffer, spin.data(), size_t(systemSize) * sizeof(SpinDirection));
+
+}
+
+
+void CrystalStructure3D::unpackConfiguration(const void* buffer)
+{
+
+  memcpy(spin.data(), buffer, size_t(systemSize) * sizeof(SpinDirection));
+
 }
-*/
 
 
 void CrystalStructure3D::readHamiltonianInfo(const std::filesystem::path& hamiltonianInputFile)
@@ -23,7 +23,7 @@ struct NeighboringAtom {
 };
 
 
-class CrystalStructure3D : public PhysicalSystem {
+class CrystalStructure3D final : public PhysicalSystem {
 
 public :
 
@@ -38,7 +38,10 @@ public :
 
   void getAdditionalObservables()                       override;
 
-  //void buildMPIConfigurationType()                      override;
+  // 3 doubles per spin for replica exchanges
+  size_t getPackedConfigurationSize()                   override;
+  void   packConfiguration(void* buffer)                override;
+  void   unpackConfiguration(const void* buffer)        override;
 
   //void readHamiltonianTerms(const char* inputFile);
 
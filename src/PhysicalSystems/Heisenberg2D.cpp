@@ -1,6 +1,7 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cmath>
 #include <fstream>
 #include <sstream>
@@ -36,6 +37,7 @@ Heisenberg2D::Heisenberg2D(const char* spinConfigFile, int initial)
 
   firstTimeGetMeasures = true;
   getObservables();
+  oldObservables = observables;     // restored if the first move is rejected
 
 }
 
@@ -59,7 +61,7 @@ void Heisenberg2D::writeConfiguration(int format, const char* filename)
 {
 
   FILE* f;
-  if (filename != NULL) f = fopen(filename, "w");
+  if (filename != NULL) f = openConfigurationFile(filename, "w");
   else f = stdout;
 
   switch (format) {
@@ -101,7 +103,7 @@ void Heisenberg2D::getObservables()
     //printf("First time getObservables. \n");
   }
   else {
-    observables[0] += getDifferenceInExchangeInteractions() + getDifferenceInExternalFieldEnergy();
+    observables[0] += getDifferenceInExchangeInteractions(CurType, spin[CurX][CurY]) + getDifferenceInExternalFieldEnergy();
     observables[1] += spin[CurX][CurY].x - CurType.x;
     observables[2] += spin[CurX][CurY].y - CurType.y;
     observables[3] += spin[CurX][CurY].z - CurType.z;
@@ -113,6 +115,17 @@ void Heisenberg2D::getObservables()
 }
 
 
+bool Heisenberg2D::calculateObservablesFromScratch(std::vector<ObservableType>& result)
+{
+
+  result.resize(numObservables);
+  result[0] = getExchangeInteractions() + getExternalFieldEnergy();
+  std::tie(result[1], result[2], result[3], result[4]) = getMagnetization();
+  return true;
+
+}
+
+
 ObservableType Heisenberg2D::getExchangeInteractions()
 {
 
@@ -165,7 +178,7 @@ std::tuple<ObservableType, ObservableType, ObservableType, ObservableType> Heise
 }
 
 
-ObservableType Heisenberg2D::getDifferenceInExchangeInteractions()
+ObservableType Heisenberg2D::getDifferenceInExchangeInteractions(const SpinDirection& oldSpin, const SpinDirection& newSpin)
 {
 
   unsigned int xLeft, yBelow;
@@ -178,11 +191,11 @@ ObservableType Heisenberg2D::getDifferenceInExchangeInteractions()
   if (CurY != (Size-1) ) yAbove = CurY + 1; else yAbove = 0;
 
   energyChange = (spin[xLeft][CurY].x + spin[xRight][CurY].x + spin[CurX][yBelow].x + spin[CurX][yAbove].x) * 
-                 (spin[CurX][CurY].x - CurType.x) +
+                 (newSpin.x - oldSpin.x) +
                  (spin[xLeft][CurY].y + spin[xRight][CurY].y + spin[CurX][yBelow].y + spin[CurX][yAbove].y) * 
-                 (spin[CurX][CurY].y - CurType.y) +
+                 (newSpin.y - oldSpin.y) +
                  (spin[xLeft][CurY].z + spin[xRight][CurY].z + spin[CurX][yBelow].z + spin[CurX][yAbove].z) * 
-                 (spin[CurX][CurY].z - CurType.z) ;
+                 (newSpin.z - oldSpin.z) ;
 
   return -energyChange;           // ferromagnetic (FO) coupling
 
@@ -198,8 +211,6 @@ ObservableType Heisenberg2D::getDifferenceInExternalFieldEnergy()
 void Heisenberg2D::doMCMove()
 {
 
-  double r1, r2, rr;
-
   // Need this here since resetObservables() is not called if firstTimeGetMeasures = false
   //for (int i = 0; i < numObservables; i++)
   //  oldObservables[i] = observables[i];
@@ -209,15 +220,7 @@ void Heisenberg2D::doMCMove()
 
   CurType = spin[CurX][CurY];
 
-  do {
-    r1 = 2.0 * getRandomNumber();
-    r2 = 2.0 * getRandomNumber();
-    rr = r1 * r1 + r2 * r2;
-  } while (rr > 1.0);
-
-  spin[CurX][CurY].x = 2.0 * r1 * sqrt(1.0 - rr);
-  spin[CurX][CurY].y = 2.0 * r2 * sqrt(1.0 - rr);
-  spin[CurX][CurY].z = 1.0 - 2.0 * rr;
+  spin[CurX][CurY] = getRandomSpinDirection();
 
   //writeConfiguration(0);
 
@@ -247,11 +250,93 @@ void Heisenberg2D::rejectMCMove()
     observables[i] = oldObservables[i];
 }
 
-/*
-void Heisenberg2D::buildMPIConfigurationType()
+
+// The spin at the chosen site is only replaced if the move is committed
+ObservableType Heisenberg2D::proposeMCMove()
 {
+
+  CurX = unsigned(getIntRandomNumber()) % Size;
+  CurY = unsigned(getIntRandomNumber()) % Size;
+
+  CurType = spin[CurX][CurY];
+  TrialType = getRandomSpinDirection();
+
+  trialEnergy = observables[0] + (getDifferenceInExchangeInteractions(CurType, TrialType) + getDifferenceInExternalFieldEnergy());
+  return trialEnergy;
+
+}
+
+
+void Heisenberg2D::commitMCMove()
+{
+
+  spin[CurX][CurY] = TrialType;
+
+  observables[0]  = trialEnergy;
+  observables[1] += TrialType.x - CurType.x;
+  observables[2] += TrialType.y - CurType.y;
+  observables[3] += TrialType.z - CurType.z;
+  observables[4] = sqrt(observables[1] * observables[1] + observables[2] * observables[2] + observables[3] * observables[3]);
+
+  for (unsigned int i=0; i < numObservables; i++)
+    oldObservables[i] = observables[i];
+
+}
+
+
+void Heisenberg2D::discardMCMove()
+{
+}
+
+
+// A random direction on the unit sphere
+Heisenberg2D::SpinDirection Heisenberg2D::getRandomSpinDirection()
+{
+
+  double r1, r2, rr;
+  SpinDirection direction;
+
+  do {
+    r1 = 2.0 * getRandomNumber();
+    r2 = 2.0 * getRandomNumber();
+    rr = r1 * r1 + r2 * r2;
+  } while (rr > 1.0);
+
+  direction.x = 2.0 * r1 * sqrt(1.0 - rr);
+  direction.y = 2.0 * r2 * sqrt(1.0 - rr);
+  direction.z = 1.0 - 2.0 * rr;
+
+  return direction;
+
+}
+
+size_t Heisenberg2D::getPackedConfigurationSize()
+{
+
+  return size_t(systemSize) * sizeof(SpinDirection);
+
+}
+
+
+// The rows of spin are allocated separately
+void Heisenberg2D::packConfiguration(void* buffer)
+{
+
+  char* position = static_cast<char*>(buffer);
+  for (unsigned int i = 0; i < Size; i++, position += Size * sizeof(SpinDirection))
+    memcpy(position, spin[i], Size * sizeof(SpinDirection));
+
+}
+
+
+void Heisenberg2D::unpackConfiguration(const void* buffer)
+{
+
+  const char* position = static_cast<const char*>(buffer);
+  for (unsigned int i = 0; i < Size; i++, position += Size * sizeof(SpinDirection))
+    memcpy(spin[i], position, Size * sizeof(SpinDirection));
+
 }
-*/
 
 
 void Heisenberg2D::readSpinConfigFile(const std::filesystem::path& spinConfigFile)
@@ -1,6 +1,7 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cmath>
 #include <fstream>
 #include <sstream>
@@ -42,6 +43,7 @@ Heisenberg3D::Heisenberg3D(const char* spinConfigFile, int initial)
 
   firstTimeGetMeasures = true;
   getObservables();
+  oldObservables = observables;     // restored if the first move is rejected
 
 }
 
@@ -68,7 +70,7 @@ void Heisenberg3D::writeConfiguration(int format, const char* filename)
 {
 
   FILE* f;
-  if (filename != NULL) f = fopen(filename, "w");
+  if (filename != NULL) f = openConfigurationFile(filename, "w");
   else f = stdout;
 
   switch (format) {
@@ -113,7 +115,7 @@ void Heisenberg3D::getObservables()
     //printf("First time getObservables. \n");
   }
   else {
-    observables[0] += getDifferenceInExchangeInteractions() + getDifferenceInExternalFieldEnergy();
+    observables[0] += getDifferenceInExchangeInteractions(CurType, spin[CurX][CurY][CurZ]) + getDifferenceInExternalFieldEnergy();
     observables[1] += spin[CurX][CurY][CurZ].x - CurType.x;
     observables[2] += spin[CurX][CurY][CurZ].y - CurType.y;
     observables[3] += spin[CurX][CurY][CurZ].z - CurType.z;
@@ -126,6 +128,18 @@ void Heisenberg3D::getObservables()
 }
 
 
+bool Heisenberg3D::calculateObservablesFromScratch(std::vector<ObservableType>& result)
+{
+
+  result.resize(numObservables);
+  result[0] = getExchangeInteractions() + getExternalFieldEnergy();
+  std::tie(result[1], result[2], result[3], result[4]) = getMagnetization();
+  result[5] = pow(result[4], 4.0);
+  return true;
+
+}
+
+
 ObservableType Heisenberg3D::getExchangeInteractions()
 {
   
@@ -183,7 +197,7 @@ std::tuple<ObservableType, ObservableType, ObservableType, ObservableType> Heise
 }
 
 
-ObservableType Heisenberg3D::getDifferenceInExchangeInteractions()
+ObservableType Heisenberg3D::getDifferenceInExchangeInteractions(const SpinDirection& oldSpin, const SpinDirection& newSpin)
 {
 
   unsigned int xLeft, yBelow, zBackward;
@@ -200,15 +214,15 @@ ObservableType Heisenberg3D::getDifferenceInExchangeInteractions()
   energyChange = (spin[xLeft][CurY][CurZ].x + spin[xRight][CurY][CurZ].x + 
                   spin[CurX][yBelow][CurZ].x + spin[CurX][yAbove][CurZ].x + 
                   spin[CurX][CurY][zBackward].x + spin[CurX][CurY][zForward].x) * 
-                  (spin[CurX][CurY][CurZ].x - CurType.x) +
+                  (newSpin.x - oldSpin.x) +
                  (spin[xLeft][CurY][CurZ].y + spin[xRight][CurY][CurZ].y + 
                   spin[CurX][yBelow][CurZ].y + spin[CurX][yAbove][CurZ].y + 
                   spin[CurX][CurY][zBackward].y + spin[CurX][CurY][zForward].y) * 
-                  (spin[CurX][CurY][CurZ].y - CurType.y) +
+                  (newSpin.y - oldSpin.y) +
                  (spin[xLeft][CurY][CurZ].z + spin[xRight][CurY][CurZ].z + 
                   spin[CurX][yBelow][CurZ].z + spin[CurX][yAbove][CurZ].z + 
                   spin[CurX][CurY][zBackward].z + spin[CurX][CurY][zForward].z) * 
-                  (spin[CurX][CurY][CurZ].z - CurType.z) ;
+                  (newSpin.z - oldSpin.z) ;
 
   return -energyChange;           // ferromagnetic (FO) coupling
 
@@ -224,8 +238,6 @@ ObservableType Heisenberg3D::getDifferenceInExternalFieldEnergy()
 void Heisenberg3D::doMCMove()
 {
 
-  double r1, r2, rr;
-
   // Need this here since resetObservables() is not called if firstTimeGetMeasures = false
   //for (int i = 0; i < numObservables; i++)
   //  oldObservables[i] = observables[i];
@@ -236,15 +248,7 @@ void Heisenberg3D::doMCMove()
 
   CurType = spin[CurX][CurY][CurZ];
 
-  do {
-    r1 = 2.0 * getRandomNumber();
-    r2 = 2.0 * getRandomNumber();
-    rr = r1 * r1 + r2 * r2;
-  } while (rr > 1.0);
-
-  spin[CurX][CurY][CurZ].x = 2.0 * r1 * sqrt(1.0 - rr);
-  spin[CurX][CurY][CurZ].y = 2.0 * r2 * sqrt(1.0 - rr);
-  spin[CurX][CurY][CurZ].z = 1.0 - 2.0 * rr;
+  spin[CurX][CurY][CurZ] = getRandomSpinDirection();
 
   //writeConfiguration(0);
 
@@ -275,11 +279,100 @@ void Heisenberg3D::rejectMCMove()
 }
 
 
-/*
-void Heisenberg3D::buildMPIConfigurationType()
+// The spin at the chosen site is only replaced if the move is committed
+ObservableType Heisenberg3D::proposeMCMove()
 {
+
+  CurX = unsigned(getIntRandomNumber()) % Size;
+  CurY = unsigned(getIntRandomNumber()) % Size;
+  CurZ = unsigned(getIntRandomNumber()) % Size;
+
+  CurType = spin[CurX][CurY][CurZ];
+  TrialType = getRandomSpinDirection();
+
+  trialEnergy = observables[0] + (getDifferenceInExchangeInteractions(CurType, TrialType) + getDifferenceInExternalFieldEnergy());
+  return trialEnergy;
+
+}
+
+
+void Heisenberg3D::commitMCMove()
+{
+
+  spin[CurX][CurY][CurZ] = TrialType;
+
+  observables[0]  = trialEnergy;
+  observables[1] += TrialType.x - CurType.x;
+  observables[2] += TrialType.y - CurType.y;
+  observables[3] += TrialType.z - CurType.z;
+  ObservableType temp = observables[1] * observables[1] + observables[2] * observables[2] + observables[3] * observables[3];
+  observables[4] = sqrt(temp);
+  observables[5] = temp * temp;
+
+  for (unsigned int i=0; i < numObservables; i++)
+    oldObservables[i] = observables[i];
+
+}
+
+
+void Heisenberg3D::discardMCMove()
+{
+}
+
+
+// A random direction on the unit sphere
+Heisenberg3D::SpinDirection Heisenberg3D::getRandomSpinDirection()
+{
+
+  double r1, r2, rr;
+  SpinDirection direction;
+
+  do {
+    r1 = 2.0 * getRandomNumber();
+    r2 = 2.0 * getRandomNumber();
+    rr = r1 * r1 + r2 * r2;
+  } while (rr > 1.0);
+
+  direction.x = 2.0 * r1 * sqrt(1.0 - rr);
+  direction.y = 2.0 * r2 * sqrt(1.0 - rr);
+  direction.z = 1.0 - 2.0 * rr;
+
+  return direction;
+
+}
+
+
+size_t Heisenberg3D::getPackedConfigurationSize()
+{
+
+  return size_t(systemSize) * sizeof(SpinDirection);
+
+}
+
+
+// The rows of spin are allocated separately
+void Heisenberg3D::packConfiguration(void* buffer)
+{
+
+  char* position = static_cast<char*>(buffer);
+  for (unsigned int i = 0; i < Size; i++) {
+    for (unsigned int j = 0; j < Size; j++, position += Size * sizeof(SpinDirection))
+      memcpy(position, spin[i][j], Size * sizeof(SpinDirection));
+  }
+
+}
+
+
+void Heisenberg3D::unpackConfiguration(const void* buffer)
+{
+
+  const char* position = static_cast<const char*>(buffer);
+  for (unsigned int i = 0; i < Size; i++) {
+    for (unsigned int j = 0; j < Size; j++, position += Size * sizeof(SpinDirection))
+      memcpy(spin[i][j], position, Size * sizeof(SpinDirection));
+  }
+
 }
-*/
 
 
 void Heisenberg3D::readSpinConfigFile(const std::filesystem::path& spinConfigFile)
@@ -5,7 +5,7 @@
 #include "PhysicalSystemBase.hpp"
 #include "Main/Globals.hpp"
 
-class Heisenberg3D : public PhysicalSystem {
+class Heisenberg3D final : public PhysicalSystem {
 
 public :
 
@@ -19,7 +19,16 @@ public :
   void acceptMCMove()                                   override;
   void rejectMCMove()                                   override;
 
-  //void buildMPIConfigurationType()                      override;
+  ObservableType proposeMCMove()                        override;
+  void commitMCMove()                                   override;
+  void discardMCMove()                                  override;
+
+  bool calculateObservablesFromScratch(std::vector<ObservableType>& result) override;
+
+  // 3 doubles per spin for replica exchanges
+  size_t getPackedConfigurationSize()                   override;
+  void   packConfiguration(void* buffer)                override;
+  void   unpackConfiguration(const void* buffer)        override;
 
 private :
 
@@ -35,6 +44,10 @@ private :
   unsigned int CurX, CurY, CurZ;
   SpinDirection CurType;
 
+  // Proposed move (propose/commit protocol)
+  SpinDirection  TrialType;
+  ObservableType trialEnergy;
+
   // New configuration
   SpinDirection*** spin;          // 3D array because it is a 3D model
   //double spinLength;
@@ -45,8 +58,9 @@ private :
   ObservableType                                                             getExchangeInteractions();
   ObservableType                                                             getExternalFieldEnergy();
   std::tuple<ObservableType, ObservableType, ObservableType, ObservableType> getMagnetization();
-  ObservableType                                                             getDifferenceInExchangeInteractions();
+  ObservableType                                                             getDifferenceInExchangeInteractions(const SpinDirection& oldSpin, const SpinDirection& newSpin);
   ObservableType                                                             getDifferenceInExternalFieldEnergy();
+  SpinDirection                                                              getRandomSpinDirection();
 
   void readSpinConfigFile(const std::filesystem::path& spinConfigFile);
   void initializeSpinConfiguration(int initial);
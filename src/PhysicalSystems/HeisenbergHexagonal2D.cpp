@@ -1,6 +1,7 @@
 #include <cassert>
 #include <cstdlib>
 #include <cstdio>
+#include <cstring>
 #include <cmath>
 #include <fstream>
 #include <sstream>
@@ -38,6 +39,7 @@ HeisenbergHexagonal2D::HeisenbergHexagonal2D(const char* spinConfigFile, int ini
 
   firstTimeGetMeasures = true;
   getObservables();
+  oldObservables = observables;     // restored if the first move is rejected
 
 }
 
@@ -113,7 +115,7 @@ void HeisenbergHexagonal2D::writeConfiguration(int format, const char* filename)
 {
 
   FILE* f;
-  if (filename != NULL) f = fopen(filename, "w");
+  if (filename != NULL) f = openConfigurationFile(filename, "w");
   else f = stdout;
 
   switch (format) {
@@ -166,6 +168,17 @@ void HeisenbergHexagonal2D::getObservables()
 
 }
 
+
+bool HeisenbergHexagonal2D::calculateObservablesFromScratch(std::vector<ObservableType>& result)
+{
+
+  result.resize(numObservables);
+  result[0] = getExchangeInteractions() + getExternalFieldEnergy() + getAnisotropyEnergy();
+  std::tie(result[1], result[2], result[3], result[4]) = getMagnetization();
+  return true;
+
+}
+
 ObservableType HeisenbergHexagonal2D::getShell_1_ExchangeInteractions()
 {
   
@@ -921,7 +934,7 @@ ObservableType HeisenbergHexagonal2D::getDifferenceInExternalFieldEnergy()
                  (spin[CurX][CurY].y - CurType.y) * externalField[1] +
                  (spin[CurX][CurY].z - CurType.z) * externalField[2];
   
-  return energyChange;
+  return -energyChange;           // same sign as getExternalFieldEnergy()
 }
 
 ObservableType HeisenbergHexagonal2D::getDifferenceInAnisotropyEnergy()
@@ -985,11 +998,33 @@ void HeisenbergHexagonal2D::rejectMCMove()
     observables[i] = oldObservables[i];
 }
 
-/*
-void HeisenbergHexagonal2D::buildMPIConfigurationType()
+size_t HeisenbergHexagonal2D::getPackedConfigurationSize()
 {
+
+  return size_t(systemSize) * sizeof(SpinDirection);
+
+}
+
+
+// The rows of spin are allocated separately
+void HeisenbergHexagonal2D::packConfiguration(void* buffer)
+{
+
+  char* position = static_cast<char*>(buffer);
+  for (unsigned int i = 0; i < Size; i++, position += Size * sizeof(SpinDirection))
+    memcpy(position, spin[i], Size * sizeof(SpinDirection));
+
+}
+
+
+void HeisenbergHexagonal2D::unpackConfiguration(const void* buffer)
+{
+
+  const char* position = static_cast<const char*>(buffer);
+  for (unsigned int i = 0; i < Size; i++, position += Size * sizeof(SpinDirection))
+    memcpy(spin[i], position, Size * sizeof(SpinDirection));
+
 }
-*/
 
 
 void HeisenbergHexagonal2D::readSpinConfigFile(const std::filesystem::path& spinConfigFile)
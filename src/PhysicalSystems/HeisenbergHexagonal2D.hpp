@@ -5,7 +5,7 @@
 #include "PhysicalSystemBase.hpp"
 #include "Main/Globals.hpp"
 
-class HeisenbergHexagonal2D : public PhysicalSystem {
+class HeisenbergHexagonal2D final : public PhysicalSystem {
 
 public :
 
@@ -19,7 +19,12 @@ public :
   void acceptMCMove()                                   override;
   void rejectMCMove()                                   override;
 
-  //void buildMPIConfigurationType()                      override;
+  bool calculateObservablesFromScratch(std::vector<ObservableType>& result) override;
+
+  // 3 doubles per spin for replica exchanges
+  size_t getPackedConfigurationSize()                   override;
+  void   packConfiguration(void* buffer)                override;
+  void   unpackConfiguration(const void* buffer)        override;
 
 private :
 
@@ -5,6 +5,7 @@
 #include <fstream>
 #include <sstream>
 #include "Ising2D.hpp"
+#include "Utilities/BitPacking.hpp"
 #include "Utilities/RandomNumberGenerator.hpp"
 
 
@@ -30,13 +31,11 @@ Ising2D::Ising2D(const char* spinConfigFile, int initial)
   observableName.push_back("Total magnetization, M");                     // observables[1] : total magnetization
   observableName.push_back("Total absolute magnetization, |M|");          // observables[2] : total absolute magnetization
   initializeObservables(observableName.size());
+  hasIntegerEnergy = true;
 
   getObservablesFromScratch = true;
   getObservables();
 
-  buildMPIConfigurationType();
-  pointerToConfiguration = static_cast<void*>(&spin[0]);
- 
 }
 
 
@@ -46,10 +45,6 @@ Ising2D::~Ising2D()
 
   delete[] spin;
 
-  // Free MPI datatype
-  pointerToConfiguration = NULL;
-  MPI_Type_free(&MPI_ConfigurationType);
-
   if (GlobalComm.thisMPIrank == 0)
     printf("\nIsing2D finished\n");
 
@@ -66,7 +61,7 @@ void Ising2D::writeConfiguration(int format, const char* filename)
 
     case 2 : {     // Write everything in one file, one line for each configuration
 
-      if (filename != NULL) f = fopen(filename, "a");
+      if (filename != NULL) f = openConfigurationFile(filename, "a");
       else f = stdout;
 
       // Write the configuration
@@ -89,7 +84,7 @@ void Ising2D::writeConfiguration(int format, const char* filename)
 
     default : {
 
-      if (filename != NULL) f = fopen(filename, "w");
+      if (filename != NULL) f = openConfigurationFile(filename, "w");
       else f = stdout;
 
       fprintf(f, "# 2D Ising Model : %u x %u\n\n", Size, Size);
@@ -119,67 +114,23 @@ void Ising2D::writeConfiguration(int format, const char* filename)
 }
 
 
-void Ising2D::getObservables()
+bool Ising2D::calculateObservablesFromScratch(std::vector<ObservableType>& result)
 {
 
   unsigned int xLeft, yBelow;
-  unsigned int xRight, yAbove;
-
-  if (getObservablesFromScratch) {
 
-    resetObservables();
-  
-    for (unsigned int x = 0; x < Size; x++) {
-      if (x != 0) xLeft = x - 1; else xLeft = Size - 1;
-      for (unsigned int y = 0; y < Size; y++) {
-        if (y != 0) yBelow = y - 1; else yBelow = Size - 1;
-        observables[0] += ObservableType(spin[x*Size+y] * (spin[xLeft*Size+y] + spin[x*Size+yBelow]));
-        observables[1] += ObservableType(spin[x*Size+y]);
-      }
+  result.assign(numObservables, 0.0);
+  for (unsigned int x = 0; x < Size; x++) {
+    if (x != 0) xLeft = x - 1; else xLeft = Size - 1;
+    for (unsigned int y = 0; y < Size; y++) {
+      if (y != 0) yBelow = y - 1; else yBelow = Size - 1;
+      result[0] += ObservableType(spin[x*Size+y] * (spin[xLeft*Size+y] + spin[x*Size+yBelow]));
+      result[1] += ObservableType(spin[x*Size+y]);
     }
-    observables[0] = -observables[0];             // -ve sign for ferromagnetic interaction
-    observables[2] = abs(observables[1]);
-    getObservablesFromScratch = false;
-    //printf("Calculated observables from scratch. \n");
-  }
-  else {
-    if (CurX != 0) xLeft = CurX - 1; else xLeft = Size - 1;
-    if (CurY != 0) yBelow = CurY - 1; else yBelow = Size - 1;
-    if (CurX != (Size-1) ) xRight = CurX + 1; else xRight = 0;
-    if (CurY != (Size-1) ) yAbove = CurY + 1; else yAbove = 0;
-
-    int sumNeighbor = spin[xLeft*Size+CurY] + spin[xRight*Size+CurY] + spin[CurX*Size+yBelow] + spin[CurX*Size+yAbove];
-    int energyChange = sumNeighbor * CurType * 2;
-
-    observables[0] += energyChange;
-    observables[1] += spin[CurX*Size+CurY] - CurType;
-    observables[2]  = abs(observables[1]);
-    //printf("observables = %10.5f %10.5f %10.5f\n", observables[0], observables[1], observables[2]);
-
   }
-
-}
-
-
-void Ising2D::doMCMove()
-{
-
-  // Need this here since resetObservables() is not called if getObservablesFromScratch = false
-  for (unsigned int i = 0; i < numObservables; i++)
-    oldObservables[i] = observables[i];
-
-  // randomly choose a site
-  CurX = unsigned(getIntRandomNumber()) % Size;
-  CurY = unsigned(getIntRandomNumber()) % Size;
-  CurType = spin[CurX*Size + CurY];
-
-  // flip the spin at that site
-  if (CurType == -1)
-    spin[CurX*Size+CurY] = 1;
-  else
-    spin[CurX*Size+CurY] = -1;
-    
-  //writeConfiguration(0);
+  result[0] = -result[0];                         // -ve sign for ferromagnetic interaction
+  result[2] = abs(result[1]);
+  return true;
 
 }
 
@@ -192,31 +143,27 @@ void Ising2D::undoMCMove()
 }
 */
 
-void Ising2D::acceptMCMove()
+
+size_t Ising2D::getPackedConfigurationSize()
 {
 
-  // update "old" observables
-  for (unsigned int i=0; i < numObservables; i++)
-    oldObservables[i] = observables[i];
+  return (size_t(systemSize) + 7) / 8;
 
 }
 
 
-void Ising2D::rejectMCMove()
+void Ising2D::packConfiguration(void* buffer)
 {
 
-  spin[CurX*Size+CurY] = CurType;
-  for (unsigned int i=0; i < numObservables; i++)
-    observables[i] = oldObservables[i];
+  packSignBits(spin, systemSize, static_cast<uint8_t*>(buffer));
 
 }
 
 
-void Ising2D::buildMPIConfigurationType()
+void Ising2D::unpackConfiguration(const void* buffer)
 {
- 
-  MPI_Type_contiguous(int(systemSize), MPI_INT, &MPI_ConfigurationType);
-  MPI_Type_commit(&MPI_ConfigurationType);
+
+  unpackSignBits(static_cast<const uint8_t*>(buffer), systemSize, spin);
 
 }
 
@@ -1,10 +1,13 @@
 #ifndef ISING2D_HPP
 #define ISING2D_HPP
 
+#include <cmath>
+#include <cstdlib>
 #include <filesystem>
 #include "PhysicalSystemBase.hpp"
+#include "Utilities/RandomNumberGenerator.hpp"
 
-class Ising2D : public PhysicalSystem {
+class Ising2D final : public PhysicalSystem {
 
 public :
 
@@ -18,7 +21,16 @@ public :
   void acceptMCMove()                                   override;
   void rejectMCMove()                                   override;
 
-  void buildMPIConfigurationType();
+  ObservableType proposeMCMove()                        override;
+  void commitMCMove()                                   override;
+  void discardMCMove()                                  override;
+
+  bool calculateObservablesFromScratch(std::vector<ObservableType>& result) override;
+
+  // 1 bit per spin for replica exchanges
+  size_t getPackedConfigurationSize()                   override;
+  void   packConfiguration(void* buffer)                override;
+  void   unpackConfiguration(const void* buffer)        override;
 
 private :
 
@@ -30,6 +42,9 @@ private :
   unsigned int CurX, CurY;
   SpinDirection CurType;
 
+  // Energy after the proposed move
+  ObservableType trialEnergy;
+
   // New configuration
   SpinDirection* spin;             // make it a flat array for MPI to operate on
  
@@ -39,4 +54,127 @@ private :
 
 };
 
+
+// Inline member functions (one MC step; inlined into the MC loops, see SystemDispatch.hpp)
+
+inline void Ising2D::getObservables()
+{
+
+  unsigned int xLeft, yBelow;
+  unsigned int xRight, yAbove;
+
+  if (getObservablesFromScratch) {
+
+    resetObservables();
+    calculateObservablesFromScratch(observables);
+    getObservablesFromScratch = false;
+    //printf("Calculated observables from scratch. \n");
+  }
+  else {
+    if (CurX != 0) xLeft = CurX - 1; else xLeft = Size - 1;
+    if (CurY != 0) yBelow = CurY - 1; else yBelow = Size - 1;
+    if (CurX != (Size-1) ) xRight = CurX + 1; else xRight = 0;
+    if (CurY != (Size-1) ) yAbove = CurY + 1; else yAbove = 0;
+
+    int sumNeighbor = spin[xLeft*Size+CurY] + spin[xRight*Size+CurY] + spin[CurX*Size+yBelow] + spin[CurX*Size+yAbove];
+    int energyChange = sumNeighbor * CurType * 2;
+
+    observables[0] += energyChange;
+    observables[1] += spin[CurX*Size+CurY] - CurType;
+    observables[2]  = std::abs(observables[1]);
+    //printf("observables = %10.5f %10.5f %10.5f\n", observables[0], observables[1], observables[2]);
+
+  }
+
+}
+
+
+inline void Ising2D::doMCMove()
+{
+
+  // Need this here since resetObservables() is not called if getObservablesFromScratch = false
+  for (unsigned int i = 0; i < numObservables; i++)
+    oldObservables[i] = observables[i];
+
+  // randomly choose a site
+  CurX = unsigned(getIntRandomNumber()) % Size;
+  CurY = unsigned(getIntRandomNumber()) % Size;
+  CurType = spin[CurX*Size + CurY];
+
+  // flip the spin at that site
+  if (CurType == -1)
+    spin[CurX*Size+CurY] = 1;
+  else
+    spin[CurX*Size+CurY] = -1;
+    
+  //writeConfiguration(0);
+
+}
+
+
+inline void Ising2D::acceptMCMove()
+{
+
+  // update "old" observables
+  for (unsigned int i=0; i < numObservables; i++)
+    oldObservables[i] = observables[i];
+
+}
+
+
+inline void Ising2D::rejectMCMove()
+{
+
+  spin[CurX*Size+CurY] = CurType;
+  for (unsigned int i=0; i < numObservables; i++)
+    observables[i] = oldObservables[i];
+
+}
+
+
+// The spin at (CurX, CurY) is only flipped if the move is committed
+inline ObservableType Ising2D::proposeMCMove()
+{
+
+  unsigned int xLeft, yBelow;
+  unsigned int xRight, yAbove;
+
+  // randomly choose a site
+  CurX = unsigned(getIntRandomNumber()) % Size;
+  CurY = unsigned(getIntRandomNumber()) % Size;
+  CurType = spin[CurX*Size + CurY];
+
+  if (CurX != 0) xLeft = CurX - 1; else xLeft = Size - 1;
+  if (CurY != 0) yBelow = CurY - 1; else yBelow = Size - 1;
+  if (CurX != (Size-1) ) xRight = CurX + 1; else xRight = 0;
+  if (CurY != (Size-1) ) yAbove = CurY + 1; else yAbove = 0;
+
+  int sumNeighbor = spin[xLeft*Size+CurY] + spin[xRight*Size+CurY] + spin[CurX*Size+yBelow] + spin[CurX*Size+yAbove];
+  int energyChange = sumNeighbor * CurType * 2;
+
+  trialEnergy = observables[0] + energyChange;
+  return trialEnergy;
+
+}
+
+
+inline void Ising2D::commitMCMove()
+{
+
+  spin[CurX*Size+CurY] = -CurType;
+
+  observables[0]  = trialEnergy;
+  observables[1] += -2 * CurType;
+  observables[2]  = std::abs(observables[1]);
+
+  for (unsigned int i=0; i < numObservables; i++)
+    oldObservables[i] = observables[i];
+
+}
+
+
+inline void Ising2D::discardMCMove()
+{
+}
+
 #endif
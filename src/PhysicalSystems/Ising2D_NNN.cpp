@@ -2,9 +2,11 @@
 #include <cstdlib>
 #include <cstdio>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include "Ising2D_NNN.hpp"
+#include "Utilities/BitPacking.hpp"
 #include "Utilities/RandomNumberGenerator.hpp"
 
 
@@ -39,12 +41,14 @@ Ising2D_NNN::Ising2D_NNN(const char* spinConfigFile)
   observableName.push_back("Absolute staggered magnetization, |M_stag|"); // observables[4] : absolute staggered magnetization
   initializeObservables(observableName.size());
 
+  // Energies are integers as long as the couplings are
+  hasIntegerEnergy = true;
+  for (auto J : exchangeInteraction)
+    if (J != std::round(J)) hasIntegerEnergy = false;
+
   getObservablesFromScratch = true;
   getObservables();
 
-  buildMPIConfigurationType();
-  pointerToConfiguration = static_cast<void*>(&spin[0]);
- 
 }
 
 
@@ -54,10 +58,6 @@ Ising2D_NNN::~Ising2D_NNN()
 
   delete[] spin;
 
-  // Free MPI datatype
-  pointerToConfiguration = NULL;
-  MPI_Type_free(&MPI_ConfigurationType);
-
   if (GlobalComm.thisMPIrank == 0)
     printf("\nIsing2D_NNN finished\n");
 
@@ -74,7 +74,7 @@ void Ising2D_NNN::writeConfiguration(int format, const char* filename)
 
     case 2 : {     // Write everything in one file, one line for each configuration
 
-      if (filename != NULL) f = fopen(filename, "a");
+      if (filename != NULL) f = openConfigurationFile(filename, "a");
       else f = stdout;
 
       // Write the configuration
@@ -97,7 +97,7 @@ void Ising2D_NNN::writeConfiguration(int format, const char* filename)
 
     default : {
 
-      if (filename != NULL) f = fopen(filename, "w");
+      if (filename != NULL) f = openConfigurationFile(filename, "w");
       else f = stdout;
 
       fprintf(f, "# 2D Ising Model : %u x %u\n\n", Size, Size);
@@ -136,20 +136,8 @@ void Ising2D_NNN::getObservables()
   if (getObservablesFromScratch) {
 
     resetObservables();
-  
-    for (unsigned int x = 0; x < Size; x++) {
-      if (x != 0) xLeft = x - 1; else xLeft = Size - 1;
-      for (unsigned int y = 0; y < Size; y++) {
-        if (y != 0) yBelow = y - 1; else yBelow = Size - 1;
-        if (y != (Size-1)) yAbove = y + 1; else yAbove = 0;
-        observables[0] += spin[x*Size+y] * (exchangeInteraction[0] * (spin[xLeft*Size+y] + spin[x*Size+yBelow]) + 
-                                            exchangeInteraction[1] * (spin[xLeft*Size+yBelow] + spin[xLeft*Size+yAbove]));
-        observables[1] += ObservableType(spin[x*Size+y]);
-        observables[3] += pow(-1.0, double(x+y)) * ObservableType(spin[x*Size+y]); 
-      }
-    }
-    observables[2] = abs(observables[1]);
-    observables[4] = abs(observables[3]);
+    calculateObservablesFromScratch(observables);
+    countBonds(nearestNeighborBonds, nextNearestNeighborBonds);
     getObservablesFromScratch = false;
     //printf("observables = %10.5f %10.5f %10.5f %10.5f %10.5f\n", observables[0], observables[1], observables[2], observables[3], observables[4]);
     //printf("Calculated observables from scratch. \n");
@@ -162,10 +150,11 @@ void Ising2D_NNN::getObservables()
 
     int sumNeighbor = spin[xLeft*Size+CurY] + spin[xRight*Size+CurY] + spin[CurX*Size+yBelow] + spin[CurX*Size+yAbove];
     int sumNextNearestNeighbors = spin[xLeft*Size+yBelow] + spin[xRight*Size+yBelow] + spin[xLeft*Size+yAbove] + spin[xRight*Size+yAbove];
-    ObservableType energyChange = exchangeInteraction[0] * ObservableType(sumNeighbor * oldSpin * -2) + 
-                                  exchangeInteraction[1] * ObservableType(sumNextNearestNeighbors * oldSpin * -2);
+    nearestNeighborBonds     += sumNeighbor * oldSpin * -2;
+    nextNearestNeighborBonds += sumNextNearestNeighbors * oldSpin * -2;
 
-    observables[0] += energyChange;
+    observables[0]  = exchangeInteraction[0] * ObservableType(nearestNeighborBonds) +
+                      exchangeInteraction[1] * ObservableType(nextNearestNeighborBonds);
     observables[1] += spin[CurX*Size+CurY] - oldSpin;
     observables[2]  = abs(observables[1]);
     observables[3] += pow(-1.0, double(CurX+CurY)) * ObservableType(spin[CurX*Size+CurY] - oldSpin);
@@ -176,12 +165,54 @@ void Ising2D_NNN::getObservables()
 }
 
 
+bool Ising2D_NNN::calculateObservablesFromScratch(std::vector<ObservableType>& result)
+{
+
+  int nearest, nextNearest;
+  countBonds(nearest, nextNearest);
+
+  result.assign(numObservables, 0.0);
+  result[0] = exchangeInteraction[0] * ObservableType(nearest) + exchangeInteraction[1] * ObservableType(nextNearest);
+  for (unsigned int x = 0; x < Size; x++) {
+    for (unsigned int y = 0; y < Size; y++) {
+      result[1] += ObservableType(spin[x*Size+y]);
+      result[3] += pow(-1.0, double(x+y)) * ObservableType(spin[x*Size+y]); 
+    }
+  }
+  result[2] = abs(result[1]);
+  result[4] = abs(result[3]);
+  return true;
+
+}
+
+
+void Ising2D_NNN::countBonds(int& nearest, int& nextNearest)
+{
+
+  unsigned int xLeft, yBelow, yAbove;
+
+  nearest = nextNearest = 0;
+  for (unsigned int x = 0; x < Size; x++) {
+    if (x != 0) xLeft = x - 1; else xLeft = Size - 1;
+    for (unsigned int y = 0; y < Size; y++) {
+      if (y != 0) yBelow = y - 1; else yBelow = Size - 1;
+      if (y != (Size-1)) yAbove = y + 1; else yAbove = 0;
+      nearest     += spin[x*Size+y] * (spin[xLeft*Size+y] + spin[x*Size+yBelow]);
+      nextNearest += spin[x*Size+y] * (spin[xLeft*Size+yBelow] + spin[xLeft*Size+yAbove]);
+    }
+  }
+
+}
+
+
 void Ising2D_NNN::doMCMove()
 {
 
   // Need this here since resetObservables() is not called if getObservablesFromScratch = false
   for (unsigned int i = 0; i < numObservables; i++)
     oldObservables[i] = observables[i];
+  oldNearestNeighborBonds     = nearestNeighborBonds;
+  oldNextNearestNeighborBonds = nextNearestNeighborBonds;
 
   // randomly choose a site
   CurX = unsigned(getIntRandomNumber()) % Size;
@@ -223,15 +254,43 @@ void Ising2D_NNN::rejectMCMove()
   spin[CurX*Size+CurY] = oldSpin;
   for (unsigned int i=0; i < numObservables; i++)
     observables[i] = oldObservables[i];
+  nearestNeighborBonds     = oldNearestNeighborBonds;
+  nextNearestNeighborBonds = oldNextNearestNeighborBonds;
 
 }
 
 
-void Ising2D_NNN::buildMPIConfigurationType()
+size_t Ising2D_NNN::getPackedConfigurationSize()
 {
- 
-  MPI_Type_contiguous(int(systemSize), MPI_INT, &MPI_ConfigurationType);
-  MPI_Type_commit(&MPI_ConfigurationType);
+
+  return (size_t(systemSize) + 7) / 8 + 2 * sizeof(int);
+
+}
+
+
+void Ising2D_NNN::packConfiguration(void* buffer)
+{
+
+  uint8_t* bytes = static_cast<uint8_t*>(buffer);
+  packSignBits(spin, systemSize, bytes);
+
+  // The shipped energy is built from these, so they travel with it
+  bytes += (size_t(systemSize) + 7) / 8;
+  memcpy(bytes,               &nearestNeighborBonds,     sizeof(int));
+  memcpy(bytes + sizeof(int), &nextNearestNeighborBonds, sizeof(int));
+
+}
+
+
+void Ising2D_NNN::unpackConfiguration(const void* buffer)
+{
+
+  const uint8_t* bytes = static_cast<const uint8_t*>(buffer);
+  unpackSignBits(bytes, systemSize, spin);
+
+  bytes += (size_t(systemSize) + 7) / 8;
+  memcpy(&nearestNeighborBonds,     bytes,               sizeof(int));
+  memcpy(&nextNearestNeighborBonds, bytes + sizeof(int), sizeof(int));
 
 }
 
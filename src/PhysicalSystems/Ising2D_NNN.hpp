@@ -4,7 +4,7 @@
 #include <filesystem>
 #include "PhysicalSystemBase.hpp"
 
-class Ising2D_NNN : public PhysicalSystem {
+class Ising2D_NNN final : public PhysicalSystem {
 
 public :
 
@@ -18,7 +18,12 @@ public :
   void acceptMCMove()                                   override;
   void rejectMCMove()                                   override;
 
-  void buildMPIConfigurationType();
+  bool calculateObservablesFromScratch(std::vector<ObservableType>& result) override;
+
+  // 1 bit per spin plus the two bond sums for replica exchanges
+  size_t getPackedConfigurationSize()                   override;
+  void   packConfiguration(void* buffer)                override;
+  void   unpackConfiguration(const void* buffer)        override;
 
 private :
 
@@ -36,6 +41,13 @@ private :
   // New configuration
   SpinDirection* spin;             // make it a flat array for MPI to operate on
 
+  // Sums of s_i s_j over nearest and next nearest neighbor bonds. The energy is always
+  // evaluated from these integers, so it does not depend on the path that led to a configuration.
+  int nearestNeighborBonds {0}, nextNearestNeighborBonds {0};
+  int oldNearestNeighborBonds {0}, oldNextNearestNeighborBonds {0};
+
+  void   countBonds(int& nearest, int& nextNearest);
+
   // Initialization:
   void   readSpinConfigFile(const std::filesystem::path& spinConfigFile);
   void   readHamiltonian(const std::filesystem::path& mainInputFile);
@@ -6,6 +6,7 @@
 #include <fstream>
 #include <sstream>
 #include "IsingND.hpp"
+#include "Utilities/BitPacking.hpp"
 #include "Utilities/RandomNumberGenerator.hpp"
 
 
@@ -37,13 +38,11 @@ IsingND::IsingND(const char* spinConfigFile, int initial)
   observableName.push_back("Total magnetization, M");                     // observables[1] : total magnetization
   observableName.push_back("Total absolute magnetization, |M|");          // observables[2] : total absolute magnetization
   initializeObservables(observableName.size());
+  hasIntegerEnergy = true;
 
   getObservablesFromScratch = true;
   getObservables();
 
-  buildMPIConfigurationType();
-  pointerToConfiguration = static_cast<void*>(&spin[0]);
-
 }
 
 
@@ -52,10 +51,6 @@ IsingND::~IsingND()
 
   delete[] spin;
 
-  // Free MPI datatype
-  pointerToConfiguration = NULL;
-  MPI_Type_free(&MPI_ConfigurationType);
-
   if (GlobalComm.thisMPIrank == 0)
     printf("\nIsingND finished\n");
 
@@ -71,7 +66,7 @@ void IsingND::writeConfiguration(int format, const char* filename)
 
     case 2 : {     // Write everything in one file, one line for each configuration
 
-      if (filename != NULL) f = fopen(filename, "a");
+      if (filename != NULL) f = openConfigurationFile(filename, "a");
       else f = stdout;
 
       // Write the configuration
@@ -91,7 +86,7 @@ void IsingND::writeConfiguration(int format, const char* filename)
     }
     default : {
 
-      if (filename != NULL) f = fopen(filename, "w");
+      if (filename != NULL) f = openConfigurationFile(filename, "w");
       else f = stdout;
 
       fprintf(f, "# %u-D Ising Model of length %u \n\n", dimension, Size);
@@ -130,25 +125,7 @@ void IsingND::getObservables()
   if (getObservablesFromScratch) {
 
     resetObservables();
-    
-    for (unsigned int i=0; i<systemSize; i++) {
-      currentIndex = i;
-      getCoordinatesFromIndex(currentIndex, currentPosition);
-      neighbor1Position = currentPosition;
-
-      IsingSpinDirection sumNeighbor = 0.0;
-      for (unsigned int d=0; d<dimension; d++) {
-        if (currentPosition[d] != 0) neighbor1Position[d] = currentPosition[d] - 1;
-        else neighbor1Position[d] = Size - 1;
-        sumNeighbor += spin[getIndexFromCoordinates(neighbor1Position)];
-        neighbor1Position[d] = currentPosition[d];
-      }
-      observables[0] += ObservableType(spin[currentIndex] * sumNeighbor);
-      observables[1] += ObservableType(spin[currentIndex]);
-    }
-
-    observables[0] = -observables[0];             // ferromagnetic interaction
-    observables[2] = abs(observables[1]);
+    calculateObservablesFromScratch(observables);
     getObservablesFromScratch = false;
 
   }
@@ -179,6 +156,35 @@ void IsingND::getObservables()
 }
 
 
+bool IsingND::calculateObservablesFromScratch(std::vector<ObservableType>& result)
+{
+
+  std::vector<unsigned int> position (dimension, 0);
+  std::vector<unsigned int> neighborPosition (dimension, 0);
+
+  result.assign(numObservables, 0.0);
+  for (unsigned int i=0; i<systemSize; i++) {
+    getCoordinatesFromIndex(i, position);
+    neighborPosition = position;
+
+    IsingSpinDirection sumNeighbor = 0;
+    for (unsigned int d=0; d<dimension; d++) {
+      if (position[d] != 0) neighborPosition[d] = position[d] - 1;
+      else neighborPosition[d] = Size - 1;
+      sumNeighbor += spin[getIndexFromCoordinates(neighborPosition)];
+      neighborPosition[d] = position[d];
+    }
+    result[0] += ObservableType(spin[i] * sumNeighbor);
+    result[1] += ObservableType(spin[i]);
+  }
+
+  result[0] = -result[0];                         // ferromagnetic interaction
+  result[2] = abs(result[1]);
+  return true;
+
+}
+
+
 void IsingND::doMCMove()
 {
 
@@ -231,11 +237,26 @@ void IsingND::rejectMCMove()
 }
 
 
-void IsingND::buildMPIConfigurationType()
+size_t IsingND::getPackedConfigurationSize()
+{
+
+  return (size_t(systemSize) + 7) / 8;
+
+}
+
+
+void IsingND::packConfiguration(void* buffer)
 {
- 
-  MPI_Type_contiguous(int(systemSize), MPI_INT, &MPI_ConfigurationType);
-  MPI_Type_commit(&MPI_ConfigurationType);
+
+  packSignBits(spin, systemSize, static_cast<uint8_t*>(buffer));
+
+}
+
+
+void IsingND::unpackConfiguration(const void* buffer)
+{
+
+  unpackSignBits(static_cast<const uint8_t*>(buffer), systemSize, spin);
 
 }
 
@@ -8,7 +8,7 @@ typedef int          IsingSpinDirection;
 typedef unsigned int Coordinates;
 
 
-class IsingND : public PhysicalSystem {
+class IsingND final : public PhysicalSystem {
 
 public :
 
@@ -22,7 +22,12 @@ public :
   void acceptMCMove()                                   override;
   void rejectMCMove()                                   override;
 
-  void buildMPIConfigurationType();
+  bool calculateObservablesFromScratch(std::vector<ObservableType>& result) override;
+
+  // 1 bit per spin for replica exchanges
+  size_t getPackedConfigurationSize()                   override;
+  void   packConfiguration(void* buffer)                override;
+  void   unpackConfiguration(const void* buffer)        override;
 
 private :
 
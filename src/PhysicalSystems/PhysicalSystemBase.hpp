@@ -1,6 +1,7 @@
 #ifndef MODEL_HPP
 #define MODEL_HPP
 
+#include <cstdio>
 #include <cstdlib>
 #include <filesystem>
 #include <iostream>
@@ -10,7 +11,9 @@
 #include "Main/Communications.hpp"
 
 
-// To DO: make it a template class to allow for int / double observables  (July 15, 2017)
+// Observables are stored as ObservableType (double). Systems whose energy only takes integer
+// values set hasIntegerEnergy, and the histogram-based MC algorithms then bin the energy with
+// integer arithmetic (see Histogram<IntegerObservableType>).
 class PhysicalSystem {
 
 public:
@@ -32,12 +35,40 @@ public:
   virtual void doMCMove() = 0;
   virtual void acceptMCMove() = 0;
   virtual void rejectMCMove() = 0;        // restore old observables and old configurations to current ones
-  
+
+  // Propose/commit protocol, used by the MC loops that only need the energy to decide on a move.
+  // proposeMCMove() draws a trial move and returns the energy after it; commitMCMove() then
+  // carries the move out and updates all observables, or discardMCMove() drops it. Between the
+  // two, observables may hold either the current or the trial state, so callers must not read
+  // them. The versions here go through doMCMove() and friends; a system overriding them computes
+  // only the energy difference in proposeMCMove() and leaves the configuration untouched, so that
+  // a rejected move costs no more than that. After either call observables == oldObservables,
+  // as after acceptMCMove() or rejectMCMove(), so both protocols can be used on the same system.
+  virtual ObservableType proposeMCMove() {
+    doMCMove();
+    getObservables();
+    return observables[0];
+  }
+  virtual void commitMCMove()  { acceptMCMove(); }
+  virtual void discardMCMove() { rejectMCMove(); }
+
   virtual void getAdditionalObservables() {};
+
+  // All observables recomputed from the configuration alone, leaving the current ones untouched.
+  // Used to check incrementally updated or exchanged observables for drift; returns false if
+  // the system does not provide it.
+  virtual bool calculateObservablesFromScratch(std::vector<ObservableType>&) { return false; }
   virtual void calculateThermodynamics(std::vector<ObservableType>, std::vector<ObservableType>, double);
 
-  // Construct data structures for MPI communications. Used in Replica exchanges.
-  void buildMPIConfigurationType() {};
+  // Serialization of the configuration into a contiguous buffer, used in replica exchanges.
+  // getPackedConfigurationSize() gives the number of bytes; a system returning 0 cannot be
+  // exchanged. Discrete sites may use a compact wire format (see Utilities/BitPacking.hpp).
+  // The observables travel with the configuration, so after unpackConfiguration the system
+  // must be ready for the next doMCMove without recomputing them. Cached state derived from
+  // the configuration (local fields, pair counts) belongs in the packed bytes as well.
+  virtual size_t getPackedConfigurationSize() { return 0; }
+  virtual void   packConfiguration(void*) {}
+  virtual void   unpackConfiguration(const void*) {}
 
   //void readHamiltonianTerms(const char* inputFile) {};
 
@@ -54,9 +85,12 @@ public:
   // Useful for initialization or after replica exchange.
   bool getObservablesFromScratch {true};   
 
-  // MPI derived type to store configuration for replica exchange
-  MPI_Datatype MPI_ConfigurationType;
-  void* pointerToConfiguration;
+  // True if observables[0] (the energy) is always an exact integer, e.g. Ising models
+  bool hasIntegerEnergy {false};
+
+  // If set, the next configuration file opened by writeConfiguration() goes to this stream
+  // instead (see openConfigurationFile). The checkpoint writer formats snapshots into memory so.
+  FILE* configurationStream {NULL};
 
   // MPI Communicator for one energy calculation
   //MPICommunicator PhysicalSystemCommunicator;
@@ -64,6 +98,13 @@ public:
 
 protected:
 
+  // For writeConfiguration(); the stream is closed by fclose() as a file would be
+  FILE* openConfigurationFile(const char* filename, const char* mode) {
+    FILE* f = configurationStream;
+    configurationStream = NULL;
+    return (f != NULL) ? f : fopen(filename, mode);
+  }
+
   void setSystemSize(unsigned int n) {
     systemSize = n;
   }
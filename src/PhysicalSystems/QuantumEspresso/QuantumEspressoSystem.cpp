@@ -37,9 +37,6 @@ QuantumEspressoSystem::QuantumEspressoSystem(MPICommunicator PhysicalSystemComm)
   oldConfig.lattice_vectors.resize(3,3);
   oldConfig.atomic_species.resize(natom);
 
-  buildMPIConfigurationType();
-  pointerToConfiguration = static_cast<void*>(&trialConfig);   // Is it ok to point to a struct like this? (Dec 26, 17)
-
   // check if the following should be called in here:
   // yes, because they initialize trialConfig.atomic_positions and trialConfig.lattice_vectors
   get_pos_array(&trialConfig.atomic_positions(0,0));           // Extract the position array from QE
@@ -57,10 +54,6 @@ QuantumEspressoSystem::~QuantumEspressoSystem()
   int exit_status;                                // Environmental parameter for QE
   owl_qe_stop(&exit_status);                      // Finish the PWscf calculation
 
-  // Free MPI datatype
-  pointerToConfiguration = NULL;
-  MPI_Type_free(&MPI_ConfigurationType);
-
   std::cout << "Finalized QE MPI communications...\n";
   std::cout << "QuantumEspressoSystem finished\n";
 
@@ -337,38 +330,37 @@ void QuantumEspressoSystem::writeQErestartFile(const char* fileName)
 }
 
 
-void QuantumEspressoSystem::buildMPIConfigurationType()
+size_t QuantumEspressoSystem::getPackedConfigurationSize()
+{
+
+  return (trialConfig.atomic_positions.size() + trialConfig.lattice_vectors.size()) * sizeof(double) +
+         trialConfig.atomic_species.size() * sizeof(int);
+
+}
+
+
+void QuantumEspressoSystem::packConfiguration(void* buffer)
+{
+
+  char* position = static_cast<char*>(buffer);
+  memcpy(position, &trialConfig.atomic_positions[0], trialConfig.atomic_positions.size() * sizeof(double));
+  position += trialConfig.atomic_positions.size() * sizeof(double);
+  memcpy(position, &trialConfig.lattice_vectors[0], trialConfig.lattice_vectors.size() * sizeof(double));
+  position += trialConfig.lattice_vectors.size() * sizeof(double);
+  memcpy(position, trialConfig.atomic_species.data(), trialConfig.atomic_species.size() * sizeof(int));
+
+}
+
+
+void QuantumEspressoSystem::unpackConfiguration(const void* buffer)
 {
 
-  int          count {3};
-  int          numElements[count];
-  MPI_Aint     address_displacements[count];
-  MPI_Datatype types[count];
-
-  MPI_Aint start_address;
-  MPI_Aint address1;
-  MPI_Aint address2;
-
-  // Number of elements in each array
-  numElements[0] = trialConfig.atomic_positions.size();
-  numElements[1] = trialConfig.lattice_vectors.size();
-  numElements[2] = trialConfig.atomic_species.size();
-  //std::cout << "Debugging check: numElements[0]/[1] = " << numElements[0] << " , " << numElements[1] << "\n";
-
-  // The derived datatype consists of two arrays of MPI_DOUBLE
-  types[0] = types[1] = MPI_DOUBLE;
-  types[2] = MPI_INT;
-
-  // Calculate the relative addresses for each array
-  MPI_Get_address(&trialConfig.atomic_positions[0], &start_address);
-  MPI_Get_address(&trialConfig.lattice_vectors[0], &address1);
-  MPI_Get_address(&trialConfig.atomic_species[0], &address2);
-  address_displacements[0] = 0;
-  address_displacements[1] = address1 - start_address;
-  address_displacements[2] = address2 - start_address;
-
-  MPI_Type_create_struct(count, numElements, address_displacements, types, &MPI_ConfigurationType);
-  MPI_Type_commit(&MPI_ConfigurationType);
+  const char* position = static_cast<const char*>(buffer);
+  memcpy(&trialConfig.atomic_positions[0], position, trialConfig.atomic_positions.size() * sizeof(double));
+  position += trialConfig.atomic_positions.size() * sizeof(double);
+  memcpy(&trialConfig.lattice_vectors[0], position, trialConfig.lattice_vectors.size() * sizeof(double));
+  position += trialConfig.lattice_vectors.size() * sizeof(double);
+  memcpy(trialConfig.atomic_species.data(), position, trialConfig.atomic_species.size() * sizeof(int));
 
 }
 
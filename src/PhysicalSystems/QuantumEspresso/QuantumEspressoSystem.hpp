@@ -9,7 +9,7 @@
 
 
 // YingWai's Note:  (Dec 26, 17)
-// If this is changed, the MPI derived type (MPIConfigurationType) built by buildMPIConfigurationType() needs to be modified too.
+// If this is changed, packConfiguration() and unpackConfiguration() need to be modified too.
 struct QEConfiguration
 {
   Matrix<double> atomic_positions;            // Atomic positions (in Angstrom)
@@ -18,7 +18,7 @@ struct QEConfiguration
 };
 
 
-class QuantumEspressoSystem : public PhysicalSystem {
+class QuantumEspressoSystem final : public PhysicalSystem {
 
 public:
 
@@ -33,7 +33,10 @@ public:
   void acceptMCMove()                                   override;
   void rejectMCMove()                                   override;
 
-  void buildMPIConfigurationType();
+  // Atomic positions, cell vectors and atomic species for replica exchanges
+  size_t getPackedConfigurationSize()                   override;
+  void   packConfiguration(void* buffer)                override;
+  void   unpackConfiguration(const void* buffer)        override;
 
 private:
 
@@ -0,0 +1,42 @@
+#ifndef SYSTEM_DISPATCH_HPP
+#define SYSTEM_DISPATCH_HPP
+
+#include "PhysicalSystemBase.hpp"
+#include "Ising2D.hpp"
+#include "IsingND.hpp"
+#include "Ising2D_NNN.hpp"
+#include "Heisenberg2D.hpp"
+#include "Heisenberg3D.hpp"
+#include "HeisenbergHexagonal2D.hpp"
+#include "CrystalStructure3D.hpp"
+#include "Alloy3D.hpp"
+
+// Static dispatch over the physical systems.
+//
+// The MC algorithms compile their inner loops once for each system below (a template over
+// SystemType), and pick the version for the actual system when they are constructed. The
+// concrete systems are final, so the calls of an MC step are resolved at compile time and
+// the ones defined in the headers (e.g. Ising2D) are inlined into the loop. Any other
+// system, such as a driver-mode code, runs the PhysicalSystem version with virtual calls.
+//
+// dispatchOnSystemType(ps, f) returns f(static_cast<SystemType*>(nullptr)) for the type of *ps,
+// so that f can select what to run without touching the system.
+
+template <typename Function>
+auto dispatchOnSystemType(PhysicalSystem* ps, Function&& f)
+{
+
+  if (dynamic_cast<Ising2D*>(ps))               return f(static_cast<Ising2D*>(nullptr));
+  if (dynamic_cast<IsingND*>(ps))               return f(static_cast<IsingND*>(nullptr));
+  if (dynamic_cast<Ising2D_NNN*>(ps))           return f(static_cast<Ising2D_NNN*>(nullptr));
+  if (dynamic_cast<Heisenberg2D*>(ps))          return f(static_cast<Heisenberg2D*>(nullptr));
+  if (dynamic_cast<Heisenberg3D*>(ps))          return f(static_cast<Heisenberg3D*>(nullptr));
+  if (dynamic_cast<HeisenbergHexagonal2D*>(ps)) return f(static_cast<HeisenbergHexagonal2D*>(nullptr));
+  if (dynamic_cast<CrystalStructure3D*>(ps))    return f(static_cast<CrystalStructure3D*>(nullptr));
+  if (dynamic_cast<Alloy3D*>(ps))               return f(static_cast<Alloy3D*>(nullptr));
+
+  return f(static_cast<PhysicalSystem*>(nullptr));
+
+}
+
+#endif
@@ -0,0 +1,133 @@
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Utilities/DOSStitching.hpp"
+
+/*
+  owl-postprocess: stitch the DOS files of all REWL walkers (dos_walkerNNNNN.dat)
+  and compute the canonical thermodynamics on a temperature grid (k_B = 1).
+
+  Output:
+    <prefix>_dos.dat             energy, normalized DOS, ln g (and bin width for non-uniform bins),
+                                 one line per visited bin
+    <prefix>_thermodynamics.dat  T, F, U, S, Cv
+*/
+
+void printUsage()
+{
+  std::cout << "Usage: owl-postprocess [options] dos_walker00000.dat dos_walker00001.dat ...\n"
+            << "Options:\n"
+            << "  -T Tmin Tmax numT   temperature grid (default: 0.1 10 1000)\n"
+            << "  -n lnOmega          ln of the total number of states (default: 0, normalized DOS)\n"
+            << "  -t numThreads       number of threads (default: all hardware threads)\n"
+            << "  -o prefix           prefix of the output files (default: stitched)\n";
+}
+
+
+int main(int argc, char *argv[])
+{
+
+  double       Tmin          = 0.1;
+  double       Tmax          = 10.0;
+  int          numT          = 1000;
+  double       lnTotalStates = 0.0;
+  unsigned int numThreads    = std::max(1u, std::thread::hardware_concurrency());
+  std::string  prefix        = "stitched";
+  std::vector<const char*> fileNames;
+
+  for (int i=1; i<argc; i++) {
+    if (strcmp(argv[i], "-T") == 0 && i + 3 < argc) {
+      Tmin = atof(argv[++i]);
+      Tmax = atof(argv[++i]);
+      numT = atoi(argv[++i]);
+    }
+    else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+      lnTotalStates = atof(argv[++i]);
+    else if (strcmp(argv[i], "-t") == 0 && i + 1 < argc)
+      numThreads = unsigned(std::max(1, atoi(argv[++i])));
+    else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+      prefix = argv[++i];
+    else if (argv[i][0] == '-') {
+      printUsage();
+      exit(7);
+    }
+    else
+      fileNames.push_back(argv[i]);
+  }
+
+  if (fileNames.empty() || numT < 1 || Tmin <= 0.0 || Tmax < Tmin) {
+    printUsage();
+    exit(7);
+  }
+
+  // Read the walkers' DOS files in parallel
+  std::vector<WindowDOS> windows(fileNames.size());
+  std::vector<char> readOK(fileNames.size(), 0);
+  {
+    std::vector<std::thread> threads;
+    unsigned int numReaders = std::min(numThreads, unsigned(fileNames.size()));
+    for (unsigned int n=0; n<numReaders; n++)
+      threads.emplace_back([&, n]() {
+        for (size_t f=n; f<fileNames.size(); f+=numReaders)
+          readOK[f] = readWindowDOSFile(fileNames[f], windows[f]);
+      });
+    for (auto& thread : threads) thread.join();
+  }
+  for (size_t f=0; f<fileNames.size(); f++)
+    if (!readOK[f]) exit(7);
+
+  // Average walkers of the same window, then join adjacent windows
+  mergeWalkersOfWindows(windows);
+  std::cout << "Read " << fileNames.size() << " DOS files covering " << windows.size() << " energy windows\n";
+
+  WindowDOS dos;
+  std::vector<double> joinEnergies;
+  if (!stitchWindows(windows, dos, joinEnergies)) exit(10);
+  normalizeDOS(dos, lnTotalStates);
+
+  std::string fileName = prefix + "_dos.dat";
+  FILE* dosFile = fopen(fileName.c_str(), "w");
+  if (dosFile == NULL) {
+    std::cerr << "   Error: cannot open " << fileName << " for writing\n";
+    exit(7);
+  }
+  fprintf(dosFile, "# Stitched from %zu windows; joined at E =", windows.size());
+  for (auto E : joinEnergies) fprintf(dosFile, " %.10e", E);
+  fprintf(dosFile, "\n# energy, normalized DOS, ln g%s\n", dos.nonUniform ? ", bin width (energy is the lower edge)" : "");
+  for (size_t i=0; i<dos.energy.size(); i++) {
+    double lnStates = dos.lnG[i] + log(dos.binWidth[i]);
+    if (dos.nonUniform)
+      fprintf(dosFile, "%18.10e  %18.10e  %18.10e  %18.10e\n", dos.energy[i] - 0.5 * dos.binWidth[i],
+              exp(lnStates - lnTotalStates), lnStates, dos.binWidth[i]);
+    else
+      fprintf(dosFile, "%18.10e  %18.10e  %18.10e\n", dos.energy[i], exp(lnStates - lnTotalStates), lnStates);
+  }
+  fclose(dosFile);
+
+  // Thermodynamics on the temperature grid
+  std::vector<double> temperatures(static_cast<size_t>(numT));
+  for (int t=0; t<numT; t++)
+    temperatures[size_t(t)] = (numT > 1) ? Tmin + (Tmax - Tmin) * double(t) / double(numT - 1) : Tmin;
+
+  std::vector<ThermodynamicsPoint> results;
+  computeThermodynamics(dos, temperatures, results, numThreads);
+
+  fileName = prefix + "_thermodynamics.dat";
+  FILE* thermoFile = fopen(fileName.c_str(), "w");
+  if (thermoFile == NULL) {
+    std::cerr << "   Error: cannot open " << fileName << " for writing\n";
+    exit(7);
+  }
+  fprintf(thermoFile, "# T, free energy F, internal energy U, entropy S, specific heat Cv (k_B = 1)\n");
+  for (auto& p : results)
+    fprintf(thermoFile, "%18.10e  %18.10e  %18.10e  %18.10e  %18.10e\n", p.T, p.F, p.U, p.S, p.Cv);
+  fclose(thermoFile);
+
+  std::cout << "Wrote " << prefix << "_dos.dat and " << prefix << "_thermodynamics.dat\n";
+  return 0;
+
+}
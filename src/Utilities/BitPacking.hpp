@@ -0,0 +1,118 @@
+#ifndef BIT_PACKING_HPP
+#define BIT_PACKING_HPP
+
+#include <cstddef>
+#include <cstdint>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// Compact wire formats for configurations of 32-bit integer sites:
+//   packSignBits / unpackSignBits : Ising spins, 1 bit per site (1 for +1, 0 for -1)
+//   packBytes / unpackBytes       : small labels such as atomic species, 8 bits per site
+// Sites are processed 16 at a time with SSE2 where available, with a scalar tail.
+// T is any 4-byte integer or enum type.
+
+
+// n spins into (n + 7) / 8 bytes; bit i % 8 of byte i / 8 is set if spin[i] > 0
+template <typename T>
+inline void packSignBits(const T* spin, size_t n, uint8_t* bits)
+{
+  static_assert(sizeof(T) == 4, "packSignBits requires 4-byte sites");
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    const __m128i* source = reinterpret_cast<const __m128i*>(spin + i);
+    __m128i positive0 = _mm_cmpgt_epi32(_mm_loadu_si128(source    ), zero);
+    __m128i positive1 = _mm_cmpgt_epi32(_mm_loadu_si128(source + 1), zero);
+    __m128i positive2 = _mm_cmpgt_epi32(_mm_loadu_si128(source + 2), zero);
+    __m128i positive3 = _mm_cmpgt_epi32(_mm_loadu_si128(source + 3), zero);
+    __m128i bytes = _mm_packs_epi16(_mm_packs_epi32(positive0, positive1), _mm_packs_epi32(positive2, positive3));
+    int mask = _mm_movemask_epi8(bytes);
+    bits[i / 8]     = uint8_t(mask & 0xff);
+    bits[i / 8 + 1] = uint8_t((mask >> 8) & 0xff);
+  }
+#endif
+
+  for (; i < n; i++) {
+    if (i % 8 == 0) bits[i / 8] = 0;
+    if (int32_t(spin[i]) > 0) bits[i / 8] = uint8_t(bits[i / 8] | (1u << (i % 8)));
+  }
+}
+
+
+// Inverse of packSignBits: spin[i] = +1 or -1
+template <typename T>
+inline void unpackSignBits(const uint8_t* bits, size_t n, T* spin)
+{
+  static_assert(sizeof(T) == 4, "unpackSignBits requires 4-byte sites");
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i bitsLow  = _mm_setr_epi32(1, 2, 4, 8);
+  const __m128i one      = _mm_set1_epi32(1);
+  const __m128i two      = _mm_set1_epi32(2);
+  for (; i + 16 <= n; i += 16) {
+    int mask = bits[i / 8] | (bits[i / 8 + 1] << 8);
+    __m128i* destination = reinterpret_cast<__m128i*>(spin + i);
+    for (int quarter=0; quarter<4; quarter++) {
+      __m128i set = _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask >> (4 * quarter)), bitsLow), bitsLow);
+      _mm_storeu_si128(destination + quarter, _mm_sub_epi32(_mm_and_si128(set, two), one));
+    }
+  }
+#endif
+
+  for (; i < n; i++)
+    spin[i] = T(((bits[i / 8] >> (i % 8)) & 1) ? 1 : -1);
+}
+
+
+// n values in [0, 255] into n bytes
+template <typename T>
+inline void packBytes(const T* value, size_t n, uint8_t* bytes)
+{
+  static_assert(sizeof(T) == 4, "packBytes requires 4-byte sites");
+  size_t i = 0;
+
+#ifdef __SSE2__
+  for (; i + 16 <= n; i += 16) {
+    const __m128i* source = reinterpret_cast<const __m128i*>(value + i);
+    __m128i words0 = _mm_packs_epi32(_mm_loadu_si128(source    ), _mm_loadu_si128(source + 1));
+    __m128i words1 = _mm_packs_epi32(_mm_loadu_si128(source + 2), _mm_loadu_si128(source + 3));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(bytes + i), _mm_packus_epi16(words0, words1));
+  }
+#endif
+
+  for (; i < n; i++)
+    bytes[i] = uint8_t(value[i]);
+}
+
+
+// Inverse of packBytes
+template <typename T>
+inline void unpackBytes(const uint8_t* bytes, size_t n, T* value)
+{
+  static_assert(sizeof(T) == 4, "unpackBytes requires 4-byte sites");
+  size_t i = 0;
+
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    __m128i packed = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + i));
+    __m128i words0 = _mm_unpacklo_epi8(packed, zero);
+    __m128i words1 = _mm_unpackhi_epi8(packed, zero);
+    __m128i* destination = reinterpret_cast<__m128i*>(value + i);
+    _mm_storeu_si128(destination,     _mm_unpacklo_epi16(words0, zero));
+    _mm_storeu_si128(destination + 1, _mm_unpackhi_epi16(words0, zero));
+    _mm_storeu_si128(destination + 2, _mm_unpacklo_epi16(words1, zero));
+    _mm_storeu_si128(destination + 3, _mm_unpackhi_epi16(words1, zero));
+  }
+#endif
+
+  for (; i < n; i++)
+    value[i] = T(bytes[i]);
+}
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef DOS_STITCHING_HPP
+#define DOS_STITCHING_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <thread>
+#include <vector>
+
+/*
+  Stitching of the DOS of REWL energy windows, and thermodynamics from a DOS.
+
+  The input is one file per walker, as written by Histogram::writeNormDOSFile:
+  one line per energy bin with the energy and the normalized DOS of the bin,
+  plus the bin width for non-uniform bins (where the energy is the lower edge).
+  Bins that were never visited have a DOS of 0 and are dropped, so that ln g
+  of discrete spectra with gaps (e.g. the Ising model) is continuous.
+
+  Walkers sharing a window (same energy bins) are averaged. Adjacent windows
+  are joined at the energy in their overlap where the slopes d(ln g)/dE of
+  the two windows match best (Ref: T. Vogel et al., Phys. Rev. E 90, 023302
+  (2014)); the upper window is shifted to agree with the lower one there.
+*/
+
+// DOS of one energy window, or of the stitched energy range; only visited bins are kept
+struct WindowDOS {
+  std::vector<double> energy;        // energy of each bin: as written for uniform bins, the centre for non-uniform bins
+  std::vector<double> binWidth;
+  std::vector<double> lnG;           // ln of the DOS per unit energy
+  double gridBegin {0.0};            // first and last energy in the file, visited or not;
+  double gridEnd   {0.0};            // walkers of the same window share them
+  bool   nonUniform {false};
+};
+
+
+// Returns false (with a message) if the file cannot be read
+inline bool readWindowDOSFile(const char* fileName, WindowDOS& w)
+{
+  FILE* dosFile = fopen(fileName, "r");
+  if (dosFile == NULL) {
+    std::cerr << "   Error: cannot open DOS file " << fileName << "\n";
+    return false;
+  }
+
+  w = WindowDOS();
+  int    numColumns = 0;
+  size_t numLines   = 0;
+  char line[512];
+  while (fgets(line, sizeof(line), dosFile) != NULL) {
+    if (line[0] == '#') continue;
+
+    double value[4];
+    int n = 0;
+    char* position = line;
+    char* end = line;
+    while (n < 4) {
+      value[n] = strtod(position, &end);
+      if (end == position) break;
+      position = end;
+      n++;
+    }
+    if (n == 0) continue;
+
+    if (numColumns == 0) {
+      numColumns = n;
+      if (n != 2 && n != 3) {
+        std::cerr << "   Error: " << fileName << " is not a one-dimensional DOS file (found " << n << " columns)\n";
+        fclose(dosFile);
+        return false;
+      }
+      w.nonUniform = (n == 3);
+      w.gridBegin  = value[0];
+    }
+    else if (n != numColumns) {
+      std::cerr << "   Error: inconsistent number of columns in " << fileName << "\n";
+      fclose(dosFile);
+      return false;
+    }
+    w.gridEnd = value[0];
+    numLines++;
+
+    if (value[1] <= 0.0) continue;
+    double width = w.nonUniform ? value[2] : 1.0;
+    w.energy.push_back(w.nonUniform ? value[0] + 0.5 * width : value[0]);
+    w.binWidth.push_back(width);
+    w.lnG.push_back(log(value[1] / width));
+  }
+  fclose(dosFile);
+
+  if (w.energy.empty()) {
+    std::cerr << "   Error: no visited energy bins in " << fileName << "\n";
+    return false;
+  }
+
+  // Uniform bins all have the spacing of the energies in the file
+  if (!w.nonUniform && numLines > 1) {
+    double width = (w.gridEnd - w.gridBegin) / double(numLines - 1);
+    std::fill(w.binWidth.begin(), w.binWidth.end(), width);
+    for (size_t i=0; i<w.lnG.size(); i++) w.lnG[i] -= log(width);
+  }
+  return true;
+}
+
+
+// Central difference of ln g at bin i; false at the first and last bin, where
+// the DOS of a window is least accurate
+inline bool getDOSSlope(const WindowDOS& w, size_t i, double& slope)
+{
+  if (i == 0 || i + 1 >= w.lnG.size()) return false;
+  slope = (w.lnG[i+1] - w.lnG[i-1]) / (w.energy[i+1] - w.energy[i-1]);
+  return true;
+}
+
+
+// ln g and its slope at energy E, interpolated between two bins; false where there is no slope
+inline bool interpolateDOS(const WindowDOS& w, double E, double& lnG, double& slope)
+{
+  size_t j = size_t(std::upper_bound(w.energy.begin(), w.energy.end(), E) - w.energy.begin());
+  if (j == 0 || j == w.energy.size()) return false;
+  j--;
+
+  double slopeLower, slopeUpper;
+  if (!getDOSSlope(w, j, slopeLower)) return false;
+  if (E == w.energy[j]) {
+    lnG   = w.lnG[j];
+    slope = slopeLower;
+    return true;
+  }
+  if (!getDOSSlope(w, j+1, slopeUpper)) return false;
+
+  double x = (E - w.energy[j]) / (w.energy[j+1] - w.energy[j]);
+  lnG   = (1.0 - x) * w.lnG[j] + x * w.lnG[j+1];
+  slope = (1.0 - x) * slopeLower + x * slopeUpper;
+  return true;
+}
+
+
+// Average the walkers of each window; after this, windows are sorted by energy, one per window
+inline void mergeWalkersOfWindows(std::vector<WindowDOS>& windows)
+{
+  std::sort(windows.begin(), windows.end(),
+            [](const WindowDOS& a, const WindowDOS& b) {
+              return (a.gridBegin != b.gridBegin) ? (a.gridBegin < b.gridBegin) : (a.gridEnd < b.gridEnd);
+            });
+
+  std::vector<WindowDOS> merged;
+  for (size_t k=0; k<windows.size(); ) {
+    size_t next = k + 1;
+    while (next < windows.size() && windows[next].gridBegin == windows[k].gridBegin
+                                 && windows[next].gridEnd   == windows[k].gridEnd)
+      next++;
+
+    // Shift every walker onto the first over their common bins, then average bin by bin
+    std::vector<std::pair<double, double> > entries;      // energy, shifted ln g
+    for (size_t n=k; n<next; n++) {
+      const WindowDOS& walker = windows[n];
+      double shift = 0.0;
+      int numCommon = 0;
+      for (size_t i=0, j=0; i<windows[k].energy.size() && j<walker.energy.size(); ) {
+        if      (windows[k].energy[i] < walker.energy[j]) i++;
+        else if (walker.energy[j] < windows[k].energy[i]) j++;
+        else {
+          shift += windows[k].lnG[i] - walker.lnG[j];
+          numCommon++;
+          i++;
+          j++;
+        }
+      }
+      if (numCommon > 0) shift /= double(numCommon);
+      for (size_t j=0; j<walker.energy.size(); j++)
+        entries.push_back(std::make_pair(walker.energy[j], walker.lnG[j] + shift));
+    }
+    std::stable_sort(entries.begin(), entries.end(),
+                     [](const std::pair<double, double>& a, const std::pair<double, double>& b) { return a.first < b.first; });
+
+    WindowDOS window = windows[k];
+    window.energy.clear();
+    window.lnG.clear();
+    for (size_t e=0; e<entries.size(); ) {
+      size_t last = e;
+      double sum  = 0.0;
+      while (last < entries.size() && entries[last].first == entries[e].first) sum += entries[last++].second;
+      window.energy.push_back(entries[e].first);
+      window.lnG.push_back(sum / double(last - e));
+      e = last;
+    }
+
+    // Bin widths by energy, from any walker
+    window.binWidth.clear();
+    for (size_t i=0; i<window.energy.size(); i++) {
+      double width = windows[k].binWidth[0];
+      for (size_t n=k; n<next; n++) {
+        auto found = std::lower_bound(windows[n].energy.begin(), windows[n].energy.end(), window.energy[i]);
+        if (found != windows[n].energy.end() && *found == window.energy[i]) {
+          width = windows[n].binWidth[size_t(found - windows[n].energy.begin())];
+          break;
+        }
+      }
+      window.binWidth.push_back(width);
+    }
+
+    merged.push_back(std::move(window));
+    k = next;
+  }
+  windows.swap(merged);
+}
+
+
+// Join the windows (sorted by energy, one per window) into one DOS;
+// joinEnergies receives the energy at which each pair of windows was joined
+inline bool stitchWindows(const std::vector<WindowDOS>& windows, WindowDOS& stitched, std::vector<double>& joinEnergies)
+{
+  if (windows.empty()) return false;
+
+  stitched = windows[0];
+  joinEnergies.clear();
+
+  for (size_t k=1; k<windows.size(); k++) {
+    const WindowDOS& upper = windows[k];
+    if (upper.nonUniform != stitched.nonUniform) {
+      std::cerr << "   Error: windows " << k-1 << " and " << k << " mix uniform and non-uniform energy bins\n";
+      return false;
+    }
+
+    // The bin of the lower part in the overlap where the slopes agree best
+    size_t joinBin = stitched.energy.size();
+    double joinLnG = 0.0;
+    double bestMismatch = std::numeric_limits<double>::max();
+    for (size_t i=0; i<stitched.energy.size(); i++) {
+      double slopeLower, lnGUpper, slopeUpper;
+      if (!getDOSSlope(stitched, i, slopeLower)) continue;
+      if (!interpolateDOS(upper, stitched.energy[i], lnGUpper, slopeUpper)) continue;
+      double mismatch = fabs(slopeLower - slopeUpper);
+      if (mismatch < bestMismatch) {
+        bestMismatch = mismatch;
+        joinBin      = i;
+        joinLnG      = lnGUpper;
+      }
+    }
+    if (joinBin == stitched.energy.size()) {
+      std::cerr << "   Error: the visited energies of windows " << k-1 << " and " << k << " do not overlap\n";
+      return false;
+    }
+
+    // Lower part up to the joining bin, then the shifted upper window
+    double joinEnergy = stitched.energy[joinBin];
+    double shift      = stitched.lnG[joinBin] - joinLnG;
+    stitched.energy.resize(joinBin + 1);
+    stitched.binWidth.resize(joinBin + 1);
+    stitched.lnG.resize(joinBin + 1);
+    for (size_t j=0; j<upper.energy.size(); j++) {
+      if (upper.energy[j] <= joinEnergy) continue;
+      stitched.energy.push_back(upper.energy[j]);
+      stitched.binWidth.push_back(upper.binWidth[j]);
+      stitched.lnG.push_back(upper.lnG[j] + shift);
+    }
+    stitched.gridEnd = upper.gridEnd;
+    joinEnergies.push_back(joinEnergy);
+  }
+  return true;
+}
+
+
+// Shift ln g so that the total number of states is exp(lnTotalStates)
+inline void normalizeDOS(WindowDOS& w, double lnTotalStates)
+{
+  double maxLnStates = std::numeric_limits<double>::lowest();
+  for (size_t i=0; i<w.lnG.size(); i++)
+    maxLnStates = std::max(maxLnStates, w.lnG[i] + log(w.binWidth[i]));
+
+  double sum = 0.0;
+  for (size_t i=0; i<w.lnG.size(); i++)
+    sum += exp(w.lnG[i] + log(w.binWidth[i]) - maxLnStates);
+
+  double shift = lnTotalStates - maxLnStates - log(sum);
+  for (size_t i=0; i<w.lnG.size(); i++)
+    w.lnG[i] += shift;
+}
+
+
+// Canonical averages at one temperature (k_B = 1)
+struct ThermodynamicsPoint {
+  double T;
+  double F;          // free energy, -T ln Z
+  double U;          // internal energy
+  double S;          // entropy, (U - F) / T
+  double Cv;         // specific heat, (<E^2> - <E>^2) / T^2
+};
+
+
+// Log-sum-exp over the bins for every temperature: a pass for the maximum exponent, then
+// a branch-free pass over contiguous arrays summing the weights relative to it.
+// Temperatures are divided among numThreads threads.
+inline void computeThermodynamics(const WindowDOS& w, const std::vector<double>& temperatures,
+                                  std::vector<ThermodynamicsPoint>& results, unsigned int numThreads)
+{
+  // ln of the number of states in each bin
+  std::vector<double> lnStates(w.lnG.size());
+  for (size_t i=0; i<w.lnG.size(); i++)
+    lnStates[i] = w.lnG[i] + log(w.binWidth[i]);
+  size_t numBins = w.energy.size();
+  const double* energies = w.energy.data();
+  const double* lnW      = lnStates.data();
+
+  results.resize(temperatures.size());
+  numThreads = std::max(1u, std::min(numThreads, unsigned(temperatures.size())));
+
+  auto worker = [&](size_t first, size_t last) {
+    for (size_t t=first; t<last; t++) {
+      double T    = temperatures[t];
+      double beta = 1.0 / T;
+
+      // Energies relative to the most probable energy E0 keep the variance accurate
+      double maxExponent = std::numeric_limits<double>::lowest();
+      double E0 = 0.0;
+      for (size_t i=0; i<numBins; i++) {
+        double exponent = lnW[i] - beta * energies[i];
+        if (exponent > maxExponent) {
+          maxExponent = exponent;
+          E0          = energies[i];
+        }
+      }
+
+      double Z = 0.0, sumE = 0.0, sumE2 = 0.0;
+      for (size_t i=0; i<numBins; i++) {
+        double weight = exp(lnW[i] - beta * energies[i] - maxExponent);
+        double dE     = energies[i] - E0;
+        Z     += weight;
+        sumE  += weight * dE;
+        sumE2 += weight * dE * dE;
+      }
+
+      double meanDE = sumE / Z;
+      ThermodynamicsPoint& p = results[t];
+      p.T  = T;
+      p.F  = -T * (maxExponent + log(Z));
+      p.U  = E0 + meanDE;
+      p.S  = (p.U - p.F) / T;
+      p.Cv = (sumE2 / Z - meanDE * meanDE) / (T * T);
+    }
+  };
+
+  std::vector<std::thread> threads;
+  size_t chunk = (temperatures.size() + numThreads - 1) / numThreads;
+  for (unsigned int n=1; n<numThreads; n++) {
+    size_t first = std::min(temperatures.size(), n * chunk);
+    size_t last  = std::min(temperatures.size(), first + chunk);
+    threads.emplace_back(worker, first, last);
+  }
+  worker(0, std::min(temperatures.size(), chunk));
+  for (auto& thread : threads) thread.join();
+}
+
+#endif
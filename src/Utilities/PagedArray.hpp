@@ -0,0 +1,122 @@
+#ifndef PAGED_ARRAY_HPP
+#define PAGED_ARRAY_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+// A fixed-size array of zero-initialized elements whose memory is allocated in pages,
+// on the first write to a page. Unallocated pages share one read-only page of zeros,
+// so reading any element is a table lookup and an offset, without branches.
+//
+// Reads use operator[]; writes go through ref(), which allocates the page if needed.
+// With pageSize = 0 the whole array is a single page allocated up front (dense storage).
+
+template <typename T>
+class PagedArray {
+
+  static_assert(std::is_trivially_copyable<T>::value, "PagedArray only holds trivially copyable types");
+
+public:
+
+  PagedArray() : numElements(0), pageShift(0), pageMask(0), elementsPerPage(0) {}
+
+  // Resize to n zero elements; pageSize must be 0 (dense) or a power of 2
+  void assign(size_t n, size_t pageSize)
+  {
+    numElements = n;
+    ownedPages.clear();
+    zeroPage.reset();
+
+    if (pageSize == 0 || pageSize >= n) {
+      pageShift       = sizeof(size_t) * 8 - 1;    // every index < 2^63 maps to page 0
+      pageMask        = ~size_t(0);
+      elementsPerPage = n;
+      table.assign(1, nullptr);
+      allocatePage(0);
+    }
+    else {
+      pageShift = 0;
+      while ((size_t(1) << pageShift) < pageSize) pageShift++;
+      pageMask        = (size_t(1) << pageShift) - 1;
+      elementsPerPage = size_t(1) << pageShift;
+      zeroPage.reset(new T[elementsPerPage]());
+      table.assign((n + elementsPerPage - 1) >> pageShift, zeroPage.get());
+    }
+  }
+
+  size_t size() const { return numElements; }
+
+  const T& operator[](size_t i) const { return table[i >> pageShift][i & pageMask]; }
+
+  T& ref(size_t i)
+  {
+    size_t page = i >> pageShift;
+    if (table[page] == zeroPage.get()) allocatePage(page);
+    return table[page][i & pageMask];
+  }
+
+  // Set all elements to zero, keeping the allocated pages
+  void reset()
+  {
+    for (size_t p=0; p<table.size(); p++)
+      if (pageAllocated(p))
+        memset(static_cast<void*>(table[p]), 0, pageLength(p) * sizeof(T));
+  }
+
+  // Page structure, for loops that only need to visit allocated pages
+  size_t numPages() const                { return table.size(); }
+  size_t pageBegin(size_t page) const    { return page * elementsPerPage; }
+  size_t pageEnd(size_t page) const      { return pageBegin(page) + pageLength(page); }
+  bool   pageAllocated(size_t page) const { return table[page] != zeroPage.get(); }
+  size_t allocatedBytes() const          { return ownedPages.size() * elementsPerPage * sizeof(T); }
+
+  // Copy all elements to a contiguous destination, zeros included
+  void copyTo(void* destination) const
+  {
+    char* bytes = static_cast<char*>(destination);
+    for (size_t p=0; p<table.size(); p++)
+      memcpy(bytes + pageBegin(p) * sizeof(T), static_cast<const void*>(table[p]), pageLength(p) * sizeof(T));
+  }
+
+  // Copy all elements from a contiguous source; pages that are all zero stay unallocated
+  void read(const void* source)
+  {
+    const char* bytes = static_cast<const char*>(source);
+    for (size_t p=0; p<table.size(); p++) {
+      const char* pageSource = bytes + pageBegin(p) * sizeof(T);
+      size_t      pageBytes  = pageLength(p) * sizeof(T);
+      if (!pageAllocated(p) && memcmp(pageSource, zeroPage.get(), pageBytes) == 0) continue;
+      if (!pageAllocated(p)) allocatePage(p);
+      memcpy(static_cast<void*>(table[p]), pageSource, pageBytes);
+    }
+  }
+
+private:
+
+  size_t numElements;
+  size_t pageShift;
+  size_t pageMask;
+  size_t elementsPerPage;
+
+  std::vector<T*> table;                          // page table; unallocated pages point to zeroPage
+  std::unique_ptr<T[]> zeroPage;
+  std::vector<std::unique_ptr<T[]>> ownedPages;
+
+  size_t pageLength(size_t page) const
+  {
+    return std::min(elementsPerPage, numElements - pageBegin(page));
+  }
+
+  void allocatePage(size_t page)
+  {
+    ownedPages.emplace_back(new T[elementsPerPage]());
+    table[page] = ownedPages.back().get();
+  }
+
+};
+
+#endif
@@ -5,10 +5,6 @@
 // YingWai: should the RNG be placed as a member in MCAlgorithm class?
 std::mt19937 rng_engine;
 //int RngSeed {-1};
-std::uniform_real_distribution<double> distribution1(-0.5, 0.5); 
-std::uniform_real_distribution<double> distribution2(0.0, 1.0); 
-std::uniform_int_distribution<int> distribution_int;
-std::uniform_int_distribution<unsigned int> distribution_uint; 
 
 
 void initializeRandomNumberGenerator(MPICommunicator phy_sys_comm, int RngSeed)
@@ -38,3 +34,32 @@ void initializeRandomNumberGenerator(MPICommunicator phy_sys_comm, int RngSeed)
   rng_engine.seed(unsigned(RngSeed));
 
 }
+
+
+// Give the calling thread an engine of its own; rng_engine stays with the main thread
+void seedThreadRandomNumberGenerator(int RngSeed)
+{
+
+  static thread_local std::mt19937 engine;
+
+  engine.seed(unsigned(RngSeed));
+  thread_rng_engine = &engine;
+
+}
+
+
+void UniformRandomBuffer::refill()
+{
+
+  std::mt19937& engine = *thread_rng_engine;
+
+  for (size_t i=0; i<bits.size(); i++)
+    bits[i] = uint32_t(engine());
+
+  // 27 + 26 bits of two draws, as genrand_res53() of the reference Mersenne Twister
+  for (size_t i=0; i<numbers.size(); i++)
+    numbers[i] = (double(bits[2*i] >> 5) * 67108864.0 + double(bits[2*i+1] >> 6)) * (1.0 / 9007199254740992.0);
+
+  next = 0;
+
+}
@@ -1,7 +1,9 @@
 #ifndef RANDOM_NUMBER_GENERATOR_HPP
 #define RANDOM_NUMBER_GENERATOR_HPP
 
+#include <cstdint>
 #include <random>
+#include <vector>
 #include "Main/Communications.hpp"
 
 // TODO: allow for different choice of random number generators
@@ -10,44 +12,73 @@
 extern std::mt19937 rng_engine;
 //extern int RngSeed;
 
-// Uniform distribution between (-0.5, 0.5)
-extern std::uniform_real_distribution<double> distribution1; 
-
-// Uniform distribution between (0,1)
-extern std::uniform_real_distribution<double> distribution2; 
-
-// Uniform integer distribution between (0,?)
-extern std::uniform_int_distribution<int> distribution_int; 
-
-// Uniform unsigned integer distribution between (0,?)
-extern std::uniform_int_distribution<unsigned int> distribution_uint; 
+// The RNG of the calling thread: rng_engine, unless the thread has seeded its own with
+// seedThreadRandomNumberGenerator() (threaded walkers). A thread_local pointer with a
+// constant initializer needs no initialization guard, so each draw costs one extra load.
+inline thread_local std::mt19937* thread_rng_engine = &rng_engine;
 
 
 void initializeRandomNumberGenerator(MPICommunicator, int = -1);
+void seedThreadRandomNumberGenerator(int);
 
 
+// The distributions hold no state between draws; they are built on the fly so that
+// threads do not share them
+
 // Returns a random number between (-0.5, 0.5)
 inline double getRandomNumber()
 {
-  return distribution1(rng_engine);
+  return std::uniform_real_distribution<double>(-0.5, 0.5)(*thread_rng_engine);
 }
 
 // Returns a random number between (0.0, 1.0)
 inline double getRandomNumber2()
 {
-  return distribution2(rng_engine);
+  return std::uniform_real_distribution<double>(0.0, 1.0)(*thread_rng_engine);
 }
 
 // Returns an integral random number between (0,?)
 inline int getIntRandomNumber()
 {
-  return distribution_int(rng_engine);
+  return std::uniform_int_distribution<int>()(*thread_rng_engine);
 }
 
 // Returns an integral random number between (0,?)
 inline unsigned int getUnsignedIntRandomNumber()
 {
-  return distribution_uint(rng_engine);
+  return std::uniform_int_distribution<unsigned int>()(*thread_rng_engine);
+}
+
+
+// Random numbers between [0.0, 1.0) for loops that draw one per step (e.g. Metropolis
+// acceptance). They are generated in blocks: the engine runs in a tight loop, and the
+// conversion to double, with 53 random bits as in getRandomNumber2(), vectorizes. A block
+// is drawn from the RNG of the calling thread ahead of use, so the order of the numbers
+// relative to the other draws of the thread differs from calling getRandomNumber2().
+class UniformRandomBuffer {
+
+public :
+
+  UniformRandomBuffer(unsigned int size = 4096) :
+    numbers(size), bits(2 * size_t(size)), next(size) {}
+
+  double get();
+
+private :
+
+  std::vector<double>   numbers;
+  std::vector<uint32_t> bits;
+  size_t                next;                // index of the next number to return
+
+  void refill();
+
+};
+
+
+inline double UniformRandomBuffer::get()
+{
+  if (next == numbers.size()) refill();
+  return numbers[next++];
 }
 
 #endif
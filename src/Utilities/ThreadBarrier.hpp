@@ -0,0 +1,57 @@
+#ifndef THREAD_BARRIER_HPP
+#define THREAD_BARRIER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// A reusable barrier for a fixed number of threads (std::barrier is C++20).
+//
+// Threads that arrive early spin for a short while before they go to sleep,
+// since walkers meet at every replica exchange and usually arrive close together.
+// The spinning threads yield, in case there are more threads than cores.
+// Everything a thread wrote before wait() is visible to all threads after it.
+
+class ThreadBarrier {
+
+public:
+
+  explicit ThreadBarrier(int n) : numThreads(n), numWaiting(0), generation(0) {}
+
+  void wait()
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    unsigned long int myGeneration = generation.load();
+
+    if (++numWaiting == numThreads) {
+      numWaiting = 0;
+      generation.store(myGeneration + 1);
+      lock.unlock();
+      released.notify_all();
+      return;
+    }
+    lock.unlock();
+
+    for (int spin=0; spin<spinCount; spin++) {
+      if (generation.load() != myGeneration) return;
+      std::this_thread::yield();
+    }
+
+    lock.lock();
+    released.wait(lock, [&] { return generation.load() != myGeneration; });
+  }
+
+private:
+
+  static const int spinCount = 1000;
+
+  std::mutex                     mutex;
+  std::condition_variable        released;
+  int                            numThreads;
+  int                            numWaiting;
+  std::atomic<unsigned long int> generation;
+
+};
+
+#endif